@@ -0,0 +1,402 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Encoder Benchmark
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <winpr/crt.h>
+#include <winpr/cmdline.h>
+
+#include "core.h"
+#include "encoder.h"
+#include "capture.h"
+
+/**
+ * Replays frames recorded with FREERDS_CAPTURE_DIR through every encoder
+ * available for a 32bpp session supporting RemoteFX and NSCodec, or only the
+ * ones given with /encoder. Updates go to a null sink, so only encoding is
+ * measured: throughput, output size and per-frame latency percentiles.
+ * Frames are replayed in file name order, that is one session after another.
+ *
+ * freerds-bench --dir <directory> [--encoder <name>] [--iterations <count>]
+ */
+
+COMMAND_LINE_ARGUMENT_A freerds_bench_args[] =
+{
+	{ "dir", COMMAND_LINE_VALUE_REQUIRED, "<directory>", NULL, NULL, -1, NULL, "captured frames" },
+	{ "encoder", COMMAND_LINE_VALUE_REQUIRED, "<name>", NULL, NULL, -1, NULL, "encoder to run" },
+	{ "iterations", COMMAND_LINE_VALUE_REQUIRED, "<count>", NULL, NULL, -1, NULL, "replays per encoder" },
+	{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
+};
+
+struct rds_bench
+{
+	int frameCount;
+	rdsCaptureFrame** frames;
+
+	rdpUpdate* update;
+	freerdp_peer* client;
+	rdpSettings* settings;
+	rdsConnection* connection;
+	rdsEncoderSet* encoders;
+
+	UINT64* latencies;
+};
+typedef struct rds_bench rdsBench;
+
+/**
+ * Null update sink
+ */
+
+static void freerds_bench_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmap)
+{
+
+}
+
+static void freerds_bench_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* cmd)
+{
+
+}
+
+static void freerds_bench_surface_frame_marker(rdpContext* context, SURFACE_FRAME_MARKER* marker)
+{
+
+}
+
+static UINT64 freerds_bench_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (((UINT64) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+}
+
+static int freerds_bench_compare_name(const void* a, const void* b)
+{
+	return strcmp(*((const char**) a), *((const char**) b));
+}
+
+static int freerds_bench_compare_latency(const void* a, const void* b)
+{
+	UINT64 la = *((const UINT64*) a);
+	UINT64 lb = *((const UINT64*) b);
+
+	return (la < lb) ? -1 : ((la > lb) ? 1 : 0);
+}
+
+static int freerds_bench_load(rdsBench* bench, const char* path)
+{
+	int index;
+	int count;
+	int length;
+	char** names;
+	DIR* directory;
+	struct dirent* entry;
+	char filename[1024];
+	rdsCaptureFrame* frame;
+
+	directory = opendir(path);
+
+	if (!directory)
+	{
+		printf("cannot open %s\n", path);
+		return -1;
+	}
+
+	count = 0;
+	names = NULL;
+
+	while ((entry = readdir(directory)) != NULL)
+	{
+		length = strlen(entry->d_name);
+
+		if ((length < 5) || (strcmp(&entry->d_name[length - 5], ".rdsf") != 0))
+			continue;
+
+		names = (char**) realloc(names, sizeof(char*) * (count + 1));
+		names[count++] = _strdup(entry->d_name);
+	}
+
+	closedir(directory);
+
+	qsort(names, count, sizeof(char*), freerds_bench_compare_name);
+
+	bench->frames = (rdsCaptureFrame**) calloc(count + 1, sizeof(rdsCaptureFrame*));
+
+	for (index = 0; index < count; index++)
+	{
+		sprintf_s(filename, sizeof(filename), "%s/%s", path, names[index]);
+
+		frame = freerds_capture_frame_read(filename);
+
+		if (frame && bench->frameCount &&
+				((frame->width != bench->frames[0]->width) || (frame->height != bench->frames[0]->height)))
+		{
+			printf("%s: size differs from the first frame, skipped\n", filename);
+			freerds_capture_frame_free(frame);
+			frame = NULL;
+		}
+
+		if (frame)
+			bench->frames[bench->frameCount++] = frame;
+
+		free(names[index]);
+	}
+
+	free(names);
+
+	if (bench->frameCount < 1)
+	{
+		printf("no frames found in %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int freerds_bench_connection_init(rdsBench* bench)
+{
+	rdpContext* context;
+	rdpSettings* settings;
+	rdsConnection* connection;
+
+	settings = bench->settings = freerdp_settings_new(0);
+
+	settings->DesktopWidth = bench->frames[0]->width;
+	settings->DesktopHeight = bench->frames[0]->height;
+	settings->ColorDepth = 32;
+	settings->RemoteFxCodec = TRUE;
+	settings->RemoteFxCodecId = 3;
+	settings->NSCodec = TRUE;
+	settings->NSCodecId = 1;
+	settings->MultifragMaxRequestSize = 0x3F0000;
+
+	bench->update = (rdpUpdate*) calloc(1, sizeof(rdpUpdate));
+	bench->update->BitmapUpdate = freerds_bench_bitmap_update;
+	bench->update->SurfaceBits = freerds_bench_surface_bits;
+	bench->update->SurfaceFrameMarker = freerds_bench_surface_frame_marker;
+
+	bench->client = (freerdp_peer*) calloc(1, sizeof(freerdp_peer));
+	bench->client->settings = settings;
+	bench->client->update = bench->update;
+
+	connection = bench->connection = (rdsConnection*) calloc(1, sizeof(rdsConnection));
+	context = (rdpContext*) connection;
+
+	context->peer = bench->client;
+	context->update = bench->update;
+	context->settings = settings;
+
+	bench->client->context = context;
+	bench->update->context = context;
+
+	connection->client = bench->client;
+
+	freerds_connection_init(connection, settings);
+
+	/* no transmit stage: SurfaceBits go straight to the sink */
+
+	connection->codecMode = TRUE;
+	bench->encoders = freerds_encoder_set_new(connection);
+
+	return bench->encoders ? 0 : -1;
+}
+
+static void freerds_bench_connection_uninit(rdsBench* bench)
+{
+	freerds_encoder_set_free(bench->encoders);
+	bench->connection->encoders = NULL;
+
+	freerds_connection_uninit(bench->connection);
+
+	free(bench->connection);
+	free(bench->client);
+	free(bench->update);
+
+	freerdp_settings_free(bench->settings);
+}
+
+static void freerds_bench_run(rdsBench* bench, rdsEncoderInstance* instance, int iterations)
+{
+	int index;
+	int count;
+	int iteration;
+	UINT32 rect;
+	UINT64 begin;
+	UINT64 total;
+	UINT64 pixels;
+	double p50, p99;
+	rdsCaptureFrame* frame;
+	RDS_FRAMEBUFFER framebuffer;
+	RDS_MSG_PAINT_RECT msg;
+
+	ZeroMemory(&instance->stats, sizeof(rdsEncoderStats));
+	ZeroMemory(&framebuffer, sizeof(RDS_FRAMEBUFFER));
+	ZeroMemory(&msg, sizeof(RDS_MSG_PAINT_RECT));
+
+	framebuffer.fbAttached = TRUE;
+	framebuffer.fbSegmentId = 1;
+	framebuffer.fbBitsPerPixel = 32;
+	framebuffer.fbBytesPerPixel = 4;
+
+	msg.type = RDS_SERVER_PAINT_RECT;
+	msg.framebuffer = &framebuffer;
+	msg.fbSegmentId = framebuffer.fbSegmentId;
+
+	count = 0;
+	total = pixels = 0;
+
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (index = 0; index < bench->frameCount; index++)
+		{
+			frame = bench->frames[index];
+
+			framebuffer.fbWidth = frame->width;
+			framebuffer.fbHeight = frame->height;
+			framebuffer.fbScanline = frame->scanline;
+			framebuffer.fbSharedMemory = frame->data;
+
+			begin = freerds_bench_time();
+
+			for (rect = 0; rect < frame->numRects; rect++)
+			{
+				msg.nLeftRect = frame->rects[rect].x;
+				msg.nTopRect = frame->rects[rect].y;
+				msg.nWidth = frame->rects[rect].width;
+				msg.nHeight = frame->rects[rect].height;
+
+				freerds_encoder_encode(bench->encoders, instance, 32, &msg);
+
+				pixels += frame->rects[rect].width * frame->rects[rect].height;
+			}
+
+			bench->latencies[count] = freerds_bench_time() - begin;
+			total += bench->latencies[count];
+			count++;
+		}
+	}
+
+	qsort(bench->latencies, count, sizeof(UINT64), freerds_bench_compare_latency);
+
+	p50 = bench->latencies[(count * 50) / 100] / 1000000.0;
+	p99 = bench->latencies[MIN((count * 99) / 100, count - 1)] / 1000000.0;
+
+	printf("%-12s %10.1f MPix/s %12.0f bytes/frame  p50 %8.3f ms  p99 %8.3f ms  errors %d\n",
+			instance->encoder->name,
+			total ? (pixels * 1000.0) / total : 0.0,
+			(double) instance->stats.bytes / count,
+			p50, p99, (int) instance->stats.errors);
+}
+
+int main(int argc, char** argv)
+{
+	int index;
+	int status;
+	DWORD flags;
+	int iterations;
+	char* path;
+	char* encoderName;
+	rdsBench bench;
+	rdsEncoderInstance* instance;
+	COMMAND_LINE_ARGUMENT_A* arg;
+
+	path = encoderName = NULL;
+	iterations = 1;
+
+	flags = COMMAND_LINE_SEPARATOR_SPACE;
+	flags |= COMMAND_LINE_SIGIL_DASH | COMMAND_LINE_SIGIL_DOUBLE_DASH;
+
+	status = CommandLineParseArgumentsA(argc, (const char**) argv,
+			freerds_bench_args, flags, NULL, NULL, NULL);
+
+	arg = freerds_bench_args;
+
+	do
+	{
+		if (!(arg->Flags & COMMAND_LINE_VALUE_PRESENT))
+			continue;
+
+		CommandLineSwitchStart(arg)
+
+		CommandLineSwitchCase(arg, "dir")
+		{
+			path = arg->Value;
+		}
+		CommandLineSwitchCase(arg, "encoder")
+		{
+			encoderName = arg->Value;
+		}
+		CommandLineSwitchCase(arg, "iterations")
+		{
+			iterations = atoi(arg->Value);
+		}
+
+		CommandLineSwitchEnd(arg)
+	}
+	while ((arg = CommandLineFindNextArgumentA(arg)) != NULL);
+
+	if ((status < 0) || !path || (iterations < 1))
+	{
+		printf("usage: %s --dir <directory> [--encoder <name>] [--iterations <count>]\n", argv[0]);
+		return 1;
+	}
+
+	ZeroMemory(&bench, sizeof(rdsBench));
+
+	if (freerds_bench_load(&bench, path) < 0)
+		return 1;
+
+	if (freerds_bench_connection_init(&bench) < 0)
+		return 1;
+
+	printf("%d frames of %dx%d, %d iteration(s)\n", bench.frameCount,
+			bench.frames[0]->width, bench.frames[0]->height, iterations);
+
+	bench.latencies = (UINT64*) calloc(bench.frameCount * iterations, sizeof(UINT64));
+
+	for (index = 0; index < bench.encoders->count; index++)
+	{
+		instance = &bench.encoders->instances[index];
+
+		if (encoderName && (strcmp(instance->encoder->name, encoderName) != 0))
+			continue;
+
+		freerds_bench_run(&bench, instance, iterations);
+	}
+
+	free(bench.latencies);
+
+	freerds_bench_connection_uninit(&bench);
+
+	for (index = 0; index < bench.frameCount; index++)
+		freerds_capture_frame_free(bench.frames[index]);
+
+	free(bench.frames);
+
+	return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Frame Arena Allocator
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "arena.h"
+
+#define RDS_ARENA_ALIGN(_size) (((_size) + 15) & ~((size_t) 15))
+
+static rdsArenaBlock* freerds_arena_block_new(size_t size)
+{
+	rdsArenaBlock* block;
+
+	block = (rdsArenaBlock*) malloc(RDS_ARENA_ALIGN(sizeof(rdsArenaBlock)) + size);
+
+	if (!block)
+		return NULL;
+
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	block->data = ((BYTE*) block) + RDS_ARENA_ALIGN(sizeof(rdsArenaBlock));
+
+	return block;
+}
+
+rdsArena* freerds_arena_new(size_t blockSize)
+{
+	rdsArena* arena;
+
+	arena = (rdsArena*) calloc(1, sizeof(rdsArena));
+
+	if (!arena)
+		return NULL;
+
+	arena->blockSize = blockSize;
+	arena->blocks = arena->current = freerds_arena_block_new(blockSize);
+
+	if (!arena->blocks)
+	{
+		free(arena);
+		return NULL;
+	}
+
+	return arena;
+}
+
+void freerds_arena_free(rdsArena* arena)
+{
+	rdsArenaBlock* next;
+	rdsArenaBlock* block;
+
+	if (!arena)
+		return;
+
+	block = arena->blocks;
+
+	while (block)
+	{
+		next = block->next;
+		free(block);
+		block = next;
+	}
+
+	free(arena);
+}
+
+void* freerds_arena_alloc(rdsArena* arena, size_t size)
+{
+	void* ptr;
+	rdsArenaBlock* block;
+
+	size = RDS_ARENA_ALIGN(size);
+	block = arena->current;
+
+	while ((block->used + size) > block->size)
+	{
+		if (!block->next)
+		{
+			block->next = freerds_arena_block_new(MAX(arena->blockSize, size));
+
+			if (!block->next)
+				return NULL;
+		}
+
+		block = block->next;
+		block->used = 0;
+	}
+
+	arena->current = block;
+
+	ptr = &(block->data[block->used]);
+	block->used += size;
+
+	return ptr;
+}
+
+/**
+ * Rewind to the first block. Blocks sized for the usual frame are kept,
+ * oversized blocks grown for a single large payload are released.
+ */
+
+void freerds_arena_reset(rdsArena* arena)
+{
+	rdsArenaBlock* prev;
+	rdsArenaBlock* block;
+
+	prev = arena->blocks;
+	prev->used = 0;
+
+	while ((block = prev->next) != NULL)
+	{
+		if (block->size > arena->blockSize)
+		{
+			prev->next = block->next;
+			free(block);
+			continue;
+		}
+
+		block->used = 0;
+		prev = block;
+	}
+
+	arena->current = arena->blocks;
+}
+
+static void* freerds_arena_dup(rdsArena* arena, void* data, size_t size)
+{
+	void* dup;
+
+	if (!data || !size)
+		return NULL;
+
+	dup = freerds_arena_alloc(arena, size);
+
+	if (dup)
+		CopyMemory(dup, data, size);
+
+	return dup;
+}
+
+static char* freerds_arena_strndup(rdsArena* arena, char* str, size_t length)
+{
+	char* dup;
+
+	if (!str || !length)
+		return NULL;
+
+	dup = (char*) freerds_arena_alloc(arena, length + 1);
+
+	if (dup)
+	{
+		CopyMemory(dup, str, length);
+		dup[length] = '\0';
+	}
+
+	return dup;
+}
+
+/**
+ * Only these message types carry pointers to out-of-line data.
+ */
+
+BOOL freerds_arena_message_has_payload(RDS_MSG_COMMON* msg)
+{
+	switch (msg->type)
+	{
+		case RDS_SERVER_PAINT_RECT:
+			return (((RDS_MSG_PAINT_RECT*) msg)->bitmapDataLength) ? TRUE : FALSE;
+
+		case RDS_SERVER_SET_POINTER:
+		case RDS_SERVER_LOGON_USER:
+		case RDS_SERVER_CACHE_GLYPH:
+		case RDS_SERVER_GLYPH_INDEX:
+		case RDS_SERVER_WINDOW_NEW_UPDATE:
+			return TRUE;
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Re-points the payload of a shallow message copy into the arena.
+ */
+
+int freerds_arena_copy_message_payload(rdsArena* arena, RDS_MSG_COMMON* msg)
+{
+	UINT32 index;
+
+	switch (msg->type)
+	{
+		case RDS_SERVER_PAINT_RECT:
+			{
+				RDS_MSG_PAINT_RECT* paintRect = (RDS_MSG_PAINT_RECT*) msg;
+
+				paintRect->bitmapData = freerds_arena_dup(arena,
+						paintRect->bitmapData, paintRect->bitmapDataLength);
+
+				if (!paintRect->bitmapData)
+					return -1;
+			}
+			break;
+
+		case RDS_SERVER_SET_POINTER:
+			{
+				RDS_MSG_SET_POINTER* setPointer = (RDS_MSG_SET_POINTER*) msg;
+
+				setPointer->xorMaskData = freerds_arena_dup(arena,
+						setPointer->xorMaskData, setPointer->lengthXorMask);
+				setPointer->andMaskData = freerds_arena_dup(arena,
+						setPointer->andMaskData, setPointer->lengthAndMask);
+			}
+			break;
+
+		case RDS_SERVER_LOGON_USER:
+			{
+				RDS_MSG_LOGON_USER* logonUser = (RDS_MSG_LOGON_USER*) msg;
+
+				logonUser->User = freerds_arena_strndup(arena, logonUser->User, logonUser->UserLength);
+				logonUser->Domain = freerds_arena_strndup(arena, logonUser->Domain, logonUser->DomainLength);
+				logonUser->Password = freerds_arena_strndup(arena, logonUser->Password, logonUser->PasswordLength);
+			}
+			break;
+
+		case RDS_SERVER_CACHE_GLYPH:
+			{
+				RDS_GLYPH_DATA* glyphData;
+				RDS_MSG_CACHE_GLYPH* cacheGlyph = (RDS_MSG_CACHE_GLYPH*) msg;
+
+				glyphData = cacheGlyph->glyphData;
+
+				cacheGlyph->glyphData = freerds_arena_dup(arena, glyphData,
+						cacheGlyph->cGlyphs * sizeof(RDS_GLYPH_DATA));
+				cacheGlyph->unicodeCharacters = freerds_arena_dup(arena,
+						cacheGlyph->unicodeCharacters, cacheGlyph->cGlyphs * 2);
+
+				if (!cacheGlyph->glyphData)
+					break;
+
+				for (index = 0; index < cacheGlyph->cGlyphs; index++)
+				{
+					cacheGlyph->glyphData[index].aj = freerds_arena_dup(arena,
+							glyphData[index].aj, glyphData[index].cb);
+				}
+			}
+			break;
+
+		case RDS_SERVER_GLYPH_INDEX:
+			{
+				RDS_MSG_GLYPH_INDEX* glyphIndex = (RDS_MSG_GLYPH_INDEX*) msg;
+
+				glyphIndex->data = freerds_arena_dup(arena, glyphIndex->data, glyphIndex->cbData);
+				glyphIndex->glyphs = freerds_arena_dup(arena, glyphIndex->glyphs, glyphIndex->cbGlyphs);
+			}
+			break;
+
+		case RDS_SERVER_WINDOW_NEW_UPDATE:
+			{
+				RDS_MSG_WINDOW_NEW_UPDATE* windowNewUpdate = (RDS_MSG_WINDOW_NEW_UPDATE*) msg;
+
+				windowNewUpdate->titleInfo.string = freerds_arena_dup(arena,
+						windowNewUpdate->titleInfo.string, windowNewUpdate->titleInfo.length);
+				windowNewUpdate->windowRects = freerds_arena_dup(arena, windowNewUpdate->windowRects,
+						windowNewUpdate->numWindowRects * sizeof(RECTANGLE_16));
+				windowNewUpdate->visibilityRects = freerds_arena_dup(arena, windowNewUpdate->visibilityRects,
+						windowNewUpdate->numVisibilityRects * sizeof(RECTANGLE_16));
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
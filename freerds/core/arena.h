@@ -0,0 +1,66 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Frame Arena Allocator
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_ARENA_H
+#define RDS_NG_ARENA_H
+
+#include <winpr/crt.h>
+#include <winpr/interlocked.h>
+
+#include <freerds/freerds.h>
+
+#define RDS_ARENA_FREE		0
+#define RDS_ARENA_FILLING	1
+#define RDS_ARENA_SEALED	2
+
+/**
+ * Bump allocator for message payloads copied between two pack ticks.
+ * The connector thread fills an arena, seals it at pack time and the
+ * connection thread resets it once every message of that pack is processed.
+ */
+
+struct rds_arena_block
+{
+	struct rds_arena_block* next;
+	size_t size;
+	size_t used;
+	BYTE* data;
+};
+typedef struct rds_arena_block rdsArenaBlock;
+
+struct rds_arena
+{
+	size_t blockSize;
+	rdsArenaBlock* blocks;
+	rdsArenaBlock* current;
+
+	volatile LONG state;
+	UINT32 sealHead;
+};
+
+rdsArena* freerds_arena_new(size_t blockSize);
+void freerds_arena_free(rdsArena* arena);
+
+void* freerds_arena_alloc(rdsArena* arena, size_t size);
+void freerds_arena_reset(rdsArena* arena);
+
+BOOL freerds_arena_message_has_payload(RDS_MSG_COMMON* msg);
+int freerds_arena_copy_message_payload(rdsArena* arena, RDS_MSG_COMMON* msg);
+
+#endif /* RDS_NG_ARENA_H */
@@ -0,0 +1,232 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bitmap Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#include "bitmap.h"
+
+/**
+ * Hashes a 64x64 32bpp tile, ignoring the padding byte of each pixel.
+ */
+
+static void freerds_bitmap_hash(BYTE* data, int scanline, UINT64* hash, UINT64* check)
+{
+	int x, y;
+	UINT32 pixel;
+	UINT32* row;
+	UINT64 h1, h2;
+
+	h1 = 14695981039346656037ULL;
+	h2 = 0;
+
+	for (y = 0; y < RDS_BITMAP_TILE_SIZE; y++)
+	{
+		row = (UINT32*) &data[y * scanline];
+
+		for (x = 0; x < RDS_BITMAP_TILE_SIZE; x++)
+		{
+			pixel = row[x] & 0x00FFFFFF;
+
+			h1 = (h1 ^ pixel) * 1099511628211ULL;
+
+			h2 = (h2 + pixel) * 0x9E3779B97F4A7C15ULL;
+			h2 ^= (h2 >> 29);
+		}
+	}
+
+	*hash = h1;
+	*check = h2;
+}
+
+rdsBitmapCache* freerds_bitmap_cache_new(rdpSettings* settings)
+{
+	int index;
+	rdsBitmapCache* cache;
+
+	cache = (rdsBitmapCache*) calloc(1, sizeof(rdsBitmapCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->cacheId = RDS_BITMAP_CACHE_ID;
+	cache->scratchIndex = -1;
+	cache->head = cache->tail = -1;
+
+	for (index = 0; index < RDS_BITMAP_CACHE_BUCKETS; index++)
+		cache->buckets[index] = -1;
+
+	if (!settings->BitmapCacheEnabled || (settings->BitmapCacheV2NumCells <= RDS_BITMAP_CACHE_ID))
+		return cache;
+
+	cache->numEntries = MIN(settings->BitmapCacheV2CellInfo[RDS_BITMAP_CACHE_ID].numEntries,
+			RDS_BITMAP_CACHE_MAX_ENTRIES);
+	cache->persistent = settings->BitmapCacheV2CellInfo[RDS_BITMAP_CACHE_ID].persistent ? TRUE : FALSE;
+
+	if (!cache->numEntries)
+		return cache;
+
+	cache->entries = (rdsBitmapEntry*) calloc(cache->numEntries, sizeof(rdsBitmapEntry));
+
+	if (!cache->entries)
+	{
+		cache->numEntries = 0;
+		return cache;
+	}
+
+	if (cache->numEntries > 1)
+		cache->scratchIndex = --cache->numEntries;
+
+	return cache;
+}
+
+void freerds_bitmap_cache_free(rdsBitmapCache* cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->entries);
+	free(cache);
+}
+
+static void freerds_bitmap_cache_unlink(rdsBitmapCache* cache, int index)
+{
+	rdsBitmapEntry* entry = &cache->entries[index];
+
+	if (entry->prev >= 0)
+		cache->entries[entry->prev].next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if (entry->next >= 0)
+		cache->entries[entry->next].prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+}
+
+static void freerds_bitmap_cache_link(rdsBitmapCache* cache, int index)
+{
+	rdsBitmapEntry* entry = &cache->entries[index];
+
+	entry->prev = -1;
+	entry->next = cache->head;
+
+	if (cache->head >= 0)
+		cache->entries[cache->head].prev = index;
+	else
+		cache->tail = index;
+
+	cache->head = index;
+}
+
+static void freerds_bitmap_cache_unchain(rdsBitmapCache* cache, int index)
+{
+	int* link;
+	rdsBitmapEntry* entry = &cache->entries[index];
+
+	link = &cache->buckets[entry->hash % RDS_BITMAP_CACHE_BUCKETS];
+
+	while (*link >= 0)
+	{
+		if (*link == index)
+		{
+			*link = entry->chain;
+			break;
+		}
+
+		link = &cache->entries[*link].chain;
+	}
+}
+
+/**
+ * Returns the client cache index holding the tile, or the index it has to be
+ * sent to when cached is FALSE, or -1 when the tile should not be cached.
+ */
+
+int freerds_bitmap_cache_get(rdsBitmapCache* cache, BYTE* data, int scanline, BOOL* cached, UINT64* key)
+{
+	int index;
+	int bucket;
+	UINT32 slot;
+	UINT64 hash;
+	UINT64 check;
+	rdsBitmapEntry* entry;
+
+	if (!cache->numEntries)
+		return -1;
+
+	freerds_bitmap_hash(data, scanline, &hash, &check);
+
+	bucket = (int) (hash % RDS_BITMAP_CACHE_BUCKETS);
+
+	for (index = cache->buckets[bucket]; index >= 0; index = entry->chain)
+	{
+		entry = &cache->entries[index];
+
+		if ((entry->hash == hash) && (entry->check == check))
+		{
+			if (cache->head != index)
+			{
+				freerds_bitmap_cache_unlink(cache, index);
+				freerds_bitmap_cache_link(cache, index);
+			}
+
+			*key = hash;
+			*cached = TRUE;
+			return index;
+		}
+	}
+
+	slot = (UINT32) ((hash >> 32) % RDS_BITMAP_CACHE_SEEN);
+
+	if (cache->seen[slot] != hash)
+	{
+		cache->seen[slot] = hash;
+		return -1;
+	}
+
+	cache->seen[slot] = 0;
+
+	if (cache->count < cache->numEntries)
+	{
+		index = cache->count++;
+	}
+	else
+	{
+		index = cache->tail;
+		freerds_bitmap_cache_unlink(cache, index);
+		freerds_bitmap_cache_unchain(cache, index);
+	}
+
+	entry = &cache->entries[index];
+
+	entry->hash = hash;
+	entry->check = check;
+	entry->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = index;
+
+	freerds_bitmap_cache_link(cache, index);
+
+	*key = hash;
+	*cached = FALSE;
+	return index;
+}
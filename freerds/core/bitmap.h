@@ -0,0 +1,76 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bitmap Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_BITMAP_H
+#define RDS_NG_BITMAP_H
+
+#include "core.h"
+
+#define RDS_BITMAP_TILE_SIZE		64
+#define RDS_BITMAP_CACHE_ID		2
+#define RDS_BITMAP_CACHE_MAX_ENTRIES	4096
+#define RDS_BITMAP_CACHE_BUCKETS	1024
+#define RDS_BITMAP_CACHE_SEEN		512
+
+#ifndef CBR2_PERSISTENT_KEY_PRESENT
+#define CBR2_PERSISTENT_KEY_PRESENT	0x02
+#endif
+
+/**
+ * Server-side mirror of the client 64x64 bitmap cache (BitmapCacheV2, cell 2).
+ *
+ * Tiles are keyed by a 64-bit content hash, which doubles as the persistent
+ * key, and checked against a second independent hash on lookup. A tile is
+ * only admitted the second time it is seen, so one-off content does not
+ * evict tiles that keep coming back (toolbars, icons, window chrome).
+ * The last client cell is kept out of the LRU as a scratch slot for
+ * bitmaps that are drawn once, such as offscreen surface uploads.
+ */
+
+struct rds_bitmap_entry
+{
+	UINT64 hash;
+	UINT64 check;
+	int prev;
+	int next;
+	int chain;
+};
+typedef struct rds_bitmap_entry rdsBitmapEntry;
+
+struct rds_bitmap_cache
+{
+	int cacheId;
+	BOOL persistent;
+	UINT32 numEntries;
+	UINT32 count;
+	int scratchIndex;
+	int head;
+	int tail;
+	int buckets[RDS_BITMAP_CACHE_BUCKETS];
+	UINT64 seen[RDS_BITMAP_CACHE_SEEN];
+	rdsBitmapEntry* entries;
+};
+typedef struct rds_bitmap_cache rdsBitmapCache;
+
+rdsBitmapCache* freerds_bitmap_cache_new(rdpSettings* settings);
+void freerds_bitmap_cache_free(rdsBitmapCache* cache);
+
+int freerds_bitmap_cache_get(rdsBitmapCache* cache, BYTE* data, int scanline, BOOL* cached, UINT64* key);
+
+#endif /* RDS_NG_BITMAP_H */
@@ -0,0 +1,220 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Framebuffer Capture
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include "capture.h"
+
+static LONG g_capture_count = 0;
+
+rdsCapture* freerds_capture_new(const char* path)
+{
+	rdsCapture* capture;
+
+	if (!path || !*path)
+		return NULL;
+
+	capture = (rdsCapture*) calloc(1, sizeof(rdsCapture));
+
+	if (!capture)
+		return NULL;
+
+	capture->path = _strdup(path);
+	capture->id = (UINT32) InterlockedIncrement(&g_capture_count);
+	capture->processId = GetCurrentProcessId();
+
+	printf("capturing frames to %s/frame-%u-%04u-*.rdsf\n", capture->path,
+			(UINT32) capture->processId, capture->id);
+
+	return capture;
+}
+
+void freerds_capture_free(rdsCapture* capture)
+{
+	if (!capture)
+		return;
+
+	free(capture->path);
+	free(capture);
+}
+
+int freerds_capture_write(rdsCapture* capture, RDS_FRAMEBUFFER* framebuffer, pixman_region32_t* damage)
+{
+	int index;
+	int count;
+	FILE* fp;
+	wStream* s;
+	char filename[1024];
+	pixman_box32_t* boxes;
+
+	if (!capture || !framebuffer->fbAttached)
+		return 0;
+
+	boxes = pixman_region32_rectangles(damage, &count);
+
+	if ((count < 1) || (count > RDS_CAPTURE_MAX_RECTS))
+		return 0;
+
+	sprintf_s(filename, sizeof(filename), "%s/frame-%u-%04u-%08u.rdsf", capture->path,
+			(UINT32) capture->processId, capture->id, capture->index);
+
+	fp = fopen(filename, "wb");
+
+	if (!fp)
+	{
+		printf("%s: failed to open %s\n", __FUNCTION__, filename);
+		return -1;
+	}
+
+	s = Stream_New(NULL, RDS_CAPTURE_HEADER_SIZE + (count * 16));
+
+	Stream_Write_UINT32(s, RDS_CAPTURE_MAGIC);
+	Stream_Write_UINT32(s, framebuffer->fbWidth);
+	Stream_Write_UINT32(s, framebuffer->fbHeight);
+	Stream_Write_UINT32(s, framebuffer->fbScanline);
+	Stream_Write_UINT32(s, framebuffer->fbBitsPerPixel);
+	Stream_Write_UINT32(s, count);
+
+	for (index = 0; index < count; index++)
+	{
+		Stream_Write_UINT32(s, boxes[index].x1);
+		Stream_Write_UINT32(s, boxes[index].y1);
+		Stream_Write_UINT32(s, boxes[index].x2 - boxes[index].x1);
+		Stream_Write_UINT32(s, boxes[index].y2 - boxes[index].y1);
+	}
+
+	fwrite(Stream_Buffer(s), 1, Stream_GetPosition(s), fp);
+	fwrite(framebuffer->fbSharedMemory, 1, framebuffer->fbHeight * framebuffer->fbScanline, fp);
+
+	fclose(fp);
+	Stream_Free(s, TRUE);
+
+	capture->index++;
+
+	return 1;
+}
+
+static int freerds_capture_frame_parse(FILE* fp, wStream* s, rdsCaptureFrame* frame)
+{
+	UINT32 index;
+	UINT32 magic;
+	size_t size;
+
+	if (fread(Stream_Buffer(s), 1, RDS_CAPTURE_HEADER_SIZE, fp) != RDS_CAPTURE_HEADER_SIZE)
+		return -1;
+
+	Stream_Read_UINT32(s, magic);
+	Stream_Read_UINT32(s, frame->width);
+	Stream_Read_UINT32(s, frame->height);
+	Stream_Read_UINT32(s, frame->scanline);
+	Stream_Read_UINT32(s, frame->bpp);
+	Stream_Read_UINT32(s, frame->numRects);
+
+	if ((magic != RDS_CAPTURE_MAGIC) || (frame->bpp != 32) || (frame->scanline < frame->width * 4) ||
+			(frame->numRects < 1) || (frame->numRects > RDS_CAPTURE_MAX_RECTS))
+		return -1;
+
+	Stream_SetPosition(s, 0);
+	size = frame->numRects * 16;
+
+	if (fread(Stream_Buffer(s), 1, size, fp) != size)
+		return -1;
+
+	frame->rects = (RDS_RECT*) calloc(frame->numRects, sizeof(RDS_RECT));
+
+	if (!frame->rects)
+		return -1;
+
+	for (index = 0; index < frame->numRects; index++)
+	{
+		Stream_Read_UINT32(s, frame->rects[index].x);
+		Stream_Read_UINT32(s, frame->rects[index].y);
+		Stream_Read_UINT32(s, frame->rects[index].width);
+		Stream_Read_UINT32(s, frame->rects[index].height);
+
+		if ((frame->rects[index].x + frame->rects[index].width > frame->width) ||
+				(frame->rects[index].y + frame->rects[index].height > frame->height))
+			return -1;
+	}
+
+	size = frame->height * frame->scanline;
+	frame->data = (BYTE*) malloc(size);
+
+	if (!frame->data || (fread(frame->data, 1, size, fp) != size))
+		return -1;
+
+	return 0;
+}
+
+rdsCaptureFrame* freerds_capture_frame_read(const char* filename)
+{
+	int status;
+	FILE* fp;
+	wStream* s;
+	rdsCaptureFrame* frame;
+
+	frame = (rdsCaptureFrame*) calloc(1, sizeof(rdsCaptureFrame));
+
+	if (!frame)
+		return NULL;
+
+	fp = fopen(filename, "rb");
+
+	if (!fp)
+	{
+		free(frame);
+		return NULL;
+	}
+
+	s = Stream_New(NULL, RDS_CAPTURE_MAX_RECTS * 16);
+
+	status = freerds_capture_frame_parse(fp, s, frame);
+
+	Stream_Free(s, TRUE);
+	fclose(fp);
+
+	if (status < 0)
+	{
+		printf("%s: %s is not a valid capture\n", __FUNCTION__, filename);
+		freerds_capture_frame_free(frame);
+		return NULL;
+	}
+
+	return frame;
+}
+
+void freerds_capture_frame_free(rdsCaptureFrame* frame)
+{
+	if (!frame)
+		return;
+
+	free(frame->rects);
+	free(frame->data);
+	free(frame);
+}
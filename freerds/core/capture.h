@@ -0,0 +1,77 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Framebuffer Capture
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_CAPTURE_H
+#define RDS_NG_CAPTURE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerds/freerds.h>
+
+#include <pixman.h>
+
+#define RDS_CAPTURE_MAGIC		0x46534452 /* "RDSF" */
+#define RDS_CAPTURE_HEADER_SIZE		24
+#define RDS_CAPTURE_MAX_RECTS		4096
+
+/**
+ * Recorded frames, used to replay real sessions through the encoders.
+ *
+ * Setting FREERDS_CAPTURE_DIR makes every connection write one file per
+ * update (frame-PID-NNNN-NNNNNNNN.rdsf, by process, connection and update) to
+ * that directory, so that concurrent sessions do not overwrite each other.
+ * Files are written synchronously on the connection thread, the whole
+ * framebuffer every time: capturing slows the session down and is meant for
+ * recording test material only. All values are little endian:
+ *
+ * UINT32 magic, width, height, scanline, bpp, numRects
+ * numRects x { UINT32 x, y, width, height }: the damage of the update
+ * height x scanline bytes: the whole shared framebuffer, top-down
+ */
+
+struct rds_capture
+{
+	char* path;
+	UINT32 id;
+	UINT32 index;
+	DWORD processId;
+};
+typedef struct rds_capture rdsCapture;
+
+struct rds_capture_frame
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 scanline;
+	UINT32 bpp;
+	UINT32 numRects;
+	RDS_RECT* rects;
+	BYTE* data;
+};
+typedef struct rds_capture_frame rdsCaptureFrame;
+
+rdsCapture* freerds_capture_new(const char* path);
+void freerds_capture_free(rdsCapture* capture);
+
+int freerds_capture_write(rdsCapture* capture, RDS_FRAMEBUFFER* framebuffer, pixman_region32_t* damage);
+
+rdsCaptureFrame* freerds_capture_frame_read(const char* filename);
+void freerds_capture_frame_free(rdsCaptureFrame* frame);
+
+#endif /* RDS_NG_CAPTURE_H */
@@ -0,0 +1,160 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Tile Classification
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+
+#include "classify.h"
+
+#define RDS_TILE_COLOR_SLOTS		(RDS_TILE_TEXT_COLORS * 2)
+
+/**
+ * Unique colors are counted in a small open addressing set,
+ * and counting stops as soon as the text threshold is exceeded.
+ */
+
+static BOOL freerds_tile_color_add(UINT32* slots, int* count, UINT32 pixel)
+{
+	UINT32 index;
+
+	index = ((pixel * 0x9E3779B1) >> 25) & (RDS_TILE_COLOR_SLOTS - 1);
+
+	while (slots[index] != 0xFFFFFFFF)
+	{
+		if (slots[index] == pixel)
+			return TRUE;
+
+		index = (index + 1) & (RDS_TILE_COLOR_SLOTS - 1);
+	}
+
+	if (*count >= RDS_TILE_TEXT_COLORS)
+		return FALSE;
+
+	slots[index] = pixel;
+	(*count)++;
+
+	return TRUE;
+}
+
+static int freerds_tile_distance(UINT32 a, UINT32 b)
+{
+	int d;
+	int distance;
+
+	distance = abs((int) ((a >> 16) & 0xFF) - (int) ((b >> 16) & 0xFF));
+
+	d = abs((int) ((a >> 8) & 0xFF) - (int) ((b >> 8) & 0xFF));
+
+	if (d > distance)
+		distance = d;
+
+	d = abs((int) (a & 0xFF) - (int) (b & 0xFF));
+
+	if (d > distance)
+		distance = d;
+
+	return distance;
+}
+
+int freerds_tile_classify(const BYTE* data, int scanline, int width, int height, UINT32* color)
+{
+	int x, y;
+	int count;
+	int pairs;
+	int flat;
+	int edges;
+	int distance;
+	BOOL solid;
+	BOOL fewColors;
+	UINT32 first;
+	UINT32 pixel;
+	UINT32 previous;
+	const UINT32* line;
+	UINT32 slots[RDS_TILE_COLOR_SLOTS];
+
+	if ((width < 1) || (height < 1))
+		return RDS_TILE_PHOTO;
+
+	FillMemory(slots, sizeof(slots), 0xFF);
+
+	count = 0;
+	pairs = flat = edges = 0;
+	solid = fewColors = TRUE;
+	first = *((const UINT32*) data) & 0xFFFFFF;
+
+	for (y = 0; y < height; y++)
+	{
+		line = (const UINT32*) &data[y * scanline];
+		previous = line[0] & 0xFFFFFF;
+
+		for (x = 0; x < width; x++)
+		{
+			pixel = line[x] & 0xFFFFFF;
+
+			if (solid && (pixel != first))
+				solid = FALSE;
+
+			if (fewColors)
+				fewColors = freerds_tile_color_add(slots, &count, pixel);
+
+			if (x > 0)
+			{
+				pairs++;
+
+				if (pixel == previous)
+				{
+					flat++;
+				}
+				else
+				{
+					distance = freerds_tile_distance(pixel, previous);
+
+					if (distance >= RDS_TILE_EDGE_THRESHOLD)
+						edges++;
+				}
+			}
+
+			previous = pixel;
+		}
+	}
+
+	if (solid)
+	{
+		*color = first;
+		return RDS_TILE_SOLID;
+	}
+
+	if (fewColors)
+		return RDS_TILE_TEXT;
+
+	/**
+	 * Antialiased text and UI are made of flat runs and hard edges,
+	 * while natural images are mostly small gradual variations.
+	 */
+
+	if ((flat + edges) * 8 >= pairs * 7)
+		return RDS_TILE_TEXT;
+
+	return RDS_TILE_PHOTO;
+}
@@ -0,0 +1,45 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Tile Classification
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_CLASSIFY_H
+#define RDS_NG_CLASSIFY_H
+
+#include <winpr/wtypes.h>
+
+#define RDS_TILE_SOLID			1
+#define RDS_TILE_TEXT			2
+#define RDS_TILE_PHOTO			3
+
+#define RDS_TILE_TEXT_COLORS		64
+#define RDS_TILE_EDGE_THRESHOLD		48
+
+/**
+ * Classifies a block of 32bpp framebuffer pixels by content:
+ *
+ * RDS_TILE_SOLID: a single color, returned in *color.
+ * RDS_TILE_TEXT: few colors, or mostly flat runs and hard edges (text, UI).
+ * RDS_TILE_PHOTO: anything else (natural images, video).
+ *
+ * Text tiles are best sent through a lossless codec,
+ * photographic tiles through a lossy one.
+ */
+
+int freerds_tile_classify(const BYTE* data, int scanline, int width, int height, UINT32* color);
+
+#endif /* RDS_NG_CLASSIFY_H */
@@ -21,6 +21,7 @@
 #endif
 
 #include "freerds.h"
+#include "ring.h"
 
 #include <winpr/pipe.h>
 #include <winpr/path.h>
@@ -93,7 +94,7 @@ int freerds_client_get_event_handles(rdsModuleConnector* connector, HANDLE* even
 	{
 		if (connector->ServerQueue)
 		{
-			events[*nCount] = MessageQueue_Event(connector->ServerQueue);
+			events[*nCount] = freerds_message_ring_event(connector->ServerQueue);
 			(*nCount)++;
 		}
 	}
@@ -109,7 +110,7 @@ int freerds_client_check_event_handles(rdsModuleConnector* connector)
 	if (!connector)
 		return 0;
 
-	while (WaitForSingleObject(MessageQueue_Event(connector->ServerQueue), 0) == WAIT_OBJECT_0)
+	if (WaitForSingleObject(freerds_message_ring_event(connector->ServerQueue), 0) == WAIT_OBJECT_0)
 	{
 		status = freerds_message_server_queue_process_pending_messages(connector);
 	}
@@ -0,0 +1,380 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Color Conversion
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#include "color.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+#define WITH_COLOR_SIMD	1
+#include <immintrin.h>
+#endif
+
+#define FREERDS_COLOR_565(_p) \
+	((UINT16) ((((_p) >> 8) & 0xF800) | (((_p) >> 5) & 0x07E0) | (((_p) >> 3) & 0x001F)))
+
+#define FREERDS_COLOR_555(_p) \
+	((UINT16) ((((_p) >> 9) & 0x7C00) | (((_p) >> 6) & 0x03E0) | (((_p) >> 3) & 0x001F)))
+
+static pFreeRdsColorConvert g_ColorConvert555 = NULL;
+static pFreeRdsColorConvert g_ColorConvert565 = NULL;
+static pFreeRdsColorConvert g_ColorConvert24 = NULL;
+static volatile LONG g_ColorConvertState = 0;
+
+/**
+ * Generic C
+ */
+
+static void freerds_color_convert_555_c(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x < width; x++)
+			dst[x] = FREERDS_COLOR_555(src[x]);
+	}
+}
+
+static void freerds_color_convert_565_c(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x < width; x++)
+			dst[x] = FREERDS_COLOR_565(src[x]);
+	}
+}
+
+static void freerds_color_convert_24_c(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	BYTE* dst;
+	const BYTE* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = &pSrc[y * srcStep];
+		dst = &pDst[y * dstStep];
+
+		for (x = 0; x < width; x++)
+		{
+			*dst++ = src[0];
+			*dst++ = src[1];
+			*dst++ = src[2];
+			src += 4;
+		}
+	}
+}
+
+#ifdef WITH_COLOR_SIMD
+
+/**
+ * SSE2: 8 pixels per iteration
+ *
+ * The 16-bit results are sign-extended before the saturating pack so that
+ * values above 0x7FFF come out unchanged.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i freerds_color_pack16_sse2(__m128i p, int shiftR, int maskR, int shiftG, int maskG)
+{
+	__m128i v;
+
+	v = _mm_and_si128(_mm_srli_epi32(p, shiftR), _mm_set1_epi32(maskR));
+	v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(p, shiftG), _mm_set1_epi32(maskG)));
+	v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F)));
+
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("sse2")))
+static void freerds_color_convert_555_sse2(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	__m128i p0, p1;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x + 8 <= width; x += 8)
+		{
+			p0 = freerds_color_pack16_sse2(_mm_loadu_si128((const __m128i*) &src[x]), 9, 0x7C00, 6, 0x03E0);
+			p1 = freerds_color_pack16_sse2(_mm_loadu_si128((const __m128i*) &src[x + 4]), 9, 0x7C00, 6, 0x03E0);
+			_mm_storeu_si128((__m128i*) &dst[x], _mm_packs_epi32(p0, p1));
+		}
+
+		for (; x < width; x++)
+			dst[x] = FREERDS_COLOR_555(src[x]);
+	}
+}
+
+__attribute__((target("sse2")))
+static void freerds_color_convert_565_sse2(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	__m128i p0, p1;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x + 8 <= width; x += 8)
+		{
+			p0 = freerds_color_pack16_sse2(_mm_loadu_si128((const __m128i*) &src[x]), 8, 0xF800, 5, 0x07E0);
+			p1 = freerds_color_pack16_sse2(_mm_loadu_si128((const __m128i*) &src[x + 4]), 8, 0xF800, 5, 0x07E0);
+			_mm_storeu_si128((__m128i*) &dst[x], _mm_packs_epi32(p0, p1));
+		}
+
+		for (; x < width; x++)
+			dst[x] = FREERDS_COLOR_565(src[x]);
+	}
+}
+
+/**
+ * SSSE3: 4 pixels per iteration, the padding bytes are dropped with a shuffle
+ */
+
+__attribute__((target("ssse3")))
+static void freerds_color_convert_24_ssse3(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	__m128i p;
+	__m128i shuffle;
+	BYTE* dst;
+	const BYTE* src;
+
+	shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	for (y = 0; y < height; y++)
+	{
+		src = &pSrc[y * srcStep];
+		dst = &pDst[y * dstStep];
+
+		for (x = 0; x + 4 <= width; x += 4)
+		{
+			p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) src), shuffle);
+			_mm_storel_epi64((__m128i*) dst, p);
+			*((UINT32*) &dst[8]) = (UINT32) _mm_cvtsi128_si32(_mm_srli_si128(p, 8));
+			src += 16;
+			dst += 12;
+		}
+
+		for (; x < width; x++)
+		{
+			*dst++ = src[0];
+			*dst++ = src[1];
+			*dst++ = src[2];
+			src += 4;
+		}
+	}
+}
+
+/**
+ * AVX2: 16 pixels per iteration
+ *
+ * The pack works within 128-bit lanes, so the quadwords are put back in
+ * order with a permute before the store.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256i freerds_color_pack16_avx2(__m256i p, int shiftR, int maskR, int shiftG, int maskG)
+{
+	__m256i v;
+
+	v = _mm256_and_si256(_mm256_srli_epi32(p, shiftR), _mm256_set1_epi32(maskR));
+	v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srli_epi32(p, shiftG), _mm256_set1_epi32(maskG)));
+	v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001F)));
+
+	return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("avx2")))
+static void freerds_color_convert_555_avx2(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	__m256i p0, p1;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			p0 = freerds_color_pack16_avx2(_mm256_loadu_si256((const __m256i*) &src[x]), 9, 0x7C00, 6, 0x03E0);
+			p1 = freerds_color_pack16_avx2(_mm256_loadu_si256((const __m256i*) &src[x + 8]), 9, 0x7C00, 6, 0x03E0);
+			_mm256_storeu_si256((__m256i*) &dst[x], _mm256_permute4x64_epi64(_mm256_packs_epi32(p0, p1), 0xD8));
+		}
+
+		for (; x < width; x++)
+			dst[x] = FREERDS_COLOR_555(src[x]);
+	}
+}
+
+__attribute__((target("avx2")))
+static void freerds_color_convert_565_avx2(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height)
+{
+	int x, y;
+	__m256i p0, p1;
+	UINT16* dst;
+	const UINT32* src;
+
+	for (y = 0; y < height; y++)
+	{
+		src = (const UINT32*) &pSrc[y * srcStep];
+		dst = (UINT16*) &pDst[y * dstStep];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			p0 = freerds_color_pack16_avx2(_mm256_loadu_si256((const __m256i*) &src[x]), 8, 0xF800, 5, 0x07E0);
+			p1 = freerds_color_pack16_avx2(_mm256_loadu_si256((const __m256i*) &src[x + 8]), 8, 0xF800, 5, 0x07E0);
+			_mm256_storeu_si256((__m256i*) &dst[x], _mm256_permute4x64_epi64(_mm256_packs_epi32(p0, p1), 0xD8));
+		}
+
+		for (; x < width; x++)
+			dst[x] = FREERDS_COLOR_565(src[x]);
+	}
+}
+
+#endif /* WITH_COLOR_SIMD */
+
+static void freerds_color_converter_init(void)
+{
+	g_ColorConvert555 = freerds_color_convert_555_c;
+	g_ColorConvert565 = freerds_color_convert_565_c;
+	g_ColorConvert24 = freerds_color_convert_24_c;
+
+#ifdef WITH_COLOR_SIMD
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2"))
+	{
+		g_ColorConvert555 = freerds_color_convert_555_sse2;
+		g_ColorConvert565 = freerds_color_convert_565_sse2;
+	}
+
+	if (__builtin_cpu_supports("ssse3"))
+		g_ColorConvert24 = freerds_color_convert_24_ssse3;
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		g_ColorConvert555 = freerds_color_convert_555_avx2;
+		g_ColorConvert565 = freerds_color_convert_565_avx2;
+	}
+#endif
+}
+
+pFreeRdsColorConvert freerds_color_converter(int bpp)
+{
+	LONG state;
+
+	state = InterlockedCompareExchange(&g_ColorConvertState, 1, 0);
+
+	if (state == 0)
+	{
+		freerds_color_converter_init();
+		InterlockedExchange(&g_ColorConvertState, 2);
+	}
+	else
+	{
+		while (InterlockedCompareExchange(&g_ColorConvertState, 2, 2) != 2)
+			Sleep(1);
+	}
+
+	switch (bpp)
+	{
+		case 15:
+			return g_ColorConvert555;
+
+		case 16:
+			return g_ColorConvert565;
+
+		case 24:
+			return g_ColorConvert24;
+
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+int freerds_color_convert(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height, int bpp)
+{
+	pFreeRdsColorConvert convert;
+
+	convert = freerds_color_converter(bpp);
+
+	if (!convert)
+		return -1;
+
+	convert(pSrc, srcStep, pDst, dstStep, width, height);
+
+	return 0;
+}
+
+/**
+ * Converts a single framebuffer pixel to the color of a drawing order,
+ * which is sent as RGB (red in the low byte) at 24 and 32bpp.
+ */
+
+UINT32 freerds_color_pixel(UINT32 pixel, int bpp)
+{
+	switch (bpp)
+	{
+		case 15:
+			return FREERDS_COLOR_555(pixel);
+
+		case 16:
+			return FREERDS_COLOR_565(pixel);
+
+		default:
+			break;
+	}
+
+	return ((pixel >> 16) & 0xFF) | (pixel & 0xFF00) | ((pixel & 0xFF) << 16);
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Color Conversion
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_COLOR_H
+#define RDS_NG_COLOR_H
+
+#include <winpr/wtypes.h>
+
+/**
+ * Conversion of 32bpp BGRX framebuffer pixels to the formats of the
+ * interleaved (bitmap) encoder: RGB555, RGB565 and 24bpp BGR.
+ *
+ * The fastest implementation supported by the CPU is picked on first use.
+ * Lines may not overlap, and the destination is packed as the encoder
+ * expects it, without any alignment requirement.
+ */
+
+typedef void (*pFreeRdsColorConvert)(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height);
+
+pFreeRdsColorConvert freerds_color_converter(int bpp);
+
+int freerds_color_convert(const BYTE* pSrc, int srcStep, BYTE* pDst, int dstStep, int width, int height, int bpp);
+
+UINT32 freerds_color_pixel(UINT32 pixel, int bpp);
+
+#endif /* RDS_NG_COLOR_H */
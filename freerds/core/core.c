@@ -26,9 +26,21 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/listener.h>
 #include <freerdp/codec/rfx.h>
+#include <freerdp/codec/color.h>
 #include <freerdp/codec/bitmap.h>
 
 #include "core.h"
+#include "pool.h"
+#include "frame.h"
+#include "glyph.h"
+#include "pointer.h"
+#include "bitmap.h"
+#include "offscreen.h"
+#include "color.h"
+#include "transmit.h"
+#include "estimator.h"
+#include "encoder.h"
+#include "capture.h"
 
 #include <pixman.h>
 
@@ -59,8 +71,489 @@ int freerds_set_bounds_rect(rdsConnection* connection, xrdpRect* rect)
 	return 0;
 }
 
+/**
+ * Shadow framebuffer: a copy of what was last sent to the client.
+ * Damaged areas are compared against it in 64x64 tiles so that
+ * only tiles which really changed are handed to the encoders.
+ * A tile is compared only once it has been fully sent at least once.
+ */
+
+#define RDS_SHADOW_TILE_SIZE	64
+
+void freerds_shadow_framebuffer_invalidate(rdsConnection* connection)
+{
+	int tileCount;
+
+	if (!connection->shadowTiles)
+		return;
+
+	tileCount = ((connection->shadowWidth + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE) *
+			((connection->shadowHeight + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE);
+
+	ZeroMemory(connection->shadowTiles, tileCount);
+}
+
+void freerds_shadow_framebuffer_invalidate_rect(rdsConnection* connection, int x, int y, int width, int height)
+{
+	int tileX, tileY;
+	int tilesX, tilesY;
+	int left, top;
+	int right, bottom;
+
+	if (!connection->shadowTiles)
+		return;
+
+	tilesX = (connection->shadowWidth + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE;
+	tilesY = (connection->shadowHeight + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE;
+
+	left = MAX(x, 0) / RDS_SHADOW_TILE_SIZE;
+	top = MAX(y, 0) / RDS_SHADOW_TILE_SIZE;
+	right = MIN((x + width + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE, tilesX);
+	bottom = MIN((y + height + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE, tilesY);
+
+	for (tileY = top; tileY < bottom; tileY++)
+	{
+		for (tileX = left; tileX < right; tileX++)
+			connection->shadowTiles[(tileY * tilesX) + tileX] = 0;
+	}
+}
+
+static int freerds_shadow_framebuffer_check(rdsConnection* connection, RDS_FRAMEBUFFER* framebuffer)
+{
+	int tileCount;
+
+	if ((connection->shadowWidth != framebuffer->fbWidth) ||
+			(connection->shadowHeight != framebuffer->fbHeight) ||
+			(connection->shadowScanline != framebuffer->fbScanline))
+	{
+		free(connection->shadow);
+		free(connection->shadowTiles);
+
+		connection->shadowWidth = framebuffer->fbWidth;
+		connection->shadowHeight = framebuffer->fbHeight;
+		connection->shadowScanline = framebuffer->fbScanline;
+
+		tileCount = ((connection->shadowWidth + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE) *
+				((connection->shadowHeight + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE);
+
+		connection->shadow = (BYTE*) malloc(connection->shadowScanline * connection->shadowHeight);
+		connection->shadowTiles = (BYTE*) calloc(1, tileCount);
+
+		if (!connection->shadow || !connection->shadowTiles)
+		{
+			free(connection->shadow);
+			free(connection->shadowTiles);
+
+			connection->shadow = NULL;
+			connection->shadowTiles = NULL;
+			connection->shadowWidth = connection->shadowHeight = connection->shadowScanline = 0;
+
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int freerds_shadow_framebuffer_diff(rdsConnection* connection, RDS_MSG_PAINT_RECT* msg, pixman_region32_t* region)
+{
+	int x, y;
+	int row;
+	int tilesX;
+	int left, top;
+	int right, bottom;
+	int tileLeft, tileTop;
+	int tileWidth, tileHeight;
+	int scanline;
+	int bytesPerPixel;
+	BOOL changed;
+	BOOL complete;
+	BYTE* src;
+	BYTE* dst;
+	BYTE* tileState;
+	RDS_FRAMEBUFFER* framebuffer;
+
+	framebuffer = msg->framebuffer;
+
+	left = MAX(msg->nLeftRect, 0);
+	top = MAX(msg->nTopRect, 0);
+	right = MIN(msg->nLeftRect + msg->nWidth, framebuffer->fbWidth);
+	bottom = MIN(msg->nTopRect + msg->nHeight, framebuffer->fbHeight);
+
+	if ((right <= left) || (bottom <= top))
+		return 0;
+
+	if (freerds_shadow_framebuffer_check(connection, framebuffer) < 0)
+	{
+		pixman_region32_union_rect(region, region, left, top, right - left, bottom - top);
+		return 0;
+	}
+
+	scanline = framebuffer->fbScanline;
+	bytesPerPixel = framebuffer->fbBytesPerPixel;
+	tilesX = (framebuffer->fbWidth + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE;
+
+	for (y = top - (top % RDS_SHADOW_TILE_SIZE); y < bottom; y += RDS_SHADOW_TILE_SIZE)
+	{
+		for (x = left - (left % RDS_SHADOW_TILE_SIZE); x < right; x += RDS_SHADOW_TILE_SIZE)
+		{
+			tileLeft = MAX(x, left);
+			tileTop = MAX(y, top);
+			tileWidth = MIN(x + RDS_SHADOW_TILE_SIZE, right) - tileLeft;
+			tileHeight = MIN(y + RDS_SHADOW_TILE_SIZE, bottom) - tileTop;
+
+			tileState = &connection->shadowTiles[((y / RDS_SHADOW_TILE_SIZE) * tilesX) + (x / RDS_SHADOW_TILE_SIZE)];
+
+			complete = (tileLeft == x) && (tileTop == y) &&
+					(tileWidth == MIN(RDS_SHADOW_TILE_SIZE, framebuffer->fbWidth - x)) &&
+					(tileHeight == MIN(RDS_SHADOW_TILE_SIZE, framebuffer->fbHeight - y));
+
+			src = &((BYTE*) framebuffer->fbSharedMemory)[(tileTop * scanline) + (tileLeft * bytesPerPixel)];
+			dst = &connection->shadow[(tileTop * scanline) + (tileLeft * bytesPerPixel)];
+
+			changed = !(*tileState);
+
+			for (row = 0; row < tileHeight; row++)
+			{
+				if (changed || memcmp(src, dst, tileWidth * bytesPerPixel))
+				{
+					changed = TRUE;
+					CopyMemory(dst, src, tileWidth * bytesPerPixel);
+				}
+
+				src += scanline;
+				dst += scanline;
+			}
+
+			if (complete)
+				*tileState = 1;
+
+			if (changed)
+				pixman_region32_union_rect(region, region, tileLeft, tileTop, tileWidth, tileHeight);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Motion detection: when the lines (rows or columns) of a damaged area
+ * are found at a constant offset in the shadow framebuffer, the area was
+ * scrolled or moved and the client can copy it from its own screen.
+ * A few sampled lines vote for an offset, which is then verified.
+ */
+
+#define RDS_MOTION_SAMPLES		32
+#define RDS_MOTION_MIN_LINES		16
+
+#define RDS_MOTION_HASH_BASIS		0xCBF29CE484222325ULL
+#define RDS_MOTION_HASH_PRIME		0x00000100000001B3ULL
+
+static void freerds_motion_hash_rows(BYTE* data, int scanline, int width, int height, UINT64* hashes)
+{
+	int x, y;
+	UINT64 hash;
+	UINT32* pixel;
+
+	for (y = 0; y < height; y++)
+	{
+		hash = RDS_MOTION_HASH_BASIS;
+		pixel = (UINT32*) &data[y * scanline];
+
+		for (x = 0; x < width; x++)
+			hash = (hash ^ pixel[x]) * RDS_MOTION_HASH_PRIME;
+
+		hashes[y] = hash;
+	}
+}
+
+static void freerds_motion_hash_columns(BYTE* data, int scanline, int width, int height, UINT64* hashes)
+{
+	int x, y;
+	UINT32* pixel;
+
+	for (x = 0; x < width; x++)
+		hashes[x] = RDS_MOTION_HASH_BASIS;
+
+	for (y = 0; y < height; y++)
+	{
+		pixel = (UINT32*) &data[y * scanline];
+
+		for (x = 0; x < width; x++)
+			hashes[x] = (hashes[x] ^ pixel[x]) * RDS_MOTION_HASH_PRIME;
+	}
+}
+
+static int freerds_motion_find(UINT64* newHashes, UINT64* oldHashes, int count, int* offset, int* first, int* length)
+{
+	int i, j, k;
+	int line;
+	int match;
+	int matches;
+	int numCandidates;
+	int bestVotes;
+	int runFirst, runLength;
+	int candidates[RDS_MOTION_SAMPLES];
+	int votes[RDS_MOTION_SAMPLES];
+
+	numCandidates = 0;
+
+	for (i = 0; i < RDS_MOTION_SAMPLES; i++)
+	{
+		line = (i * count) / RDS_MOTION_SAMPLES;
+
+		if (newHashes[line] == oldHashes[line])
+			continue;
+
+		match = -1;
+		matches = 0;
+
+		for (j = 0; (j < count) && (matches < 2); j++)
+		{
+			if (oldHashes[j] == newHashes[line])
+			{
+				match = j;
+				matches++;
+			}
+		}
+
+		/* lines found more than once (blank lines) are ambiguous */
+
+		if (matches != 1)
+			continue;
+
+		for (k = 0; k < numCandidates; k++)
+		{
+			if (candidates[k] == match - line)
+				break;
+		}
+
+		if (k == numCandidates)
+		{
+			candidates[numCandidates] = match - line;
+			votes[numCandidates++] = 0;
+		}
+
+		votes[k]++;
+	}
+
+	bestVotes = 1;
+	*offset = 0;
+
+	for (k = 0; k < numCandidates; k++)
+	{
+		if (votes[k] > bestVotes)
+		{
+			bestVotes = votes[k];
+			*offset = candidates[k];
+		}
+	}
+
+	if (!*offset)
+		return 0;
+
+	*length = runLength = 0;
+	*first = runFirst = 0;
+
+	for (i = MAX(0, -(*offset)); i < MIN(count, count - (*offset)); i++)
+	{
+		if (newHashes[i] == oldHashes[i + (*offset)])
+		{
+			if (!runLength)
+				runFirst = i;
+
+			runLength++;
+
+			if (runLength > *length)
+			{
+				*first = runFirst;
+				*length = runLength;
+			}
+		}
+		else
+		{
+			runLength = 0;
+		}
+	}
+
+	if ((*length < RDS_MOTION_MIN_LINES) || ((*length * 2) < count))
+		return 0;
+
+	return 1;
+}
+
+static BOOL freerds_shadow_framebuffer_valid(rdsConnection* connection, int x, int y, int width, int height)
+{
+	int tileX, tileY;
+	int tilesX;
+
+	tilesX = (connection->shadowWidth + RDS_SHADOW_TILE_SIZE - 1) / RDS_SHADOW_TILE_SIZE;
+
+	for (tileY = y / RDS_SHADOW_TILE_SIZE; tileY <= (y + height - 1) / RDS_SHADOW_TILE_SIZE; tileY++)
+	{
+		for (tileX = x / RDS_SHADOW_TILE_SIZE; tileX <= (x + width - 1) / RDS_SHADOW_TILE_SIZE; tileX++)
+		{
+			if (!connection->shadowTiles[(tileY * tilesX) + tileX])
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+int freerds_shadow_framebuffer_motion(rdsConnection* connection, RDS_MSG_PAINT_RECT* msg, RDS_MSG_SCREEN_BLT* blt)
+{
+	int row;
+	int left, top;
+	int right, bottom;
+	int width, height;
+	int offset;
+	int first;
+	int length;
+	int scanline;
+	int status;
+	BYTE* src;
+	BYTE* dst;
+	BYTE* fbData;
+	BYTE* shadowData;
+	UINT64* newHashes;
+	UINT64* oldHashes;
+	pixman_box32_t box;
+	RDS_FRAMEBUFFER* framebuffer;
+
+	framebuffer = msg->framebuffer;
+
+	if (!connection->shadow || (framebuffer->fbBytesPerPixel != 4) ||
+			(connection->shadowWidth != framebuffer->fbWidth) ||
+			(connection->shadowHeight != framebuffer->fbHeight) ||
+			(connection->shadowScanline != framebuffer->fbScanline))
+		return 0;
+
+	left = MAX(msg->nLeftRect, 0);
+	top = MAX(msg->nTopRect, 0);
+	right = MIN(msg->nLeftRect + msg->nWidth, framebuffer->fbWidth);
+	bottom = MIN(msg->nTopRect + msg->nHeight, framebuffer->fbHeight);
+
+	width = right - left;
+	height = bottom - top;
+
+	if ((width < RDS_SHADOW_TILE_SIZE) || (height < RDS_SHADOW_TILE_SIZE))
+		return 0;
+
+	scanline = framebuffer->fbScanline;
+	fbData = &((BYTE*) framebuffer->fbSharedMemory)[(top * scanline) + (left * 4)];
+	shadowData = &connection->shadow[(top * scanline) + (left * 4)];
+
+	newHashes = (UINT64*) malloc(sizeof(UINT64) * MAX(width, height));
+	oldHashes = (UINT64*) malloc(sizeof(UINT64) * MAX(width, height));
+
+	status = 0;
+
+	if (newHashes && oldHashes)
+	{
+		freerds_motion_hash_rows(fbData, scanline, width, height, newHashes);
+		freerds_motion_hash_rows(shadowData, scanline, width, height, oldHashes);
+
+		if (freerds_motion_find(newHashes, oldHashes, height, &offset, &first, &length))
+		{
+			blt->nLeftRect = left;
+			blt->nTopRect = top + first;
+			blt->nWidth = width;
+			blt->nHeight = length;
+			blt->nXSrc = left;
+			blt->nYSrc = top + first + offset;
+			status = 1;
+		}
+		else
+		{
+			freerds_motion_hash_columns(fbData, scanline, width, height, newHashes);
+			freerds_motion_hash_columns(shadowData, scanline, width, height, oldHashes);
+
+			if (freerds_motion_find(newHashes, oldHashes, width, &offset, &first, &length))
+			{
+				blt->nLeftRect = left + first;
+				blt->nTopRect = top;
+				blt->nWidth = length;
+				blt->nHeight = height;
+				blt->nXSrc = left + first + offset;
+				blt->nYSrc = top;
+				status = 1;
+			}
+		}
+	}
+
+	free(newHashes);
+	free(oldHashes);
+
+	if (!status)
+		return 0;
+
+	/* the client can only copy what it has been sent, which excludes deferred content */
+
+	if (!freerds_shadow_framebuffer_valid(connection, blt->nXSrc, blt->nYSrc, blt->nWidth, blt->nHeight))
+		return 0;
+
+	box.x1 = blt->nXSrc;
+	box.y1 = blt->nYSrc;
+	box.x2 = blt->nXSrc + blt->nWidth;
+	box.y2 = blt->nYSrc + blt->nHeight;
+
+	if (pixman_region32_contains_rectangle(&connection->deferredRegion, &box) != PIXMAN_REGION_OUT)
+		return 0;
+
+	/* rule out hash collisions */
+
+	for (row = 0; row < blt->nHeight; row++)
+	{
+		src = &connection->shadow[((blt->nYSrc + row) * scanline) + (blt->nXSrc * 4)];
+		dst = &((BYTE*) framebuffer->fbSharedMemory)[((blt->nTopRect + row) * scanline) + (blt->nLeftRect * 4)];
+
+		if (memcmp(src, dst, blt->nWidth * 4))
+			return 0;
+	}
+
+	blt->type = RDS_SERVER_SCREEN_BLT;
+	blt->bRop = 0xCC;
+
+	return 1;
+}
+
+/**
+ * Replays a ScrBlt sent to the client on the shadow framebuffer.
+ */
+
+void freerds_shadow_framebuffer_scroll(rdsConnection* connection, RDS_MSG_SCREEN_BLT* blt)
+{
+	int row;
+	int scanline;
+	BYTE* src;
+	BYTE* dst;
+
+	scanline = connection->shadowScanline;
+
+	for (row = 0; row < blt->nHeight; row++)
+	{
+		/* walk rows against the direction of motion so that overlapping rows are read before being overwritten */
+
+		if (blt->nYSrc < blt->nTopRect)
+		{
+			src = &connection->shadow[((blt->nYSrc + blt->nHeight - 1 - row) * scanline) + (blt->nXSrc * 4)];
+			dst = &connection->shadow[((blt->nTopRect + blt->nHeight - 1 - row) * scanline) + (blt->nLeftRect * 4)];
+		}
+		else
+		{
+			src = &connection->shadow[((blt->nYSrc + row) * scanline) + (blt->nXSrc * 4)];
+			dst = &connection->shadow[((blt->nTopRect + row) * scanline) + (blt->nLeftRect * 4)];
+		}
+
+		MoveMemory(dst, src, blt->nWidth * 4);
+	}
+}
+
 int freerds_connection_init(rdsConnection* connection, rdpSettings* settings)
 {
+	int index;
+
 	connection->settings = settings;
 
 	connection->bytesPerPixel = 4;
@@ -68,6 +561,11 @@ int freerds_connection_init(rdsConnection* connection, rdpSettings* settings)
 	connection->bs = Stream_New(NULL, 16384);
 	connection->bts = Stream_New(NULL, 16384);
 
+	connection->bitmapTile = (BYTE*) malloc(64 * 64 * 4);
+
+	for (index = 0; index < RDS_BITMAP_UPDATE_MAX_TILES; index++)
+		connection->bitmapSlots[index] = Stream_New(NULL, RDS_BITMAP_UPDATE_SLOT_SIZE);
+
 	connection->rfx_s = Stream_New(NULL, 16384);
 	connection->rfx_context = rfx_context_new(TRUE);
 
@@ -75,6 +573,8 @@ int freerds_connection_init(rdsConnection* connection, rdpSettings* settings)
 	connection->rfx_context->width = settings->DesktopWidth;
 	connection->rfx_context->height = settings->DesktopHeight;
 
+	freerds_estimator_rfx_init(connection->rfx_context);
+
 	connection->nsc_s = Stream_New(NULL, 16384);
 	connection->nsc_context = nsc_context_new();
 
@@ -89,23 +589,49 @@ int freerds_connection_init(rdsConnection* connection, rdpSettings* settings)
 		nsc_context_set_pixel_format(connection->nsc_context, RDP_PIXEL_FORMAT_B8G8R8);
 	}
 
-	connection->FrameList = ListDictionary_New(TRUE);
+	connection->estimator = freerds_estimator_new();
+	pixman_region32_init(&connection->deferredRegion);
+	pixman_region32_init(&connection->captureRegion);
+
+	connection->encoder = freerds_encoder_client_new();
 
 	return 0;
 }
 
 void freerds_connection_uninit(rdsConnection* connection)
 {
+	int index;
+
 	Stream_Free(connection->bs, TRUE);
 	Stream_Free(connection->bts, TRUE);
 
+	free(connection->bitmapTile);
+
+	for (index = 0; index < RDS_BITMAP_UPDATE_MAX_TILES; index++)
+		Stream_Free(connection->bitmapSlots[index], TRUE);
+
 	Stream_Free(connection->rfx_s, TRUE);
 	rfx_context_free(connection->rfx_context);
 
 	Stream_Free(connection->nsc_s, TRUE);
 	nsc_context_free(connection->nsc_context);
 
-	ListDictionary_Free(connection->FrameList);
+	freerds_frame_ring_free(connection->frames);
+	freerds_estimator_free(connection->estimator);
+	pixman_region32_fini(&connection->deferredRegion);
+	freerds_capture_free(connection->capture);
+	pixman_region32_fini(&connection->captureRegion);
+
+	freerds_encoder_client_free(connection->encoder);
+	freerds_encoder_set_free(connection->encoders);
+
+	freerds_glyph_cache_free(connection->glyphCache);
+	freerds_bitmap_cache_free(connection->bitmapCache);
+	freerds_offscreen_cache_free(connection->offscreenCache);
+	freerds_pointer_cache_free(connection->pointerCache);
+
+	free(connection->shadow);
+	free(connection->shadowTiles);
 }
 
 /**
@@ -124,160 +650,170 @@ int freerds_send_bell(rdsConnection* connection)
 	return 0;
 }
 
-int freerds_send_bitmap_update(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg)
+/**
+ * Interleaved bitmaps are sent at 15 or 24bpp when the session asks for it,
+ * and at 16bpp otherwise, 32bpp sessions included.
+ */
+
+static int freerds_bitmap_update_bpp(rdsConnection* connection)
+{
+	switch (connection->settings->ColorDepth)
+	{
+		case 15:
+			return 15;
+
+		case 24:
+			return 24;
+
+		default:
+			break;
+	}
+
+	return 16;
+}
+
+/**
+ * Sends a paint as bitmap updates, compressing each tile either with the
+ * interleaved RLE encoder or, given a planar context, as 32bpp planar.
+ * Returns the number of bytes sent.
+ */
+
+static int freerds_send_bitmap_tiles(rdsConnection* connection, BITMAP_PLANAR_CONTEXT* planar, RDS_MSG_PAINT_RECT* msg)
 {
 	BYTE* data;
-	BYTE* tile;
-	BYTE* buffer;
-	int i, j, k;
+	int x, y;
+	int e, k;
 	wStream* s;
 	wStream* ts;
-	int e, lines;
+	int lines;
+	int bytes;
 	int scanline;
-	int rows, cols;
-	int MaxRegionWidth;
-	int MaxRegionHeight;
+	int dstBpp;
+	int dstSize;
+	int dstBytesPerPixel;
 	INT32 nWidth, nHeight;
-	pixman_image_t* image;
-	pixman_image_t* fbImage;
+	pFreeRdsColorConvert convert;
 	BITMAP_DATA* bitmapData;
 	BITMAP_UPDATE bitmapUpdate;
 	rdpUpdate* update = connection->client->update;
 
 	//printf("%s\n", __FUNCTION__);
 
-	MaxRegionWidth = 64 * 4;
-	MaxRegionHeight = 64 * 1;
-
-	if ((msg->nWidth * msg->nHeight) > (MaxRegionWidth * MaxRegionHeight))
-	{
-		RDS_MSG_PAINT_RECT subMsg;
-
-		rows = (msg->nWidth + (MaxRegionWidth - (msg->nWidth % MaxRegionWidth))) / MaxRegionWidth;
-		cols = (msg->nHeight + (MaxRegionHeight - (msg->nHeight % MaxRegionHeight))) / MaxRegionHeight;
-
-		//printf("Partitioning x: %d y: %d width: %d height: %d in %d partitions (%d rows, %d cols)\n",
-		//		msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight, rows * cols, rows, cols);
-
-		for (i = 0; i < rows; i++)
-		{
-			for (j = 0; j < cols; j++)
-			{
-				CopyMemory(&subMsg, msg, sizeof(RDS_MSG_PAINT_RECT));
-
-				subMsg.nLeftRect = msg->nLeftRect + (i * MaxRegionWidth);
-				subMsg.nTopRect = msg->nTopRect + (j * MaxRegionHeight);
-
-				subMsg.nWidth = (i < (rows - 1)) ? MaxRegionWidth : msg->nWidth - (i * MaxRegionWidth);
-				subMsg.nHeight = (j < (cols - 1)) ? MaxRegionHeight : msg->nHeight - (j * MaxRegionHeight);
+	if (!connection->bitmapTile)
+		return -1;
 
-				//printf("\t[%d, %d]: x: %d y: %d width: %d height; %d\n",
-				//		i, j, subMsg.nLeftRect, subMsg.nTopRect, subMsg.nWidth, subMsg.nHeight);
+	dstBpp = planar ? 32 : freerds_bitmap_update_bpp(connection);
+	dstBytesPerPixel = (dstBpp + 7) / 8;
+	convert = freerds_color_converter(dstBpp);
 
-				if ((subMsg.nWidth * subMsg.nHeight) > 0)
-					freerds_send_bitmap_update(connection, bpp, &subMsg);
-			}
-		}
+	bytes = 0;
 
-		return 0;
-	}
-
-	tile = (BYTE*) malloc(64 * 64 * 4);
-	fbImage = (pixman_image_t*) msg->framebuffer->image;
+	ts = connection->bts;
+	scanline = msg->framebuffer->fbScanline;
 
-	rows = (msg->nWidth + (64 - (msg->nWidth % 64))) / 64;
-	cols = (msg->nHeight + (64 - (msg->nHeight % 64))) / 64;
+	bitmapUpdate.rectangles = connection->bitmapData;
 
-	k = 0;
-	bitmapUpdate.count = bitmapUpdate.number = rows * cols;
-	bitmapData = (BITMAP_DATA*) malloc(sizeof(BITMAP_DATA) * bitmapUpdate.number);
-	bitmapUpdate.rectangles = bitmapData;
+	/* one update per band of up to four tiles, as wide as 256 pixels */
 
-	for (i = 0; i < rows; i++)
+	for (y = 0; y < msg->nHeight; y += 64)
 	{
-		for (j = 0; j < cols; j++)
-		{
-			nWidth = (i < (rows - 1)) ? 64 : msg->nWidth - (i * 64);
-			nHeight = (j < (cols - 1)) ? 64 : msg->nHeight - (j * 64);
-
-			bitmapData[k].bitsPerPixel = 16;
-			bitmapData[k].width = nWidth;
-			bitmapData[k].height = nHeight;
-			bitmapData[k].destLeft = msg->nLeftRect + (i * 64);
-			bitmapData[k].destTop = msg->nTopRect + (j * 64);
-			bitmapData[k].destRight = bitmapData[k].destLeft + nWidth - 1;
-			bitmapData[k].destBottom = bitmapData[k].destTop + nHeight - 1;
-			bitmapData[k].compressed = TRUE;
-
-			if (((nWidth * nHeight) > 0) && (nWidth >= 4) && (nHeight >= 4))
-			{
-				e = nWidth % 4;
+		k = 0;
 
-				if (e != 0)
-					e = 4 - e;
+		for (x = 0; x < msg->nWidth; x += 64)
+		{
+			nWidth = MIN(64, msg->nWidth - x);
+			nHeight = MIN(64, msg->nHeight - y);
 
-				//printf("k: %d destLeft: %d destTop: %d destRight: %d destBottom: %d nWidth: %d nHeight: %d\n",
-				//		k, bitmapData[k].destLeft, bitmapData[k].destTop,
-				//		bitmapData[k].destRight, bitmapData[k].destBottom, nWidth, nHeight);
+			if ((nWidth < 4) || (nHeight < 4))
+				continue;
 
-				s = connection->bs;
-				ts = connection->bts;
+			e = nWidth % 4;
 
-				Stream_SetPosition(s, 0);
-				Stream_SetPosition(ts, 0);
+			if (e != 0)
+				e = 4 - e;
 
-				data = msg->framebuffer->fbSharedMemory;
-				data = &data[(bitmapData[k].destTop * msg->framebuffer->fbScanline) +
-				             (bitmapData[k].destLeft * msg->framebuffer->fbBytesPerPixel)];
+			bitmapData = &connection->bitmapData[k];
+			s = connection->bitmapSlots[k];
 
-				scanline = msg->framebuffer->fbScanline;
+			bitmapData->bitsPerPixel = dstBpp;
+			bitmapData->width = nWidth;
+			bitmapData->height = nHeight;
+			bitmapData->destLeft = msg->nLeftRect + x;
+			bitmapData->destTop = msg->nTopRect + y;
+			bitmapData->destRight = bitmapData->destLeft + nWidth - 1;
+			bitmapData->destBottom = bitmapData->destTop + nHeight - 1;
+			bitmapData->compressed = TRUE;
 
-				image = pixman_image_create_bits(PIXMAN_r5g6b5, nWidth, nHeight, (uint32_t*) tile, nWidth * 2);
+			Stream_SetPosition(s, 0);
+			Stream_SetPosition(ts, 0);
 
-				pixman_image_composite(PIXMAN_OP_OVER, fbImage, NULL, image,
-						bitmapData[k].destLeft, bitmapData[k].destTop, 0, 0, 0, 0, nWidth, nHeight);
+			data = msg->framebuffer->fbSharedMemory;
+			data = &data[(bitmapData->destTop * scanline) +
+			             (bitmapData->destLeft * msg->framebuffer->fbBytesPerPixel)];
 
-				lines = freerdp_bitmap_compress((char*) pixman_image_get_data(image),
-						nWidth, nHeight, s, 16, 16384, nHeight - 1, ts, e);
-				Stream_SealLength(s);
+			if (planar)
+			{
+				dstSize = (int) Stream_Capacity(s);
+				freerdp_bitmap_planar_compress(planar, data, PIXEL_FORMAT_XRGB32,
+						nWidth, nHeight, scanline, Stream_Buffer(s), &dstSize);
+				Stream_SetPosition(s, dstSize);
+			}
+			else
+			{
+				convert(data, scanline, connection->bitmapTile, nWidth * dstBytesPerPixel, nWidth, nHeight);
 
-				bitmapData[k].bitmapDataStream = Stream_Buffer(s);
-				bitmapData[k].bitmapLength = Stream_Length(s);
+				lines = freerdp_bitmap_compress((char*) connection->bitmapTile,
+						nWidth, nHeight, s, dstBpp, 16384, nHeight - 1, ts, e);
+			}
 
-				buffer = (BYTE*) malloc(bitmapData[k].bitmapLength);
-				CopyMemory(buffer, bitmapData[k].bitmapDataStream, bitmapData[k].bitmapLength);
+			Stream_SealLength(s);
 
-				bitmapData[k].bitmapDataStream = buffer;
+			bitmapData->bitmapDataStream = Stream_Buffer(s);
+			bitmapData->bitmapLength = Stream_Length(s);
 
-				bitmapData[k].cbCompFirstRowSize = 0;
-				bitmapData[k].cbCompMainBodySize = bitmapData[k].bitmapLength;
-				bitmapData[k].cbScanWidth = nWidth * 2;
-				bitmapData[k].cbUncompressedSize = nWidth * nHeight * 2;
+			bitmapData->cbCompFirstRowSize = 0;
+			bitmapData->cbCompMainBodySize = bitmapData->bitmapLength;
+			bitmapData->cbScanWidth = nWidth * dstBytesPerPixel;
+			bitmapData->cbUncompressedSize = nWidth * nHeight * dstBytesPerPixel;
 
-				pixman_image_unref(image);
+			bytes += bitmapData->bitmapLength;
+			k++;
 
-				k++;
+			if (k == RDS_BITMAP_UPDATE_MAX_TILES)
+			{
+				bitmapUpdate.count = bitmapUpdate.number = k;
+				IFCALL(update->BitmapUpdate, (rdpContext*) connection, &bitmapUpdate);
+				k = 0;
 			}
 		}
-	}
 
-	bitmapUpdate.count = bitmapUpdate.number = k;
+		if (k > 0)
+		{
+			bitmapUpdate.count = bitmapUpdate.number = k;
+			IFCALL(update->BitmapUpdate, (rdpContext*) connection, &bitmapUpdate);
+		}
+	}
 
-	IFCALL(update->BitmapUpdate, (rdpContext*) connection, &bitmapUpdate);
+	return bytes;
+}
 
-	for (k = 0; k < bitmapUpdate.number; k++)
-	{
-		free(bitmapData[k].bitmapDataStream);
-	}
+int freerds_send_bitmap_update(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	return freerds_send_bitmap_tiles(connection, NULL, msg);
+}
 
-	free(bitmapData);
-	free(tile);
+int freerds_send_planar_update(rdsConnection* connection, BITMAP_PLANAR_CONTEXT* planar, RDS_MSG_PAINT_RECT* msg)
+{
+	if (!planar)
+		return -1;
 
-	return 0;
+	return freerds_send_bitmap_tiles(connection, planar, msg);
 }
 
 int freerds_set_pointer(rdsConnection* connection, RDS_MSG_SET_POINTER* msg)
 {
+	int index;
+	BOOL cached;
 	POINTER_NEW_UPDATE pointerNew;
 	POINTER_COLOR_UPDATE* pointerColor;
 	POINTER_CACHED_UPDATE pointerCached;
@@ -285,9 +821,31 @@ int freerds_set_pointer(rdsConnection* connection, RDS_MSG_SET_POINTER* msg)
 
 	//printf("%s\n", __FUNCTION__);
 
+	if (!connection->pointerCache)
+		connection->pointerCache = freerds_pointer_cache_new(connection->settings);
+
+	cached = FALSE;
+	index = -1;
+
+	if (connection->pointerCache)
+		index = freerds_pointer_cache_get(connection->pointerCache, msg, &cached);
+
+	if (cached)
+	{
+		if (index == connection->pointerCache->current)
+			return 0;
+
+		connection->pointerCache->current = index;
+
+		pointerCached.cacheIndex = index;
+		IFCALL(pointer->PointerCached, (rdpContext*) connection, &pointerCached);
+
+		return 0;
+	}
+
 	pointerColor = &(pointerNew.colorPtrAttr);
 
-	pointerColor->cacheIndex = 0;
+	pointerColor->cacheIndex = (index < 0) ? 0 : index;
 	pointerColor->xPos = msg->xPos;
 	pointerColor->yPos = msg->yPos;
 	pointerColor->width = 32;
@@ -309,6 +867,13 @@ int freerds_set_pointer(rdsConnection* connection, RDS_MSG_SET_POINTER* msg)
 		IFCALL(pointer->PointerNew, (rdpContext*) connection, &pointerNew);
 	}
 
+	if (index >= 0)
+	{
+		/* color and new pointer updates also make the pointer current */
+		connection->pointerCache->current = index;
+		return 0;
+	}
+
 	pointerCached.cacheIndex = pointerColor->cacheIndex;
 
 	IFCALL(pointer->PointerCached, (rdpContext*) connection, &pointerCached);
@@ -323,18 +888,30 @@ int freerds_set_system_pointer(rdsConnection* connection, RDS_MSG_SET_SYSTEM_POI
 
 	pointer_system = &(pointer->pointer_system);
 	pointer_system->type = msg->ptrType;
+
+	if (connection->pointerCache)
+		connection->pointerCache->current = -1;
+
 	IFCALL(pointer->PointerSystem, (rdpContext *)connection, pointer_system);
 
 	return 0;
 }
 
+/**
+ * BeginPaint and EndPaint work on the same pending update PDU as the
+ * SurfaceBits sent by the transmit thread, which flushes it first: the
+ * transmit queue is drained before the connection thread touches it.
+ */
+
 int freerds_orders_begin_paint(rdsConnection* connection)
 {
 	rdpUpdate* update = ((rdpContext*) connection)->update;
 
 	//printf("%s\n", __FUNCTION__);
 
+	freerds_transmit_flush(connection);
 	update->BeginPaint((rdpContext*) connection);
+	connection->paintOpen = TRUE;
 
 	return 0;
 }
@@ -345,7 +922,27 @@ int freerds_orders_end_paint(rdsConnection* connection)
 
 	//printf("%s\n", __FUNCTION__);
 
+	freerds_transmit_flush(connection);
 	update->EndPaint((rdpContext*) connection);
+	connection->paintOpen = FALSE;
+	connection->ordersPending = FALSE;
+
+	return 0;
+}
+
+/**
+ * Primary orders are buffered until EndPaint, while bitmap updates
+ * go out immediately: push pending orders out before a bitmap update
+ * so that the client applies both in the order they were drawn.
+ */
+
+int freerds_orders_flush(rdsConnection* connection)
+{
+	if (!connection->ordersPending || !connection->paintOpen)
+		return 0;
+
+	freerds_orders_end_paint(connection);
+	freerds_orders_begin_paint(connection);
 
 	return 0;
 }
@@ -356,7 +953,7 @@ int freerds_orders_rect(rdsConnection* connection, int x, int y,
 	OPAQUE_RECT_ORDER opaqueRect;
 	rdpPrimaryUpdate* primary = connection->client->update->primary;
 
-	printf("%s\n", __FUNCTION__);
+	//printf("%s\n", __FUNCTION__);
 
 	opaqueRect.nLeftRect = x;
 	opaqueRect.nTopRect = y;
@@ -669,6 +1266,23 @@ int freerds_reset(rdsConnection* connection, RDS_MSG_RESET* msg)
 	connection->settings->DesktopHeight = msg->DesktopHeight;
 	connection->settings->ColorDepth = msg->ColorDepth;
 
+	freerds_shadow_framebuffer_invalidate(connection);
+
+	pixman_region32_fini(&connection->deferredRegion);
+	pixman_region32_init(&connection->deferredRegion);
+
+	freerds_glyph_cache_free(connection->glyphCache);
+	connection->glyphCache = NULL;
+
+	freerds_bitmap_cache_free(connection->bitmapCache);
+	connection->bitmapCache = NULL;
+
+	freerds_offscreen_cache_free(connection->offscreenCache);
+	connection->offscreenCache = NULL;
+
+	freerds_pointer_cache_free(connection->pointerCache);
+	connection->pointerCache = NULL;
+
 	return 0;
 }
 
@@ -699,8 +1313,8 @@ int freerds_orders_send_raw_bitmap2(rdsConnection* connection,
 	return 0;
 }
 
-int freerds_orders_send_bitmap2(rdsConnection* connection,
-		int width, int height, int bpp, char* data, int cache_id, int cache_idx, int hints)
+int freerds_orders_send_keyed_bitmap2(rdsConnection* connection,
+		int width, int height, int bpp, char* data, int cache_id, int cache_idx, UINT64 key)
 {
 	wStream* s;
 	wStream* ts;
@@ -725,6 +1339,13 @@ int freerds_orders_send_bitmap2(rdsConnection* connection,
 	cache_bitmap_v2.compressed = TRUE;
 	cache_bitmap_v2.flags = 0;
 
+	if (key)
+	{
+		cache_bitmap_v2.flags |= CBR2_PERSISTENT_KEY_PRESENT;
+		cache_bitmap_v2.key1 = (UINT32) (key & 0xFFFFFFFF);
+		cache_bitmap_v2.key2 = (UINT32) (key >> 32);
+	}
+
 	s = connection->bs;
 	ts = connection->bts;
 
@@ -746,6 +1367,12 @@ int freerds_orders_send_bitmap2(rdsConnection* connection,
 	return 0;
 }
 
+int freerds_orders_send_bitmap2(rdsConnection* connection,
+		int width, int height, int bpp, char* data, int cache_id, int cache_idx, int hints)
+{
+	return freerds_orders_send_keyed_bitmap2(connection, width, height, bpp, data, cache_id, cache_idx, 0);
+}
+
 int freerds_orders_send_bitmap3(rdsConnection* connection,
 		int width, int height, int bpp, char* data, int cache_id, int cache_idx, int hints)
 {
@@ -822,22 +1449,147 @@ int freerds_orders_send_switch_os_surface(rdsConnection* connection, int id)
 	return 0;
 }
 
-int freerds_send_surface_bits(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg)
+/**
+ * Splits a paint into bands on the 64x64 tile grid and encodes them on the
+ * shared encoder pool. Returns the number of bytes sent,
+ * or 0 when the paint is too small to be worth it.
+ */
+
+static int freerds_send_surface_bits_parallel(rdsConnection* connection, int codec,
+		BYTE* data, int scanline, RDS_MSG_PAINT_RECT* msg)
 {
-	int i;
-	BYTE* data;
+	int i, j;
+	int bytes;
 	wStream* s;
-	int scanline;
-	int numMessages;
-	int bytesPerPixel;
+	int top, bottom;
+	int bandY, bandHeight;
+	int tileRows;
+	rdsEncoderJob* job;
+	rdsEncoderClient* client;
 	SURFACE_BITS_COMMAND cmd;
-	rdpUpdate* update = ((rdpContext*) connection)->update;
 
-	if ((bpp == 24) || (bpp == 32))
+	client = connection->encoder;
+
+	if (!client || (freerds_encoder_pool_thread_count() < 2))
+		return 0;
+
+	top = msg->nTopRect;
+	bottom = msg->nTopRect + msg->nHeight;
+
+	tileRows = ((bottom - 1) / RDS_ENCODER_BAND_HEIGHT) - (top / RDS_ENCODER_BAND_HEIGHT) + 1;
+
+	if (tileRows < 2)
+		return 0;
+
+	/* bands are aligned on their own grid, which can add one partial band */
+
+	bandHeight = RDS_ENCODER_BAND_HEIGHT * ((tileRows + RDS_ENCODER_MAX_JOBS - 2) / (RDS_ENCODER_MAX_JOBS - 1));
+
+	freerds_encoder_client_reset(client);
+
+	for (bandY = top; bandY < bottom; bandY = (bandY - (bandY % bandHeight)) + bandHeight)
 	{
-		bytesPerPixel = 4;
+		job = freerds_encoder_client_add_job(client);
+
+		job->codec = codec;
+		job->pixelFormat = (connection->bytesPerPixel == 3) ? RDP_PIXEL_FORMAT_B8G8R8 : RDP_PIXEL_FORMAT_B8G8R8A8;
+		job->data = data;
+		job->scanline = scanline;
+		job->maxDataSize = connection->settings->MultifragMaxRequestSize;
+		job->quality = connection->estimator ? connection->estimator->quality : 0;
+
+		job->x = msg->nLeftRect;
+		job->y = bandY;
+		job->height = MIN((bandY - (bandY % bandHeight)) + bandHeight, bottom) - bandY;
+
+		if (codec == RDS_ENCODER_CODEC_RFX)
+		{
+			job->rect.x = msg->nLeftRect;
+			job->rect.y = bandY;
+			job->rect.width = msg->nWidth;
+			job->rect.height = job->height;
+
+			job->width = msg->nWidth;
+			job->height = msg->nHeight;
+		}
+		else
+		{
+			job->width = msg->nWidth;
+		}
 	}
-	else
+
+	freerds_encoder_client_encode(client, connection->rfx_context, connection->nsc_context);
+
+	bytes = 0;
+
+	for (i = 0; i < client->count; i++)
+	{
+		job = &client->jobs[i];
+
+		for (j = 0; j < job->numMessages; j++)
+		{
+			if (codec == RDS_ENCODER_CODEC_RFX)
+			{
+				RFX_MESSAGE* messages = (RFX_MESSAGE*) job->messages;
+
+				s = freerds_transmit_acquire(connection, connection->rfx_s);
+				Stream_SetPosition(s, 0);
+
+				rfx_write_message(connection->rfx_context, s, &messages[j]);
+
+				cmd.bpp = 32;
+				cmd.codecID = connection->settings->RemoteFxCodecId;
+
+				cmd.destLeft = msg->nLeftRect;
+				cmd.destTop = msg->nTopRect;
+				cmd.destRight = msg->nLeftRect + msg->nWidth;
+				cmd.destBottom = msg->nTopRect + msg->nHeight;
+				cmd.width = msg->nWidth;
+				cmd.height = msg->nHeight;
+			}
+			else
+			{
+				NSC_MESSAGE* messages = (NSC_MESSAGE*) job->messages;
+
+				s = freerds_transmit_acquire(connection, connection->nsc_s);
+				Stream_SetPosition(s, 0);
+
+				nsc_write_message(connection->nsc_context, s, &messages[j]);
+				nsc_message_free((NSC_CONTEXT*) job->context, &messages[j]);
+
+				cmd.bpp = 32;
+				cmd.codecID = connection->settings->NSCodecId;
+
+				cmd.destLeft = messages[j].x;
+				cmd.destTop = messages[j].y;
+				cmd.destRight = messages[j].x + messages[j].width;
+				cmd.destBottom = messages[j].y + messages[j].height;
+				cmd.width = messages[j].width;
+				cmd.height = messages[j].height;
+			}
+
+			cmd.bitmapDataLength = Stream_GetPosition(s);
+			cmd.bitmapData = Stream_Buffer(s);
+
+			freerds_transmit_surface_bits(connection, &cmd);
+
+			bytes += cmd.bitmapDataLength;
+		}
+
+		if (codec == RDS_ENCODER_CODEC_RFX)
+			freerds_encoder_rfx_free((RFX_CONTEXT*) job->context, (RFX_MESSAGE*) job->messages, job->numMessages);
+		else
+			free(job->messages);
+	}
+
+	freerds_encoder_client_reset(client);
+
+	return bytes;
+}
+
+static int freerds_send_surface_bits_source(int bpp, RDS_MSG_PAINT_RECT* msg, BYTE** data, int* scanline)
+{
+	if ((bpp != 24) && (bpp != 32))
 	{
 		printf("%s: unsupported bpp: %d\n", __FUNCTION__, bpp);
 		return -1;
@@ -845,119 +1597,151 @@ int freerds_send_surface_bits(rdsConnection* connection, int bpp, RDS_MSG_PAINT_
 
 	if (msg->fbSegmentId)
 	{
-		bpp = msg->framebuffer->fbBitsPerPixel;
-		data = msg->framebuffer->fbSharedMemory;
-		scanline = msg->framebuffer->fbScanline;
+		*data = msg->framebuffer->fbSharedMemory;
+		*scanline = msg->framebuffer->fbScanline;
 	}
 	else
 	{
-		data = msg->bitmapData;
-		scanline = bytesPerPixel * msg->nWidth;
+		*data = msg->bitmapData;
+		*scanline = 4 * msg->nWidth;
 	}
 
+	return 0;
+}
+
+/**
+ * SurfaceBits encoders, returning the number of bytes sent.
+ */
+
+int freerds_send_surface_bits_rfx(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	int i;
+	int bytes;
+	BYTE* data;
+	wStream* s;
+	int scanline;
+	int numMessages;
+	RFX_RECT rect;
+	RFX_MESSAGE* messages;
+	SURFACE_BITS_COMMAND cmd;
+
+	if (freerds_send_surface_bits_source(bpp, msg, &data, &scanline) < 0)
+		return -1;
+
 	//printf("%s: bpp: %d x: %d y: %d width: %d height: %d\n", __FUNCTION__,
 	//		bpp, msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
 
-	if (connection->settings->RemoteFxCodec)
-	{
-		RFX_RECT rect;
-		RFX_MESSAGE* messages;
+	rect.x = msg->nLeftRect;
+	rect.y = msg->nTopRect;
+	rect.width = msg->nWidth;
+	rect.height = msg->nHeight;
 
-		s = connection->rfx_s;
+	freerds_estimator_rfx_select(connection->rfx_context,
+			connection->estimator ? connection->estimator->quality : 0);
 
-		rect.x = msg->nLeftRect;
-		rect.y = msg->nTopRect;
-		rect.width = msg->nWidth;
-		rect.height = msg->nHeight;
+	bytes = freerds_send_surface_bits_parallel(connection, RDS_ENCODER_CODEC_RFX, data, scanline, msg);
 
-		messages = rfx_encode_messages(connection->rfx_context, &rect, 1, data,
-				msg->nWidth, msg->nHeight, scanline, &numMessages,
-				connection->settings->MultifragMaxRequestSize);
+	if (bytes > 0)
+		return bytes;
 
-		cmd.codecID = connection->settings->RemoteFxCodecId;
+	messages = freerds_encoder_rfx_encode(connection->rfx_context, &rect, data,
+			msg->nWidth, msg->nHeight, scanline, &numMessages,
+			connection->settings->MultifragMaxRequestSize);
 
-		cmd.destLeft = msg->nLeftRect;
-		cmd.destTop = msg->nTopRect;
-		cmd.destRight = msg->nLeftRect + msg->nWidth;
-		cmd.destBottom = msg->nTopRect + msg->nHeight;
+	cmd.codecID = connection->settings->RemoteFxCodecId;
 
-		cmd.bpp = 32;
-		cmd.width = msg->nWidth;
-		cmd.height = msg->nHeight;
+	cmd.destLeft = msg->nLeftRect;
+	cmd.destTop = msg->nTopRect;
+	cmd.destRight = msg->nLeftRect + msg->nWidth;
+	cmd.destBottom = msg->nTopRect + msg->nHeight;
 
-		for (i = 0; i < numMessages; i++)
-		{
-			Stream_SetPosition(s, 0);
-			rfx_write_message(connection->rfx_context, s, &messages[i]);
-			rfx_message_free(connection->rfx_context, &messages[i]);
+	cmd.bpp = 32;
+	cmd.width = msg->nWidth;
+	cmd.height = msg->nHeight;
 
-			cmd.bitmapDataLength = Stream_GetPosition(s);
-			cmd.bitmapData = Stream_Buffer(s);
+	for (i = 0; i < numMessages; i++)
+	{
+		s = freerds_transmit_acquire(connection, connection->rfx_s);
+		Stream_SetPosition(s, 0);
+		rfx_write_message(connection->rfx_context, s, &messages[i]);
 
-			IFCALL(update->SurfaceBits, update->context, &cmd);
-		}
+		cmd.bitmapDataLength = Stream_GetPosition(s);
+		cmd.bitmapData = Stream_Buffer(s);
 
-		free(messages);
+		freerds_transmit_surface_bits(connection, &cmd);
 
-		return 0;
+		bytes += cmd.bitmapDataLength;
 	}
-	else if (connection->settings->NSCodec)
-	{
-		NSC_MESSAGE* messages;
-
-		s = connection->nsc_s;
 
-		messages = nsc_encode_messages(connection->nsc_context, data,
-				msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight,
-				scanline, &numMessages, connection->settings->MultifragMaxRequestSize);
+	freerds_encoder_rfx_free(connection->rfx_context, messages, numMessages);
 
-		cmd.bpp = 32;
-		cmd.codecID = connection->settings->NSCodecId;
+	return bytes;
+}
 
-		for (i = 0; i < numMessages; i++)
-		{
-			Stream_SetPosition(s, 0);
+int freerds_send_surface_bits_nsc(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	int i;
+	int bytes;
+	BYTE* data;
+	wStream* s;
+	int scanline;
+	int numMessages;
+	NSC_MESSAGE* messages;
+	SURFACE_BITS_COMMAND cmd;
 
-			nsc_write_message(connection->nsc_context, s, &messages[i]);
-			nsc_message_free(connection->nsc_context, &messages[i]);
+	if (freerds_send_surface_bits_source(bpp, msg, &data, &scanline) < 0)
+		return -1;
 
-			cmd.destLeft = messages[i].x;
-			cmd.destTop = messages[i].y;
-			cmd.destRight = messages[i].x + messages[i].width;
-			cmd.destBottom = messages[i].y + messages[i].height;
-			cmd.width = messages[i].width;
-			cmd.height = messages[i].height;
+	bytes = freerds_send_surface_bits_parallel(connection, RDS_ENCODER_CODEC_NSC, data, scanline, msg);
 
-			cmd.bitmapDataLength = Stream_GetPosition(s);
-			cmd.bitmapData = Stream_Buffer(s);
+	if (bytes > 0)
+		return bytes;
 
-			IFCALL(update->SurfaceBits, update->context, &cmd);
-		}
+	messages = nsc_encode_messages(connection->nsc_context, data,
+			msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight,
+			scanline, &numMessages, connection->settings->MultifragMaxRequestSize);
 
-		free(messages);
+	cmd.bpp = 32;
+	cmd.codecID = connection->settings->NSCodecId;
 
-		return 0;
-	}
-	else
+	for (i = 0; i < numMessages; i++)
 	{
-		printf("%s: no codecs available!\n", __FUNCTION__);
-		return -1;
+		s = freerds_transmit_acquire(connection, connection->nsc_s);
+		Stream_SetPosition(s, 0);
+
+		nsc_write_message(connection->nsc_context, s, &messages[i]);
+		nsc_message_free(connection->nsc_context, &messages[i]);
+
+		cmd.destLeft = messages[i].x;
+		cmd.destTop = messages[i].y;
+		cmd.destRight = messages[i].x + messages[i].width;
+		cmd.destBottom = messages[i].y + messages[i].height;
+		cmd.width = messages[i].width;
+		cmd.height = messages[i].height;
+
+		cmd.bitmapDataLength = Stream_GetPosition(s);
+		cmd.bitmapData = Stream_Buffer(s);
+
+		freerds_transmit_surface_bits(connection, &cmd);
+
+		bytes += cmd.bitmapDataLength;
 	}
 
-	return 0;
+	free(messages);
+
+	return bytes;
 }
 
 int freerds_orders_send_frame_marker(rdsConnection* connection, UINT32 action, UINT32 id)
 {
 	SURFACE_FRAME_MARKER surfaceFrameMarker;
-	rdpUpdate* update = connection->client->update;
 
 	//printf("%s: action: %d id: %d\n", __FUNCTION__, action, id);
 
 	surfaceFrameMarker.frameAction = action;
 	surfaceFrameMarker.frameId = id;
 
-	IFCALL(update->SurfaceFrameMarker, (rdpContext*) connection, &surfaceFrameMarker);
+	freerds_transmit_frame_marker(connection, &surfaceFrameMarker);
 
 	return 0;
 }
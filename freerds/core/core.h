@@ -24,6 +24,7 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
 #include <freerdp/codec/nsc.h>
+#include <freerdp/codec/planar.h>
 
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/server/cliprdr.h>
@@ -56,6 +57,14 @@ struct RDS_RECT
 };
 typedef struct RDS_RECT xrdpRect;
 
+/**
+ * Interleaved bitmap updates carry up to four 64x64 tiles, each compressed
+ * straight into its own persistent output slot.
+ */
+
+#define RDS_BITMAP_UPDATE_MAX_TILES	4
+#define RDS_BITMAP_UPDATE_SLOT_SIZE	((64 * 64 * 4) + 1024)
+
 struct rds_connection
 {
 	rdpContext context;
@@ -73,14 +82,43 @@ struct rds_connection
 	wStream* bs;
 	wStream* bts;
 
+	BYTE* bitmapTile;
+	wStream* bitmapSlots[RDS_BITMAP_UPDATE_MAX_TILES];
+	BITMAP_DATA bitmapData[RDS_BITMAP_UPDATE_MAX_TILES];
+
 	wStream* rfx_s;
 	RFX_CONTEXT* rfx_context;
 
 	wStream* nsc_s;
 	NSC_CONTEXT* nsc_context;
 
+	BYTE* shadow;
+	BYTE* shadowTiles;
+	int shadowWidth;
+	int shadowHeight;
+	int shadowScanline;
+
+	struct rds_encoder_client* encoder;
+	struct rds_encoder_set* encoders;
+	struct rds_transmit_queue* transmit;
+	BOOL transmitDirect;
+	struct rds_glyph_cache* glyphCache;
+	struct rds_bitmap_cache* bitmapCache;
+	struct rds_offscreen_cache* offscreenCache;
+	struct rds_pointer_cache* pointerCache;
+	struct rds_estimator* estimator;
+	struct rds_capture* capture;
+	pixman_region32_t captureRegion;
+
 	UINT32 frameId;
-	wListDictionary* FrameList;
+	BOOL frameOpen;
+	struct rds_frame_ring* frames;
+	pixman_region32_t deferredRegion;
+
+	BOOL paintOpen;
+	BOOL ordersPending;
+	BOOL clipEnabled;
+	xrdpRect clipRect;
 
 	WTSVirtualChannelManager* vcm;
 	CliprdrServerContext* cliprdr;
@@ -101,6 +139,13 @@ FREERDP_API int freerds_send_palette(rdsConnection* connection, int* palette);
 FREERDP_API int freerds_send_bell(rdsConnection* connection);
 
 FREERDP_API int freerds_send_bitmap_update(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg);
+FREERDP_API int freerds_send_planar_update(rdsConnection* connection, BITMAP_PLANAR_CONTEXT* planar, RDS_MSG_PAINT_RECT* msg);
+
+FREERDP_API int freerds_shadow_framebuffer_diff(rdsConnection* connection, RDS_MSG_PAINT_RECT* msg, pixman_region32_t* region);
+FREERDP_API void freerds_shadow_framebuffer_invalidate(rdsConnection* connection);
+FREERDP_API void freerds_shadow_framebuffer_invalidate_rect(rdsConnection* connection, int x, int y, int width, int height);
+FREERDP_API int freerds_shadow_framebuffer_motion(rdsConnection* connection, RDS_MSG_PAINT_RECT* msg, RDS_MSG_SCREEN_BLT* blt);
+FREERDP_API void freerds_shadow_framebuffer_scroll(rdsConnection* connection, RDS_MSG_SCREEN_BLT* blt);
 
 FREERDP_API int freerds_set_pointer(rdsConnection* connection, RDS_MSG_SET_POINTER* msg);
 
@@ -110,6 +155,8 @@ FREERDP_API int freerds_orders_begin_paint(rdsConnection* connection);
 
 FREERDP_API int freerds_orders_end_paint(rdsConnection* connection);
 
+FREERDP_API int freerds_orders_flush(rdsConnection* connection);
+
 FREERDP_API int freerds_orders_rect(rdsConnection* connection, int x, int y,
 		int cx, int cy, int color, xrdpRect* rect);
 
@@ -151,6 +198,9 @@ FREERDP_API int freerds_orders_send_raw_bitmap2(rdsConnection* connection,
 FREERDP_API int freerds_orders_send_bitmap2(rdsConnection* connection,
 		int width, int height, int bpp, char* data, int cache_id, int cache_idx, int hints);
 
+FREERDP_API int freerds_orders_send_keyed_bitmap2(rdsConnection* connection,
+		int width, int height, int bpp, char* data, int cache_id, int cache_idx, UINT64 key);
+
 FREERDP_API int freerds_orders_send_bitmap3(rdsConnection* connection,
 		int width, int height, int bpp, char* data, int cache_id, int cache_idx, int hints);
 
@@ -162,7 +212,8 @@ FREERDP_API int freerds_orders_send_create_os_surface(rdsConnection* connection,
 
 FREERDP_API int freerds_orders_send_switch_os_surface(rdsConnection* connection, int id);
 
-FREERDP_API int freerds_send_surface_bits(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg);
+FREERDP_API int freerds_send_surface_bits_rfx(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg);
+FREERDP_API int freerds_send_surface_bits_nsc(rdsConnection* connection, int bpp, RDS_MSG_PAINT_RECT* msg);
 
 FREERDP_API int freerds_orders_send_frame_marker(rdsConnection* connection, UINT32 action, UINT32 id);
 
@@ -0,0 +1,367 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Encoder Interface
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#include "encoder.h"
+#include "transmit.h"
+#include "estimator.h"
+
+static int g_EncoderCount = 0;
+static const rdsEncoderInterface* g_Encoders[RDS_ENCODER_MAX_INTERFACES];
+static CRITICAL_SECTION g_EncoderLock;
+static volatile LONG g_EncoderState = 0;
+
+/**
+ * RemoteFX
+ */
+
+static BOOL freerds_encoder_rfx_probe(rdsConnection* connection)
+{
+	return (connection->codecMode && connection->settings->RemoteFxCodec) ? TRUE : FALSE;
+}
+
+static void* freerds_encoder_rfx_init(rdsConnection* connection)
+{
+	return (void*) connection->rfx_context;
+}
+
+static int freerds_encoder_rfx_encode(rdsConnection* connection, void* context, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	return freerds_send_surface_bits_rfx(connection, bpp, msg);
+}
+
+static int freerds_encoder_surface_flush(rdsConnection* connection, void* context)
+{
+	return freerds_transmit_flush(connection);
+}
+
+static const rdsEncoderInterface g_EncoderRfx =
+{
+	"rfx", RDS_ENCODER_TYPE_SURFACE, TRUE, 100,
+	freerds_encoder_rfx_probe,
+	freerds_encoder_rfx_init,
+	NULL,
+	freerds_encoder_rfx_encode,
+	freerds_encoder_surface_flush
+};
+
+/**
+ * NSCodec
+ */
+
+static BOOL freerds_encoder_nsc_probe(rdsConnection* connection)
+{
+	return (connection->codecMode && connection->settings->NSCodec) ? TRUE : FALSE;
+}
+
+static void* freerds_encoder_nsc_init(rdsConnection* connection)
+{
+	return (void*) connection->nsc_context;
+}
+
+static int freerds_encoder_nsc_encode(rdsConnection* connection, void* context, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	return freerds_send_surface_bits_nsc(connection, bpp, msg);
+}
+
+static const rdsEncoderInterface g_EncoderNsc =
+{
+	"nsc", RDS_ENCODER_TYPE_SURFACE, TRUE, 50,
+	freerds_encoder_nsc_probe,
+	freerds_encoder_nsc_init,
+	NULL,
+	freerds_encoder_nsc_encode,
+	freerds_encoder_surface_flush
+};
+
+/**
+ * Planar: 32bpp bitmap updates, only for 32bpp sessions. The alpha plane
+ * is skipped (PLANAR_FORMAT_HEADER_NA) only when the client allows it.
+ */
+
+static BOOL freerds_encoder_planar_probe(rdsConnection* connection)
+{
+	return (connection->settings->ColorDepth == 32) ? TRUE : FALSE;
+}
+
+static void* freerds_encoder_planar_init(rdsConnection* connection)
+{
+	DWORD flags = PLANAR_FORMAT_HEADER_RLE;
+
+	if (connection->settings->DrawAllowSkipAlpha)
+		flags |= PLANAR_FORMAT_HEADER_NA;
+
+	return (void*) freerdp_bitmap_planar_context_new(flags, 64, 64);
+}
+
+static void freerds_encoder_planar_uninit(rdsConnection* connection, void* context)
+{
+	freerdp_bitmap_planar_context_free((BITMAP_PLANAR_CONTEXT*) context);
+}
+
+static int freerds_encoder_planar_encode(rdsConnection* connection, void* context, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	return freerds_send_planar_update(connection, (BITMAP_PLANAR_CONTEXT*) context, msg);
+}
+
+static const rdsEncoderInterface g_EncoderPlanar =
+{
+	"planar", RDS_ENCODER_TYPE_BITMAP, FALSE, 100,
+	freerds_encoder_planar_probe,
+	freerds_encoder_planar_init,
+	freerds_encoder_planar_uninit,
+	freerds_encoder_planar_encode,
+	NULL
+};
+
+/**
+ * Interleaved: 15, 16 or 24bpp bitmap updates, always available
+ */
+
+static BOOL freerds_encoder_interleaved_probe(rdsConnection* connection)
+{
+	return TRUE;
+}
+
+static void* freerds_encoder_interleaved_init(rdsConnection* connection)
+{
+	return (void*) connection->bitmapTile;
+}
+
+static int freerds_encoder_interleaved_encode(rdsConnection* connection, void* context, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	return freerds_send_bitmap_update(connection, bpp, msg);
+}
+
+static const rdsEncoderInterface g_EncoderInterleaved =
+{
+	"interleaved", RDS_ENCODER_TYPE_BITMAP, FALSE, 50,
+	freerds_encoder_interleaved_probe,
+	freerds_encoder_interleaved_init,
+	NULL,
+	freerds_encoder_interleaved_encode,
+	NULL
+};
+
+/**
+ * Registry, kept in descending priority order so that
+ * the first encoder accepted by a connection is the best one.
+ */
+
+static int freerds_encoder_add(const rdsEncoderInterface* encoder)
+{
+	int index;
+
+	if (g_EncoderCount >= RDS_ENCODER_MAX_INTERFACES)
+	{
+		printf("%s: too many encoders, %s not registered\n", __FUNCTION__, encoder->name);
+		return -1;
+	}
+
+	for (index = g_EncoderCount; index > 0; index--)
+	{
+		if (g_Encoders[index - 1]->priority >= encoder->priority)
+			break;
+
+		g_Encoders[index] = g_Encoders[index - 1];
+	}
+
+	g_Encoders[index] = encoder;
+	g_EncoderCount++;
+
+	return 0;
+}
+
+static void freerds_encoder_registry_init(void)
+{
+	LONG state;
+
+	state = InterlockedCompareExchange(&g_EncoderState, 1, 0);
+
+	if (state == 0)
+	{
+		InitializeCriticalSection(&g_EncoderLock);
+
+		freerds_encoder_add(&g_EncoderRfx);
+		freerds_encoder_add(&g_EncoderNsc);
+		freerds_encoder_add(&g_EncoderPlanar);
+		freerds_encoder_add(&g_EncoderInterleaved);
+
+		InterlockedExchange(&g_EncoderState, 2);
+	}
+	else
+	{
+		while (InterlockedCompareExchange(&g_EncoderState, 2, 2) != 2)
+			Sleep(1);
+	}
+}
+
+/**
+ * Registers an encoder for all connections activated from now on.
+ * The interface must remain valid for the lifetime of the process.
+ */
+
+int freerds_encoder_register(const rdsEncoderInterface* encoder)
+{
+	int status;
+
+	if (!encoder || !encoder->name || !encoder->Probe || !encoder->Encode)
+		return -1;
+
+	freerds_encoder_registry_init();
+
+	EnterCriticalSection(&g_EncoderLock);
+	status = freerds_encoder_add(encoder);
+	LeaveCriticalSection(&g_EncoderLock);
+
+	return status;
+}
+
+rdsEncoderSet* freerds_encoder_set_new(rdsConnection* connection)
+{
+	int index;
+	void* context;
+	rdsEncoderSet* set;
+	rdsEncoderInstance* instance;
+	const rdsEncoderInterface* encoder;
+
+	freerds_encoder_registry_init();
+
+	set = (rdsEncoderSet*) calloc(1, sizeof(rdsEncoderSet));
+
+	if (!set)
+		return NULL;
+
+	set->connection = connection;
+
+	EnterCriticalSection(&g_EncoderLock);
+
+	for (index = 0; index < g_EncoderCount; index++)
+	{
+		encoder = g_Encoders[index];
+
+		if (!encoder->Probe(connection))
+			continue;
+
+		context = encoder->Init ? encoder->Init(connection) : (void*) connection;
+
+		if (!context)
+		{
+			printf("%s: failed to initialize encoder %s\n", __FUNCTION__, encoder->name);
+			continue;
+		}
+
+		instance = &set->instances[set->count++];
+		instance->encoder = encoder;
+		instance->context = context;
+
+		if ((encoder->type == RDS_ENCODER_TYPE_SURFACE) && !set->surface)
+			set->surface = instance;
+		else if ((encoder->type == RDS_ENCODER_TYPE_BITMAP) && !set->bitmap)
+			set->bitmap = instance;
+	}
+
+	LeaveCriticalSection(&g_EncoderLock);
+
+	return set;
+}
+
+void freerds_encoder_set_free(rdsEncoderSet* set)
+{
+	int index;
+	rdsEncoderInstance* instance;
+
+	if (!set)
+		return;
+
+	for (index = 0; index < set->count; index++)
+	{
+		instance = &set->instances[index];
+
+		if (instance->encoder->Uninit)
+			instance->encoder->Uninit(set->connection, instance->context);
+	}
+
+	free(set);
+}
+
+rdsEncoderInstance* freerds_encoder_set_find(rdsEncoderSet* set, const char* name)
+{
+	int index;
+
+	if (!set)
+		return NULL;
+
+	for (index = 0; index < set->count; index++)
+	{
+		if (strcmp(set->instances[index].encoder->name, name) == 0)
+			return &set->instances[index];
+	}
+
+	return NULL;
+}
+
+int freerds_encoder_encode(rdsEncoderSet* set, rdsEncoderInstance* instance, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	int status;
+
+	if (!set || !instance)
+	{
+		printf("%s: no encoder available!\n", __FUNCTION__);
+		return -1;
+	}
+
+	status = instance->encoder->Encode(set->connection, instance->context, bpp, msg);
+
+	instance->stats.calls++;
+	instance->stats.pixels += (UINT64) (msg->nWidth * msg->nHeight);
+
+	if (status < 0)
+	{
+		instance->stats.errors++;
+		return status;
+	}
+
+	instance->stats.bytes += status;
+
+	/* SurfaceBits are accounted for by the transmit stage */
+
+	if (instance->encoder->type == RDS_ENCODER_TYPE_BITMAP)
+		freerds_estimator_add_bytes(set->connection->estimator, status);
+
+	return status;
+}
+
+int freerds_encoder_flush(rdsEncoderSet* set, rdsEncoderInstance* instance)
+{
+	if (!set || !instance || !instance->encoder->Flush)
+		return 0;
+
+	return instance->encoder->Flush(set->connection, instance->context);
+}
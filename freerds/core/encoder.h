@@ -0,0 +1,103 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Encoder Interface
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_ENCODER_H
+#define RDS_NG_ENCODER_H
+
+#include "core.h"
+
+#define RDS_ENCODER_MAX_INTERFACES	16
+
+#define RDS_ENCODER_TYPE_SURFACE	1
+#define RDS_ENCODER_TYPE_BITMAP		2
+
+/**
+ * Encoders turn damaged framebuffer areas into updates for the client.
+ *
+ * Surface encoders (RemoteFX, NSCodec) send SurfaceBits and are used in codec
+ * mode. Bitmap encoders (planar, interleaved) send lossless bitmap updates and
+ * are used without a codec, or for text and UI content in codec mode.
+ *
+ * Encoders are registered once for the process. When a connection is
+ * activated, every encoder whose capability probe accepts the negotiated
+ * settings is initialized for it, and the one with the highest priority
+ * is selected for each type.
+ */
+
+typedef BOOL (*pfnFreeRdsEncoderProbe)(rdsConnection* connection);
+typedef void* (*pfnFreeRdsEncoderInit)(rdsConnection* connection);
+typedef void (*pfnFreeRdsEncoderUninit)(rdsConnection* connection, void* context);
+typedef int (*pfnFreeRdsEncoderEncode)(rdsConnection* connection, void* context, int bpp, RDS_MSG_PAINT_RECT* msg);
+typedef int (*pfnFreeRdsEncoderFlush)(rdsConnection* connection, void* context);
+
+struct rds_encoder_interface
+{
+	const char* name;
+	UINT32 type;
+	BOOL lossy;
+	int priority;
+
+	pfnFreeRdsEncoderProbe Probe;
+	pfnFreeRdsEncoderInit Init;
+	pfnFreeRdsEncoderUninit Uninit;
+	pfnFreeRdsEncoderEncode Encode;
+	pfnFreeRdsEncoderFlush Flush;
+};
+typedef struct rds_encoder_interface rdsEncoderInterface;
+
+struct rds_encoder_stats
+{
+	UINT64 calls;
+	UINT64 pixels;
+	UINT64 bytes;
+	UINT64 errors;
+};
+typedef struct rds_encoder_stats rdsEncoderStats;
+
+struct rds_encoder_instance
+{
+	const rdsEncoderInterface* encoder;
+	void* context;
+	rdsEncoderStats stats;
+};
+typedef struct rds_encoder_instance rdsEncoderInstance;
+
+struct rds_encoder_set
+{
+	rdsConnection* connection;
+
+	int count;
+	rdsEncoderInstance instances[RDS_ENCODER_MAX_INTERFACES];
+
+	rdsEncoderInstance* surface;
+	rdsEncoderInstance* bitmap;
+};
+typedef struct rds_encoder_set rdsEncoderSet;
+
+int freerds_encoder_register(const rdsEncoderInterface* encoder);
+
+rdsEncoderSet* freerds_encoder_set_new(rdsConnection* connection);
+void freerds_encoder_set_free(rdsEncoderSet* set);
+
+rdsEncoderInstance* freerds_encoder_set_find(rdsEncoderSet* set, const char* name);
+
+int freerds_encoder_encode(rdsEncoderSet* set, rdsEncoderInstance* instance, int bpp, RDS_MSG_PAINT_RECT* msg);
+int freerds_encoder_flush(rdsEncoderSet* set, rdsEncoderInstance* instance);
+
+#endif /* RDS_NG_ENCODER_H */
@@ -0,0 +1,259 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bandwidth Estimator
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "estimator.h"
+
+/**
+ * RemoteFX quantization values, one set per quality level,
+ * from the codec defaults up to coarser steps on every band.
+ */
+
+static const UINT32 g_EstimatorQuants[RDS_ESTIMATOR_QUALITY_LEVELS][10] =
+{
+	{ 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 },
+	{ 7, 7, 7, 7, 8, 8, 9, 9, 9, 10 },
+	{ 8, 8, 8, 8, 9, 9, 10, 10, 10, 11 },
+	{ 9, 9, 9, 9, 10, 10, 11, 11, 11, 12 }
+};
+
+static BOOL freerds_estimator_queueing(rdsEstimator* estimator)
+{
+	return (estimator->rtt > (estimator->minRtt * 2) + RDS_ESTIMATOR_RTT_SLACK) ? TRUE : FALSE;
+}
+
+rdsEstimator* freerds_estimator_new(void)
+{
+	rdsEstimator* estimator;
+
+	estimator = (rdsEstimator*) calloc(1, sizeof(rdsEstimator));
+
+	return estimator;
+}
+
+void freerds_estimator_free(rdsEstimator* estimator)
+{
+	free(estimator);
+}
+
+void freerds_estimator_frame_begin(rdsEstimator* estimator, UINT32 frameId)
+{
+	if (!estimator)
+		return;
+
+	estimator->frameId = frameId;
+	estimator->frameOpen = TRUE;
+}
+
+/**
+ * Bytes sent outside of a frame are accounted to the next one.
+ */
+
+void freerds_estimator_add_bytes(rdsEstimator* estimator, UINT32 bytes)
+{
+	if (!estimator)
+		return;
+
+	estimator->frameBytes += bytes;
+}
+
+void freerds_estimator_frame_end(rdsEstimator* estimator)
+{
+	rdsEstimatorFrame* frame;
+
+	if (!estimator || !estimator->frameOpen)
+		return;
+
+	frame = &estimator->frames[estimator->frameId % RDS_ESTIMATOR_FRAMES];
+
+	frame->frameId = estimator->frameId;
+	frame->bytes = estimator->frameBytes;
+	frame->sendTime = GetTickCount64();
+	frame->delivered = estimator->delivered;
+	frame->pending = TRUE;
+
+	if (estimator->averageFrameBytes)
+		estimator->averageFrameBytes = ((estimator->averageFrameBytes * 7) + frame->bytes) / 8;
+	else
+		estimator->averageFrameBytes = frame->bytes;
+
+	estimator->frameBytes = 0;
+	estimator->frameOpen = FALSE;
+}
+
+void freerds_estimator_frame_acknowledge(rdsEstimator* estimator, UINT32 frameId)
+{
+	UINT32 rtt;
+	UINT32 rate;
+	rdsEstimatorFrame* frame;
+
+	if (!estimator)
+		return;
+
+	frame = &estimator->frames[frameId % RDS_ESTIMATOR_FRAMES];
+
+	if (!frame->pending || (frame->frameId != frameId))
+		return;
+
+	frame->pending = FALSE;
+
+	rtt = (UINT32) (GetTickCount64() - frame->sendTime);
+
+	if (rtt < 1)
+		rtt = 1;
+
+	estimator->delivered += frame->bytes;
+
+	if (estimator->rtt)
+		estimator->rtt = ((estimator->rtt * 7) + rtt) / 8;
+	else
+		estimator->rtt = rtt;
+
+	/* the minimum slowly follows the samples up, in case the route changed */
+
+	if (!estimator->minRtt || (rtt < estimator->minRtt))
+		estimator->minRtt = rtt;
+	else
+		estimator->minRtt += (rtt - estimator->minRtt) / 64;
+
+	/**
+	 * Delivery rate: bytes acknowledged while this frame was in flight.
+	 * Idle periods make it an underestimate, so larger samples win at once
+	 * and smaller ones only pull the estimate down gradually.
+	 */
+
+	rate = (UINT32) (((estimator->delivered - frame->delivered) * 1000) / rtt);
+
+	if (rate > estimator->bandwidth)
+		estimator->bandwidth = rate;
+	else
+		estimator->bandwidth = ((estimator->bandwidth * 7) + rate) / 8;
+
+	estimator->defer = freerds_estimator_queueing(estimator);
+}
+
+/**
+ * Recomputes the frame rate, quality level and deferral state
+ * from the current estimates, and returns the frame rate.
+ */
+
+int freerds_estimator_update(rdsEstimator* estimator, int maxFps)
+{
+	int fps;
+	BOOL queueing;
+	UINT64 demand;
+	UINT64 sustainable;
+
+	if (!estimator)
+		return maxFps;
+
+	if (!estimator->rtt || !estimator->bandwidth)
+	{
+		estimator->fps = maxFps;
+		estimator->quality = 0;
+		estimator->defer = FALSE;
+		return maxFps;
+	}
+
+	queueing = freerds_estimator_queueing(estimator);
+
+	fps = maxFps;
+	demand = ((UINT64) estimator->averageFrameBytes) * maxFps;
+
+	if (estimator->averageFrameBytes)
+	{
+		sustainable = (((UINT64) estimator->bandwidth) * 9 / 10) / estimator->averageFrameBytes;
+
+		if (sustainable < (UINT64) fps)
+			fps = (int) sustainable;
+	}
+
+	if (queueing)
+		fps /= 2;
+
+	if (fps < 1)
+		fps = 1;
+
+	if (estimator->holdFrames > 0)
+	{
+		estimator->holdFrames--;
+	}
+	else if ((queueing || (demand > estimator->bandwidth)) &&
+			(estimator->quality < RDS_ESTIMATOR_QUALITY_LEVELS - 1))
+	{
+		estimator->quality++;
+		estimator->holdFrames = RDS_ESTIMATOR_HOLD_FRAMES;
+	}
+	else if (!queueing && ((demand * 2) < estimator->bandwidth) && (estimator->quality > 0))
+	{
+		estimator->quality--;
+		estimator->holdFrames = RDS_ESTIMATOR_HOLD_FRAMES;
+	}
+
+	estimator->fps = fps;
+	estimator->defer = queueing;
+
+	return fps;
+}
+
+/**
+ * Installs one quantization set per quality level in an encoder context,
+ * so that the level can then be switched by index only. Messages reference
+ * the sets of the context, which therefore never change once installed.
+ */
+
+void freerds_estimator_rfx_init(RFX_CONTEXT* context)
+{
+	UINT32* quants;
+
+	quants = (UINT32*) malloc(sizeof(g_EstimatorQuants));
+
+	if (!quants)
+		return;
+
+	CopyMemory(quants, g_EstimatorQuants, sizeof(g_EstimatorQuants));
+
+	free(context->quants);
+
+	context->quants = quants;
+	context->numQuant = RDS_ESTIMATOR_QUALITY_LEVELS;
+
+	freerds_estimator_rfx_select(context, 0);
+}
+
+void freerds_estimator_rfx_select(RFX_CONTEXT* context, int quality)
+{
+	if (context->numQuant != RDS_ESTIMATOR_QUALITY_LEVELS)
+		return;
+
+	if (quality < 0)
+		quality = 0;
+	else if (quality >= RDS_ESTIMATOR_QUALITY_LEVELS)
+		quality = RDS_ESTIMATOR_QUALITY_LEVELS - 1;
+
+	context->quantIdxY = quality;
+	context->quantIdxCb = quality;
+	context->quantIdxCr = quality;
+}
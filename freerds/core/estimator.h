@@ -0,0 +1,91 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bandwidth Estimator
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_ESTIMATOR_H
+#define RDS_NG_ESTIMATOR_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/codec/rfx.h>
+
+#define RDS_ESTIMATOR_FRAMES		32
+#define RDS_ESTIMATOR_QUALITY_LEVELS	4
+#define RDS_ESTIMATOR_RTT_SLACK		20
+#define RDS_ESTIMATOR_HOLD_FRAMES	8
+#define RDS_ESTIMATOR_DEFER_FRAMES	4
+
+/**
+ * Per-connection bandwidth and round-trip time estimator.
+ *
+ * The bytes sent between frame markers are recorded with the time the frame
+ * was closed. When the client acknowledges the frame, the elapsed time gives
+ * an RTT sample and the bytes delivered meanwhile a delivery rate sample.
+ *
+ * The controller derives from these the frame rate the link can sustain,
+ * the RemoteFX quality level (0 being the best) and whether low-priority
+ * content should be deferred, which is when the RTT grows well past its
+ * minimum, a sign that data is queueing somewhere on the path.
+ */
+
+struct rds_estimator_frame
+{
+	UINT32 frameId;
+	UINT32 bytes;
+	UINT64 sendTime;
+	UINT64 delivered;
+	BOOL pending;
+};
+typedef struct rds_estimator_frame rdsEstimatorFrame;
+
+struct rds_estimator
+{
+	UINT32 frameId;
+	UINT32 frameBytes;
+	BOOL frameOpen;
+
+	UINT64 delivered;
+	UINT32 rtt;
+	UINT32 minRtt;
+	UINT32 bandwidth;
+	UINT32 averageFrameBytes;
+
+	int fps;
+	int quality;
+	BOOL defer;
+	int holdFrames;
+	int deferredFrames;
+
+	rdsEstimatorFrame frames[RDS_ESTIMATOR_FRAMES];
+};
+typedef struct rds_estimator rdsEstimator;
+
+rdsEstimator* freerds_estimator_new(void);
+void freerds_estimator_free(rdsEstimator* estimator);
+
+void freerds_estimator_frame_begin(rdsEstimator* estimator, UINT32 frameId);
+void freerds_estimator_add_bytes(rdsEstimator* estimator, UINT32 bytes);
+void freerds_estimator_frame_end(rdsEstimator* estimator);
+void freerds_estimator_frame_acknowledge(rdsEstimator* estimator, UINT32 frameId);
+
+int freerds_estimator_update(rdsEstimator* estimator, int maxFps);
+
+void freerds_estimator_rfx_init(RFX_CONTEXT* context);
+void freerds_estimator_rfx_select(RFX_CONTEXT* context, int quality);
+
+#endif /* RDS_NG_ESTIMATOR_H */
@@ -0,0 +1,136 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Frame Ring
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "frame.h"
+
+/**
+ * A window of zero means the client does not acknowledge frames,
+ * in which case nothing is tracked and credit never runs out.
+ */
+
+rdsFrameRing* freerds_frame_ring_new(UINT32 window)
+{
+	rdsFrameRing* ring;
+
+	ring = (rdsFrameRing*) calloc(1, sizeof(rdsFrameRing));
+
+	if (!ring)
+		return NULL;
+
+	ring->window = window;
+
+	if (ring->window > RDS_FRAME_RING_SIZE)
+		ring->window = RDS_FRAME_RING_SIZE;
+
+	return ring;
+}
+
+void freerds_frame_ring_free(rdsFrameRing* ring)
+{
+	free(ring);
+}
+
+BOOL freerds_frame_ring_credit(rdsFrameRing* ring)
+{
+	if (!ring || !ring->window)
+		return TRUE;
+
+	return (ring->inFlight < ring->window) ? TRUE : FALSE;
+}
+
+void freerds_frame_ring_begin(rdsFrameRing* ring, UINT32 frameId)
+{
+	rdsFrameSlot* slot;
+
+	if (!ring || !ring->window)
+		return;
+
+	slot = &ring->slots[frameId % RDS_FRAME_RING_SIZE];
+
+	if (!slot->inFlight)
+		ring->inFlight++;
+
+	slot->frameId = frameId;
+	slot->inFlight = TRUE;
+	slot->sendTime = GetTickCount64();
+	slot->bytes = 0;
+	slot->area = 0;
+
+	ring->frameId = frameId;
+	ring->frameOpen = TRUE;
+}
+
+void freerds_frame_ring_add(rdsFrameRing* ring, UINT32 bytes, UINT32 area)
+{
+	rdsFrameSlot* slot;
+
+	if (!ring || !ring->frameOpen)
+		return;
+
+	slot = &ring->slots[ring->frameId % RDS_FRAME_RING_SIZE];
+
+	slot->bytes += bytes;
+	slot->area += area;
+}
+
+void freerds_frame_ring_end(rdsFrameRing* ring)
+{
+	if (!ring)
+		return;
+
+	ring->frameOpen = FALSE;
+}
+
+/**
+ * Releases the acknowledged frame and every frame sent before it,
+ * returning the number of slots freed.
+ */
+
+int freerds_frame_ring_acknowledge(rdsFrameRing* ring, UINT32 frameId)
+{
+	int count;
+	UINT32 index;
+	rdsFrameSlot* slot;
+
+	if (!ring || !ring->window)
+		return 0;
+
+	count = 0;
+
+	for (index = 0; index < RDS_FRAME_RING_SIZE; index++)
+	{
+		slot = &ring->slots[index];
+
+		if (!slot->inFlight || ((INT32) (frameId - slot->frameId) < 0))
+			continue;
+
+		slot->inFlight = FALSE;
+		ring->inFlight--;
+		count++;
+	}
+
+	return count;
+}
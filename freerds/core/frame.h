@@ -0,0 +1,68 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Frame Ring
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_FRAME_H
+#define RDS_NG_FRAME_H
+
+#include <winpr/wtypes.h>
+
+#define RDS_FRAME_RING_SIZE		16
+
+/**
+ * Fixed ring of the frames sent to the client and not acknowledged yet.
+ *
+ * Each slot records when a frame was sent, its size and the area it covered.
+ * The client advertises how many frames it accepts unacknowledged; once that
+ * many are in flight the ring has no credit left, and no frame is started
+ * until an acknowledgement returns some. Acknowledgements are cumulative,
+ * so a lost one is made up for by the next.
+ */
+
+struct rds_frame_slot
+{
+	UINT32 frameId;
+	BOOL inFlight;
+	UINT64 sendTime;
+	UINT32 bytes;
+	UINT32 area;
+};
+typedef struct rds_frame_slot rdsFrameSlot;
+
+struct rds_frame_ring
+{
+	UINT32 window;
+	UINT32 inFlight;
+	UINT32 frameId;
+	BOOL frameOpen;
+	rdsFrameSlot slots[RDS_FRAME_RING_SIZE];
+};
+typedef struct rds_frame_ring rdsFrameRing;
+
+rdsFrameRing* freerds_frame_ring_new(UINT32 window);
+void freerds_frame_ring_free(rdsFrameRing* ring);
+
+BOOL freerds_frame_ring_credit(rdsFrameRing* ring);
+
+void freerds_frame_ring_begin(rdsFrameRing* ring, UINT32 frameId);
+void freerds_frame_ring_add(rdsFrameRing* ring, UINT32 bytes, UINT32 area);
+void freerds_frame_ring_end(rdsFrameRing* ring);
+
+int freerds_frame_ring_acknowledge(rdsFrameRing* ring, UINT32 frameId);
+
+#endif /* RDS_NG_FRAME_H */
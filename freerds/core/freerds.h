@@ -63,8 +63,20 @@ int freerds_client_get_event_handles(rdsModuleConnector* connector, HANDLE* even
 int freerds_client_check_event_handles(rdsModuleConnector* connector);
 
 int freerds_client_inbound_connector_init(rdsModuleConnector* connector);
+int freerds_client_inbound_paint_deferred(rdsModuleConnector* connector);
 int freerds_message_server_connector_init(rdsModuleConnector* connector);
 
+#define RDS_SERVER_LIST_SIZE		1024
+#define RDS_SERVER_QUEUE_SIZE		1024
+
+#define RDS_SERVER_ARENA_COUNT		4
+#define RDS_SERVER_ARENA_BLOCK_SIZE	(64 * 1024)
+
+#define RDS_DAMAGE_RECT_COST		(64 * 64)
+#define RDS_DAMAGE_MAX_RECTS		64
+#define RDS_DAMAGE_MAX_REGION_RECTS	256
+
+int freerds_message_server_merge_rects(RDS_RECT* rects, int count);
 int freerds_message_server_queue_pack(rdsModuleConnector* connector);
 int freerds_message_server_queue_process_pending_messages(rdsModuleConnector* connector);
 int freerds_message_server_module_init(rdsModuleConnector* connector);
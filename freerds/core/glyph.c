@@ -0,0 +1,216 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Glyph Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#include "glyph.h"
+
+UINT32 freerds_glyph_cell_size(UINT32 cx, UINT32 cy)
+{
+	return ((((cx + 7) / 8) * cy) + 3) & ~3;
+}
+
+static UINT32 freerds_glyph_hash(RDS_GLYPH_DATA* glyph)
+{
+	UINT32 index;
+	UINT32 hash;
+
+	hash = 2166136261U;
+
+	hash = (hash ^ (UINT32) glyph->x) * 16777619U;
+	hash = (hash ^ (UINT32) glyph->y) * 16777619U;
+	hash = (hash ^ glyph->cx) * 16777619U;
+	hash = (hash ^ glyph->cy) * 16777619U;
+
+	for (index = 0; index < glyph->cb; index++)
+		hash = (hash ^ glyph->aj[index]) * 16777619U;
+
+	return hash;
+}
+
+rdsGlyphCache* freerds_glyph_cache_new(rdpSettings* settings)
+{
+	int index;
+	rdsGlyphCache* cache;
+	rdsGlyphTable* table;
+
+	cache = (rdsGlyphCache*) calloc(1, sizeof(rdsGlyphCache));
+
+	if (!cache)
+		return NULL;
+
+	if (settings->GlyphSupportLevel == GLYPH_SUPPORT_NONE)
+		return cache;
+
+	for (index = 0; index < RDS_GLYPH_CACHE_COUNT; index++)
+	{
+		table = &cache->tables[index];
+
+		table->numEntries = MIN(settings->GlyphCache[index].cacheEntries, RDS_GLYPH_CACHE_MAX_ENTRIES);
+		table->cellSize = settings->GlyphCache[index].cacheMaximumCellSize;
+
+		if (!table->numEntries || !table->cellSize)
+		{
+			table->numEntries = 0;
+			continue;
+		}
+
+		table->entries = (rdsGlyphEntry*) calloc(table->numEntries, sizeof(rdsGlyphEntry));
+
+		if (!table->entries)
+			table->numEntries = 0;
+	}
+
+	return cache;
+}
+
+void freerds_glyph_cache_free(rdsGlyphCache* cache)
+{
+	UINT32 index;
+	UINT32 cacheId;
+	rdsGlyphTable* table;
+
+	if (!cache)
+		return;
+
+	for (cacheId = 0; cacheId < RDS_GLYPH_CACHE_COUNT; cacheId++)
+	{
+		table = &cache->tables[cacheId];
+
+		for (index = 0; index < table->numEntries; index++)
+			free(table->entries[index].aj);
+
+		free(table->entries);
+	}
+
+	free(cache);
+}
+
+/**
+ * Starts a new order: glyphs looked up from now on are pinned until the next call.
+ */
+
+UINT32 freerds_glyph_cache_begin(rdsGlyphCache* cache)
+{
+	return ++cache->stamp;
+}
+
+/**
+ * Returns the cache with the smallest cells that can hold count glyphs of cellSize bytes.
+ */
+
+int freerds_glyph_cache_select(rdsGlyphCache* cache, UINT32 cellSize, UINT32 count)
+{
+	int cacheId;
+	int selected;
+	rdsGlyphTable* table;
+
+	selected = -1;
+
+	for (cacheId = 0; cacheId < RDS_GLYPH_CACHE_COUNT; cacheId++)
+	{
+		table = &cache->tables[cacheId];
+
+		if ((table->cellSize < cellSize) || (table->numEntries < count))
+			continue;
+
+		if ((selected < 0) || (table->cellSize < cache->tables[selected].cellSize))
+			selected = cacheId;
+	}
+
+	return selected;
+}
+
+/**
+ * Returns the client cache index holding the glyph, or the index it has to be
+ * sent to when cached is FALSE, or -1 when every entry is pinned by the current order.
+ */
+
+int freerds_glyph_cache_get(rdsGlyphCache* cache, int cacheId, RDS_GLYPH_DATA* glyph, BOOL* cached)
+{
+	UINT32 hash;
+	UINT32 index;
+	int victim;
+	rdsGlyphEntry* entry;
+	rdsGlyphTable* table;
+
+	table = &cache->tables[cacheId];
+
+	hash = freerds_glyph_hash(glyph);
+	victim = -1;
+
+	for (index = 0; index < table->numEntries; index++)
+	{
+		entry = &table->entries[index];
+
+		if (!entry->aj)
+		{
+			if ((victim < 0) || table->entries[victim].aj)
+				victim = index;
+
+			continue;
+		}
+
+		if ((entry->hash == hash) && (entry->x == glyph->x) && (entry->y == glyph->y) &&
+				(entry->cx == glyph->cx) && (entry->cy == glyph->cy) && (entry->cb == glyph->cb) &&
+				(memcmp(entry->aj, glyph->aj, glyph->cb) == 0))
+		{
+			entry->stamp = cache->stamp;
+			*cached = TRUE;
+			return index;
+		}
+
+		if (entry->stamp == cache->stamp)
+			continue;
+
+		if ((victim < 0) || (table->entries[victim].aj && (entry->stamp < table->entries[victim].stamp)))
+			victim = index;
+	}
+
+	if (victim < 0)
+		return -1;
+
+	entry = &table->entries[victim];
+
+	/* cache orders carry the bitmap padded to 4 bytes */
+
+	free(entry->aj);
+	entry->aj = (BYTE*) calloc(1, freerds_glyph_cell_size(glyph->cx, glyph->cy));
+
+	if (!entry->aj)
+		return -1;
+
+	CopyMemory(entry->aj, glyph->aj, glyph->cb);
+
+	entry->hash = hash;
+	entry->stamp = cache->stamp;
+	entry->x = glyph->x;
+	entry->y = glyph->y;
+	entry->cx = glyph->cx;
+	entry->cy = glyph->cy;
+	entry->cb = glyph->cb;
+
+	*cached = FALSE;
+
+	return victim;
+}
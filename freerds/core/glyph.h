@@ -0,0 +1,74 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Glyph Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_GLYPH_H
+#define RDS_NG_GLYPH_H
+
+#include "core.h"
+
+#define RDS_GLYPH_CACHE_COUNT		10
+#define RDS_GLYPH_CACHE_MAX_ENTRIES	254
+
+/**
+ * Server-side mirror of the client glyph caches.
+ *
+ * Glyphs are matched by content, so the X server does not need to know
+ * about cache slots. Each negotiated cache evicts its least recently used
+ * entry, except for entries used by the order being built (same stamp),
+ * which the client must still find when the order is replayed.
+ */
+
+struct rds_glyph_entry
+{
+	UINT32 hash;
+	UINT32 stamp;
+	INT32 x;
+	INT32 y;
+	UINT32 cx;
+	UINT32 cy;
+	UINT32 cb;
+	BYTE* aj;
+};
+typedef struct rds_glyph_entry rdsGlyphEntry;
+
+struct rds_glyph_table
+{
+	UINT32 numEntries;
+	UINT32 cellSize;
+	rdsGlyphEntry* entries;
+};
+typedef struct rds_glyph_table rdsGlyphTable;
+
+struct rds_glyph_cache
+{
+	UINT32 stamp;
+	rdsGlyphTable tables[RDS_GLYPH_CACHE_COUNT];
+};
+typedef struct rds_glyph_cache rdsGlyphCache;
+
+rdsGlyphCache* freerds_glyph_cache_new(rdpSettings* settings);
+void freerds_glyph_cache_free(rdsGlyphCache* cache);
+
+UINT32 freerds_glyph_cache_begin(rdsGlyphCache* cache);
+int freerds_glyph_cache_select(rdsGlyphCache* cache, UINT32 cellSize, UINT32 count);
+int freerds_glyph_cache_get(rdsGlyphCache* cache, int cacheId, RDS_GLYPH_DATA* glyph, BOOL* cached);
+
+UINT32 freerds_glyph_cell_size(UINT32 cx, UINT32 cy);
+
+#endif /* RDS_NG_GLYPH_H */
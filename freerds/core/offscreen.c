@@ -0,0 +1,137 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Offscreen Bitmap Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#include "offscreen.h"
+
+rdsOffscreenCache* freerds_offscreen_cache_new(rdpSettings* settings)
+{
+	rdsOffscreenCache* cache;
+
+	cache = (rdsOffscreenCache*) calloc(1, sizeof(rdsOffscreenCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->target = RDS_OFFSCREEN_PRIMARY;
+	cache->current = RDS_OFFSCREEN_PRIMARY;
+
+	if (!settings->OffscreenSupportLevel || !settings->OffscreenCacheEntries || !settings->OffscreenCacheSize)
+		return cache;
+
+	cache->maxEntries = MIN(settings->OffscreenCacheEntries, 0x7FFF);
+	cache->maxSize = settings->OffscreenCacheSize * 1024;
+	cache->bytesPerPixel = (settings->ColorDepth + 7) / 8;
+
+	cache->surfaces = (rdsOffscreenSurface*) calloc(cache->maxEntries, sizeof(rdsOffscreenSurface));
+	cache->deleteList = (UINT16*) calloc(cache->maxEntries, sizeof(UINT16));
+
+	if (!cache->surfaces || !cache->deleteList)
+	{
+		free(cache->surfaces);
+		free(cache->deleteList);
+		cache->surfaces = NULL;
+		cache->deleteList = NULL;
+		cache->maxEntries = 0;
+	}
+
+	return cache;
+}
+
+void freerds_offscreen_cache_free(rdsOffscreenCache* cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->surfaces);
+	free(cache->deleteList);
+	free(cache);
+}
+
+BOOL freerds_offscreen_cache_valid(rdsOffscreenCache* cache, UINT32 id)
+{
+	if (id >= cache->maxEntries)
+		return FALSE;
+
+	return cache->surfaces[id].valid;
+}
+
+void freerds_offscreen_cache_delete(rdsOffscreenCache* cache, UINT32 id)
+{
+	if (!freerds_offscreen_cache_valid(cache, id))
+		return;
+
+	cache->surfaces[id].valid = FALSE;
+	cache->deleteList[cache->deleteCount++] = (UINT16) id;
+}
+
+/**
+ * Accounts for a new surface and fills in the order creating it, including
+ * any pending deletions. Returns FALSE when the surface does not fit.
+ */
+
+BOOL freerds_offscreen_cache_create(rdsOffscreenCache* cache, UINT32 id,
+		UINT32 width, UINT32 height, CREATE_OFFSCREEN_BITMAP_ORDER* order)
+{
+	UINT32 index;
+	UINT32 size;
+	UINT32 freed;
+	rdsOffscreenSurface* surface;
+
+	if ((id >= cache->maxEntries) || !width || !height)
+		return FALSE;
+
+	freerds_offscreen_cache_delete(cache, id);
+
+	freed = 0;
+
+	for (index = 0; index < cache->deleteCount; index++)
+	{
+		surface = &cache->surfaces[cache->deleteList[index]];
+		freed += surface->width * surface->height * cache->bytesPerPixel;
+	}
+
+	size = width * height * cache->bytesPerPixel;
+
+	if ((cache->usedSize - freed + size) > cache->maxSize)
+		return FALSE;
+
+	cache->usedSize = cache->usedSize - freed + size;
+
+	order->id = id;
+	order->cx = width;
+	order->cy = height;
+	order->deleteList.sIndices = cache->maxEntries;
+	order->deleteList.cIndices = cache->deleteCount;
+	order->deleteList.indices = cache->deleteList;
+
+	cache->deleteCount = 0;
+
+	surface = &cache->surfaces[id];
+	surface->valid = TRUE;
+	surface->width = width;
+	surface->height = height;
+
+	return TRUE;
+}
@@ -0,0 +1,67 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Offscreen Bitmap Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_OFFSCREEN_H
+#define RDS_NG_OFFSCREEN_H
+
+#include "core.h"
+
+#define RDS_OFFSCREEN_PRIMARY		0xFFFF
+
+/**
+ * Server-side mirror of the client offscreen bitmap cache.
+ *
+ * Surface ids are chosen by the X server. A surface that does not fit in
+ * the negotiated cache is never created on the client, and paints from it
+ * are served from the framebuffer instead. Deleted surfaces are queued and
+ * sent in the delete list of the next CreateOffscreenBitmap order, which
+ * is the only way the protocol has to release them.
+ */
+
+struct rds_offscreen_surface
+{
+	BOOL valid;
+	UINT32 width;
+	UINT32 height;
+};
+typedef struct rds_offscreen_surface rdsOffscreenSurface;
+
+struct rds_offscreen_cache
+{
+	UINT32 maxEntries;
+	UINT32 maxSize;
+	UINT32 usedSize;
+	UINT32 bytesPerPixel;
+	UINT32 target;
+	UINT32 current;
+	UINT32 deleteCount;
+	UINT16* deleteList;
+	rdsOffscreenSurface* surfaces;
+};
+typedef struct rds_offscreen_cache rdsOffscreenCache;
+
+rdsOffscreenCache* freerds_offscreen_cache_new(rdpSettings* settings);
+void freerds_offscreen_cache_free(rdsOffscreenCache* cache);
+
+BOOL freerds_offscreen_cache_create(rdsOffscreenCache* cache, UINT32 id,
+		UINT32 width, UINT32 height, CREATE_OFFSCREEN_BITMAP_ORDER* order);
+void freerds_offscreen_cache_delete(rdsOffscreenCache* cache, UINT32 id);
+BOOL freerds_offscreen_cache_valid(rdsOffscreenCache* cache, UINT32 id);
+
+#endif /* RDS_NG_OFFSCREEN_H */
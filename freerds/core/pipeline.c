@@ -22,13 +22,134 @@
 #endif
 
 #include "freerds.h"
+#include "ring.h"
+#include "arena.h"
+#include "transmit.h"
+
+/**
+ * Frame arenas: payloads of messages enqueued between two pack ticks are
+ * copied into the arena currently filled by the connector thread. The arena
+ * is sealed at pack time with the server queue position of its last message,
+ * and reset by the connection thread once the queue has drained past it.
+ */
+
+rdsArena* freerds_message_server_arena(rdsModuleConnector* connector)
+{
+	int index;
+	rdsArena* arena;
+
+	if (connector->ServerArena || !connector->ServerArenas)
+		return connector->ServerArena;
+
+	for (index = 0; index < RDS_SERVER_ARENA_COUNT; index++)
+	{
+		arena = connector->ServerArenas[index];
+
+		if (InterlockedCompareExchange(&arena->state, RDS_ARENA_FILLING, RDS_ARENA_FREE) == RDS_ARENA_FREE)
+		{
+			connector->ServerArena = arena;
+			break;
+		}
+	}
+
+	/* all arenas in flight: payloads fall back to heap copies */
+
+	return connector->ServerArena;
+}
+
+void freerds_message_server_arena_seal(rdsModuleConnector* connector)
+{
+	rdsArena* arena = connector->ServerArena;
+
+	if (!arena)
+		return;
+
+	arena->sealHead = freerds_message_ring_head(connector->ServerQueue);
+	InterlockedExchange(&arena->state, RDS_ARENA_SEALED);
+
+	connector->ServerArena = NULL;
+}
+
+void freerds_message_server_arena_recycle(rdsModuleConnector* connector)
+{
+	int index;
+	UINT32 tail;
+	rdsArena* arena;
+
+	if (!connector->ServerArenas)
+		return;
+
+	tail = freerds_message_ring_tail(connector->ServerQueue);
+
+	for (index = 0; index < RDS_SERVER_ARENA_COUNT; index++)
+	{
+		arena = connector->ServerArenas[index];
+
+		if (InterlockedCompareExchange(&arena->state, RDS_ARENA_SEALED, RDS_ARENA_SEALED) != RDS_ARENA_SEALED)
+			continue;
+
+		if (((INT32) (tail - arena->sealHead)) < 0)
+			continue;
+
+		freerds_arena_reset(arena);
+		InterlockedExchange(&arena->state, RDS_ARENA_FREE);
+	}
+}
 
 int freerds_server_message_enqueue(rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
 {
-	void* dup = NULL;
-	dup = freerds_server_message_copy(msg);
+	int status;
+	rdsArena* arena;
+
+	arena = freerds_message_server_arena(connector);
+
+	status = freerds_message_ring_write(connector->ServerList, msg, arena);
+
+	if (status == RDS_MESSAGE_RING_FULL)
+	{
+		/* pending list is full: flush it to the server queue early */
+
+		freerds_message_server_queue_pack(connector);
+
+		arena = freerds_message_server_arena(connector);
+
+		status = freerds_message_ring_write(connector->ServerList, msg, arena);
+	}
+
+	if (status < 0)
+		return -1;
+
+	return 0;
+}
+
+static int freerds_server_message_wait(rdsModuleConnector* connector)
+{
+	/* wait for the connection thread to catch up */
+
+	freerds_message_ring_signal(connector->ServerQueue);
+
+	if (WaitForSingleObject(connector->StopEvent, 1) == WAIT_OBJECT_0)
+		return -1;
+
+	return 0;
+}
+
+int freerds_server_message_post(rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
+{
+	int status;
+
+	status = freerds_message_ring_write(connector->ServerQueue, msg, NULL);
+
+	while (status == RDS_MESSAGE_RING_FULL)
+	{
+		if (freerds_server_message_wait(connector) < 0)
+			return -1;
 
-	LinkedList_AddLast(connector->ServerList, (void*) dup);
+		status = freerds_message_ring_write(connector->ServerQueue, msg, NULL);
+	}
+
+	if (status < 0)
+		return -1;
 
 	return 0;
 }
@@ -182,112 +303,27 @@ int freerds_message_server_window_delete(rdsModuleConnector* connector, RDS_MSG_
 	return 0;
 }
 
-int freerds_message_server_queue_process_message(rdsModuleConnector* connector, wMessage* message)
+int freerds_message_server_queue_process_message(rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
 {
 	int status;
 	rdsServerInterface* ServerProxy;
 
 	ServerProxy = connector->ServerProxy;
 
-	if (message->id == WMQ_QUIT)
-		return 0;
-
-	switch (message->id)
+	if ((msg->type != RDS_SERVER_PAINT_RECT) && (msg->type != RDS_SERVER_BEGIN_UPDATE) &&
+			(msg->type != RDS_SERVER_END_UPDATE))
 	{
-		case RDS_SERVER_BEGIN_UPDATE:
-			status = ServerProxy->BeginUpdate(connector, (RDS_MSG_BEGIN_UPDATE*) message->wParam);
-			break;
-
-		case RDS_SERVER_END_UPDATE:
-			status = ServerProxy->EndUpdate(connector, (RDS_MSG_END_UPDATE*) message->wParam);
-			break;
-
-		case RDS_SERVER_BEEP:
-			status = ServerProxy->Beep(connector, (RDS_MSG_BEEP*) message->wParam);
-			break;
-
-		case RDS_SERVER_OPAQUE_RECT:
-			status = ServerProxy->OpaqueRect(connector, (RDS_MSG_OPAQUE_RECT*) message->wParam);
-			break;
+		/* updates sent outside of the transmit stage must not overtake queued surface bits */
+		/* (BeginUpdate and EndUpdate flush in freerds_orders_begin_paint/end_paint) */
 
-		case RDS_SERVER_SCREEN_BLT:
-			status = ServerProxy->ScreenBlt(connector, (RDS_MSG_SCREEN_BLT*) message->wParam);
-			break;
-
-		case RDS_SERVER_PAINT_RECT:
-			status = ServerProxy->PaintRect(connector, (RDS_MSG_PAINT_RECT*) message->wParam);
-			break;
-
-		case RDS_SERVER_PATBLT:
-			status = ServerProxy->PatBlt(connector, (RDS_MSG_PATBLT*) message->wParam);
-			break;
-
-		case RDS_SERVER_DSTBLT:
-			status = ServerProxy->DstBlt(connector, (RDS_MSG_DSTBLT*) message->wParam);
-			break;
-
-		case RDS_SERVER_SET_POINTER:
-			status = ServerProxy->SetPointer(connector, (RDS_MSG_SET_POINTER*) message->wParam);
-			break;
-
-		case RDS_SERVER_SET_SYSTEM_POINTER:
-			status = ServerProxy->SetSystemPointer(connector, (RDS_MSG_SET_SYSTEM_POINTER*) message->wParam);
-			break;
-
-		case RDS_SERVER_SET_PALETTE:
-			status = ServerProxy->SetPalette(connector, (RDS_MSG_SET_PALETTE*) message->wParam);
-			break;
-
-		case RDS_SERVER_SET_CLIPPING_REGION:
-			status = ServerProxy->SetClippingRegion(connector, (RDS_MSG_SET_CLIPPING_REGION*) message->wParam);
-			break;
-
-		case RDS_SERVER_LINE_TO:
-			status = ServerProxy->LineTo(connector, (RDS_MSG_LINE_TO*) message->wParam);
-			break;
-
-		case RDS_SERVER_CACHE_GLYPH:
-			status = ServerProxy->CacheGlyph(connector, (RDS_MSG_CACHE_GLYPH*) message->wParam);
-			break;
-
-		case RDS_SERVER_GLYPH_INDEX:
-			status = ServerProxy->GlyphIndex(connector, (RDS_MSG_GLYPH_INDEX*) message->wParam);
-			break;
-
-		case RDS_SERVER_SHARED_FRAMEBUFFER:
-			status = ServerProxy->SharedFramebuffer(connector, (RDS_MSG_SHARED_FRAMEBUFFER*) message->wParam);
-			break;
-
-		case RDS_SERVER_RESET:
-			status = ServerProxy->Reset(connector, (RDS_MSG_RESET*) message->wParam);
-			break;
-
-		case RDS_SERVER_CREATE_OFFSCREEN_SURFACE:
-			status = ServerProxy->CreateOffscreenSurface(connector, (RDS_MSG_CREATE_OFFSCREEN_SURFACE*) message->wParam);
-			break;
-
-		case RDS_SERVER_SWITCH_OFFSCREEN_SURFACE:
-			status = ServerProxy->SwitchOffscreenSurface(connector, (RDS_MSG_SWITCH_OFFSCREEN_SURFACE*) message->wParam);
-			break;
-
-		case RDS_SERVER_DELETE_OFFSCREEN_SURFACE:
-			status = ServerProxy->DeleteOffscreenSurface(connector, (RDS_MSG_DELETE_OFFSCREEN_SURFACE*) message->wParam);
-			break;
-
-		case RDS_SERVER_PAINT_OFFSCREEN_SURFACE:
-			status = ServerProxy->PaintOffscreenSurface(connector, (RDS_MSG_PAINT_OFFSCREEN_SURFACE*) message->wParam);
-			break;
-
-		default:
-			status = -1;
-			break;
+		freerds_transmit_flush(connector->connection);
 	}
 
-	freerds_server_message_free((RDS_MSG_COMMON*) message->wParam);
+	status = freerds_server_message_call(ServerProxy, connector, msg);
 
 	if (status < 0)
 	{
-		printf("freerds_message_server_queue_process_message (%d) status: %d\n", message->id, status);
+		printf("freerds_message_server_queue_process_message (%d) status: %d\n", msg->type, status);
 		return -1;
 	}
 
@@ -308,7 +344,7 @@ int freerds_message_server_align_rect(rdsModuleConnector* connector, RDS_RECT* r
 	rect->width += rect->x % 16;
 	rect->x -= rect->x % 16;
 
-	rect->width += rect->width % 16;
+	rect->width = (rect->width + 15) & ~15;
 
 	if (rect->x + rect->width > settings->DesktopWidth)
 		rect->width = settings->DesktopWidth - rect->x;
@@ -322,7 +358,7 @@ int freerds_message_server_align_rect(rdsModuleConnector* connector, RDS_RECT* r
 	rect->height += rect->y % 16;
 	rect->y -= rect->y % 16;
 
-	rect->height += rect->height % 16;
+	rect->height = (rect->height + 15) & ~15;
 
 	if (rect->height > settings->DesktopHeight)
 		rect->height = settings->DesktopHeight;
@@ -333,110 +369,482 @@ int freerds_message_server_align_rect(rdsModuleConnector* connector, RDS_RECT* r
 	return 0;
 }
 
+/**
+ * Damage rectangle merging: the cheapest pair of rectangles is replaced by its
+ * bounding box as long as the pixels this wastes cost less than sending one more
+ * rectangle (RDS_DAMAGE_RECT_COST), the two overlap, or there are more than
+ * RDS_DAMAGE_MAX_RECTS rectangles. Rectangles are aligned before merging, so the
+ * result has no overlapping rectangles and no pixel is encoded twice.
+ *
+ * Every rectangle keeps track of its cheapest partner: after a merge, only the
+ * rectangles that were paired with one of the merged two are searched again.
+ */
+
+static INT64 freerds_rect_area(RDS_RECT* rect)
+{
+	return ((INT64) rect->width) * ((INT64) rect->height);
+}
+
+static void freerds_rect_bounds(RDS_RECT* a, RDS_RECT* b, RDS_RECT* bounds)
+{
+	INT32 right;
+	INT32 bottom;
+
+	right = MAX(a->x + (INT32) a->width, b->x + (INT32) b->width);
+	bottom = MAX(a->y + (INT32) a->height, b->y + (INT32) b->height);
+
+	bounds->x = MIN(a->x, b->x);
+	bounds->y = MIN(a->y, b->y);
+	bounds->width = right - bounds->x;
+	bounds->height = bottom - bounds->y;
+}
+
+static BOOL freerds_rect_intersects(RDS_RECT* a, RDS_RECT* b)
+{
+	return ((a->x < b->x + (INT32) b->width) && (b->x < a->x + (INT32) a->width) &&
+			(a->y < b->y + (INT32) b->height) && (b->y < a->y + (INT32) a->height)) ? TRUE : FALSE;
+}
+
+static INT64 freerds_rect_merge_cost(RDS_RECT* a, RDS_RECT* b)
+{
+	INT64 cost;
+	RDS_RECT bounds;
+
+	freerds_rect_bounds(a, b, &bounds);
+
+	cost = freerds_rect_area(&bounds) - freerds_rect_area(a) - freerds_rect_area(b);
+
+	/* overlapping rectangles are always merged */
+
+	if ((cost > 0) && freerds_rect_intersects(a, b))
+		cost = 0;
+
+	return cost;
+}
+
+static void freerds_rect_find_partner(RDS_RECT* rects, int count, int index, int* partner, INT64* partnerCost)
+{
+	int other;
+	INT64 cost;
+
+	partner[index] = -1;
+
+	for (other = 0; other < count; other++)
+	{
+		if (other == index)
+			continue;
+
+		cost = freerds_rect_merge_cost(&rects[index], &rects[other]);
+
+		if ((partner[index] < 0) || (cost < partnerCost[index]))
+		{
+			partner[index] = other;
+			partnerCost[index] = cost;
+		}
+	}
+}
+
+int freerds_message_server_merge_rects(RDS_RECT* rects, int count)
+{
+	int i, j, k;
+	int last;
+	int best;
+	INT64 cost;
+	RDS_RECT bounds;
+	int partner[RDS_DAMAGE_MAX_REGION_RECTS];
+	INT64 partnerCost[RDS_DAMAGE_MAX_REGION_RECTS];
+
+	if (count > RDS_DAMAGE_MAX_REGION_RECTS)
+		return count;
+
+	for (i = 0; i < count; i++)
+		freerds_rect_find_partner(rects, count, i, partner, partnerCost);
+
+	while (count > 1)
+	{
+		best = 0;
+
+		for (k = 1; k < count; k++)
+		{
+			if (partnerCost[k] < partnerCost[best])
+				best = k;
+		}
+
+		if ((partnerCost[best] > RDS_DAMAGE_RECT_COST) && (count <= RDS_DAMAGE_MAX_RECTS))
+			break;
+
+		i = MIN(best, partner[best]);
+		j = MAX(best, partner[best]);
+		last = count - 1;
+
+		freerds_rect_bounds(&rects[i], &rects[j], &bounds);
+		rects[i] = bounds;
+
+		/* j is removed and the last rectangle takes its place */
+
+		for (k = 0; k < count; k++)
+		{
+			if ((partner[k] == i) || (partner[k] == j))
+				partner[k] = -1;
+			else if (partner[k] == last)
+				partner[k] = j;
+		}
+
+		rects[j] = rects[last];
+		partner[j] = partner[last];
+		partnerCost[j] = partnerCost[last];
+		count--;
+
+		freerds_rect_find_partner(rects, count, i, partner, partnerCost);
+
+		for (k = 0; k < count; k++)
+		{
+			if (k == i)
+				continue;
+
+			if (partner[k] < 0)
+			{
+				freerds_rect_find_partner(rects, count, k, partner, partnerCost);
+				continue;
+			}
+
+			cost = freerds_rect_merge_cost(&rects[k], &rects[i]);
+
+			if (cost < partnerCost[k])
+			{
+				partner[k] = i;
+				partnerCost[k] = cost;
+			}
+		}
+	}
+
+	return count;
+}
+
+int freerds_message_server_post_paint_rect(rdsModuleConnector* connector, RDS_RECT* rect)
+{
+	RDS_MSG_PAINT_RECT paintRect;
+
+	freerds_message_server_align_rect(connector, rect);
+
+	if (!(rect->width * rect->height))
+		return 0;
+
+	paintRect.type = RDS_SERVER_PAINT_RECT;
+
+	paintRect.nXSrc = 0;
+	paintRect.nYSrc = 0;
+	paintRect.bitmapData = NULL;
+	paintRect.bitmapDataLength = 0;
+	paintRect.framebuffer = &(connector->framebuffer);
+	paintRect.fbSegmentId = connector->framebuffer.fbSegmentId;
+
+	paintRect.nLeftRect = rect->x;
+	paintRect.nTopRect = rect->y;
+	paintRect.nWidth = rect->width;
+	paintRect.nHeight = rect->height;
+
+	freerds_server_message_post(connector, (RDS_MSG_COMMON*) &paintRect);
+
+	return 1;
+}
+
+int freerds_message_server_post_update(rdsModuleConnector* connector, UINT32 type)
+{
+	RDS_MSG_BEGIN_UPDATE update;
+
+	ZeroMemory(&update, sizeof(RDS_MSG_BEGIN_UPDATE));
+	update.type = type;
+
+	freerds_server_message_post(connector, (RDS_MSG_COMMON*) &update);
+
+	return 0;
+}
+
+static void freerds_message_server_update_clipping(rdsModuleConnector* connector, RDS_MSG_SET_CLIPPING_REGION* msg)
+{
+	connector->ClippingEnabled = msg->bNullRegion ? FALSE : TRUE;
+
+	connector->ClippingRect.x = msg->nLeftRect;
+	connector->ClippingRect.y = msg->nTopRect;
+	connector->ClippingRect.width = msg->nWidth;
+	connector->ClippingRect.height = msg->nHeight;
+}
+
+/**
+ * A ternary raster operation reads the destination
+ * when its result differs between D=0 and D=1.
+ */
+
+static BOOL freerds_rop3_reads_dest(UINT32 rop)
+{
+	rop &= 0xFF;
+	return (((rop >> 1) & 0x55) != (rop & 0x55)) ? TRUE : FALSE;
+}
+
+static BOOL freerds_message_server_order_supported(rdsModuleConnector* connector, UINT32 type)
+{
+	rdpSettings* settings;
+
+	if (!connector->OrderMode || !connector->connection || !connector->settings)
+		return FALSE;
+
+	if (connector->connection->codecMode)
+		return FALSE;
+
+	settings = connector->settings;
+
+	switch (type)
+	{
+		case RDS_SERVER_OPAQUE_RECT:
+			return settings->OrderSupport[NEG_OPAQUE_RECT_INDEX] ? TRUE : FALSE;
+
+		case RDS_SERVER_SCREEN_BLT:
+			return settings->OrderSupport[NEG_SCRBLT_INDEX] ? TRUE : FALSE;
+
+		case RDS_SERVER_PATBLT:
+			return settings->OrderSupport[NEG_PATBLT_INDEX] ? TRUE : FALSE;
+
+		case RDS_SERVER_DSTBLT:
+			return settings->OrderSupport[NEG_DSTBLT_INDEX] ? TRUE : FALSE;
+
+		case RDS_SERVER_GLYPH_INDEX:
+			return (settings->OrderSupport[NEG_GLYPH_INDEX_INDEX] &&
+					(settings->GlyphSupportLevel != GLYPH_SUPPORT_NONE)) ? TRUE : FALSE;
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Decide whether a drawing order can be forwarded as a primary order.
+ * Orders that would read pixels which are still pending in the damage
+ * region cannot be replayed ahead of the damage and fall back to it,
+ * while forwarded orders replace any pending damage they overwrite.
+ */
+
+static int freerds_message_server_pack_order(rdsModuleConnector* connector, RDS_MSG_COMMON* node, pixman_region32_t* region)
+{
+	BOOL reads;
+	RDS_RECT* clip;
+	pixman_box32_t dst;
+	pixman_box32_t src;
+	pixman_region32_t order;
+	RDS_MSG_SCREEN_BLT* screenBlt;
+	RDS_MSG_GLYPH_INDEX* glyphIndex;
+
+	/* inline pixels fill offscreen surfaces and never touch the screen */
+
+	if ((node->type == RDS_SERVER_PAINT_RECT) && !((RDS_MSG_PAINT_RECT*) node)->fbSegmentId)
+		return 1;
+
+	dst.x1 = node->rect.x;
+	dst.y1 = node->rect.y;
+	dst.x2 = node->rect.x + node->rect.width;
+	dst.y2 = node->rect.y + node->rect.height;
+
+	if (connector->ClippingEnabled && (node->type != RDS_SERVER_PAINT_RECT))
+	{
+		clip = &(connector->ClippingRect);
+
+		dst.x1 = MAX(dst.x1, clip->x);
+		dst.y1 = MAX(dst.y1, clip->y);
+		dst.x2 = MIN(dst.x2, clip->x + clip->width);
+		dst.y2 = MIN(dst.y2, clip->y + clip->height);
+	}
+
+	if ((dst.x1 >= dst.x2) || (dst.y1 >= dst.y2))
+		return 0;
+
+	if (!freerds_message_server_order_supported(connector, node->type))
+	{
+		pixman_region32_union_rect(region, region, dst.x1, dst.y1, dst.x2 - dst.x1, dst.y2 - dst.y1);
+		return 0;
+	}
+
+	reads = FALSE;
+	src = dst;
+
+	switch (node->type)
+	{
+		case RDS_SERVER_SCREEN_BLT:
+			screenBlt = (RDS_MSG_SCREEN_BLT*) node;
+			src.x1 += screenBlt->nXSrc - screenBlt->nLeftRect;
+			src.y1 += screenBlt->nYSrc - screenBlt->nTopRect;
+			src.x2 += screenBlt->nXSrc - screenBlt->nLeftRect;
+			src.y2 += screenBlt->nYSrc - screenBlt->nTopRect;
+			reads = TRUE;
+			break;
+
+		case RDS_SERVER_PATBLT:
+			reads = freerds_rop3_reads_dest(((RDS_MSG_PATBLT*) node)->bRop);
+			break;
+
+		case RDS_SERVER_DSTBLT:
+			reads = freerds_rop3_reads_dest(((RDS_MSG_DSTBLT*) node)->bRop);
+			break;
+
+		case RDS_SERVER_GLYPH_INDEX:
+			glyphIndex = (RDS_MSG_GLYPH_INDEX*) node;
+			reads = ((glyphIndex->opLeft > dst.x1) || (glyphIndex->opTop > dst.y1) ||
+					(glyphIndex->opRight < dst.x2) || (glyphIndex->opBottom < dst.y2)) ? TRUE : FALSE;
+			break;
+
+		default:
+			break;
+	}
+
+	if (reads && (pixman_region32_contains_rectangle(region, &src) != PIXMAN_REGION_OUT))
+	{
+		pixman_region32_union_rect(region, region, dst.x1, dst.y1, dst.x2 - dst.x1, dst.y2 - dst.y1);
+		return 0;
+	}
+
+	pixman_region32_init_rect(&order, dst.x1, dst.y1, dst.x2 - dst.x1, dst.y2 - dst.y1);
+	pixman_region32_subtract(region, region, &order);
+	pixman_region32_fini(&order);
+
+	return 1;
+}
+
 int freerds_message_server_queue_pack(rdsModuleConnector* connector)
 {
+	int index;
+	int count;
 	RDS_RECT rect;
+	BOOL forward;
+	BOOL updateOpen;
 	int ChainedMode;
-	wLinkedList* list;
-	rdsConnection* connection;
+	rdsMessageRing* list;
 	RDS_MSG_COMMON* node;
-	pixman_bool_t status;
+	pixman_box32_t* boxes;
 	pixman_box32_t* extents;
 	pixman_region32_t region;
+	RDS_RECT rects[RDS_DAMAGE_MAX_REGION_RECTS];
 
 	ChainedMode = 0;
-	connection = connector->connection;
+	updateOpen = FALSE;
 
 	list = connector->ServerList;
 
 	pixman_region32_init(&region);
 
-	LinkedList_Enumerator_Reset(list);
-
-	while (LinkedList_Enumerator_MoveNext(list))
+	while ((node = freerds_message_ring_peek(list)) != NULL)
 	{
-		node = (RDS_MSG_COMMON*) LinkedList_Enumerator_Current(list);
+		forward = TRUE;
+
+		if (node->type == RDS_SERVER_SET_CLIPPING_REGION)
+			freerds_message_server_update_clipping(connector, (RDS_MSG_SET_CLIPPING_REGION*) node);
 
 		if ((!ChainedMode) && (node->msgFlags & RDS_MSG_FLAG_RECT))
 		{
-			status = pixman_region32_union_rect(&region, &region,
-					node->rect.x, node->rect.y, node->rect.width, node->rect.height);
+			forward = freerds_message_server_pack_order(connector, node, &region) ? TRUE : FALSE;
+
+			if (forward && !updateOpen)
+			{
+				freerds_message_server_post_update(connector, RDS_SERVER_BEGIN_UPDATE);
+				updateOpen = TRUE;
+			}
 		}
-		else
+
+		if (forward)
 		{
-			MessageQueue_Post(connector->ServerQueue, (void*) connector, node->type, (void*) node, NULL);
+			while (freerds_message_ring_move(connector->ServerQueue, list) < 0)
+			{
+				if (freerds_server_message_wait(connector) < 0)
+					break;
+			}
 		}
-	}
 
-	LinkedList_Clear(list);
+		freerds_message_ring_release(list);
+	}
 
-	if (!ChainedMode)
+	if (!ChainedMode && connector->framebuffer.fbAttached && pixman_region32_not_empty(&region))
 	{
-		extents = pixman_region32_extents(&region);
-
-		rect.x = extents->x1;
-		rect.y = extents->y1;
-		rect.width = extents->x2 - extents->x1;
-		rect.height = extents->y2 - extents->y1;
-
-		freerds_message_server_align_rect(connector, &rect);
+		boxes = pixman_region32_rectangles(&region, &count);
 
-		if (connector->framebuffer.fbAttached && (rect.width * rect.height))
+		if ((connector->DamageMode == RDS_DAMAGE_MODE_RECTS) && (count > 1) &&
+				(count <= RDS_DAMAGE_MAX_REGION_RECTS))
 		{
-			RDS_MSG_COMMON* msg;
-			RDS_MSG_PAINT_RECT paintRect;
-
-			paintRect.type = RDS_SERVER_PAINT_RECT;
-
-			paintRect.nXSrc = 0;
-			paintRect.nYSrc = 0;
-			paintRect.bitmapData = NULL;
-			paintRect.bitmapDataLength = 0;
-			paintRect.framebuffer = &(connector->framebuffer);
-			paintRect.fbSegmentId = connector->framebuffer.fbSegmentId;
-
-			paintRect.nLeftRect = rect.x;
-			paintRect.nTopRect = rect.y;
-			paintRect.nWidth = rect.width;
-			paintRect.nHeight = rect.height;
+			for (index = 0; index < count; index++)
+			{
+				rects[index].x = boxes[index].x1;
+				rects[index].y = boxes[index].y1;
+				rects[index].width = boxes[index].x2 - boxes[index].x1;
+				rects[index].height = boxes[index].y2 - boxes[index].y1;
+
+				freerds_message_server_align_rect(connector, &rects[index]);
+			}
+
+			count = freerds_message_server_merge_rects(rects, count);
+
+			if (!updateOpen)
+			{
+				freerds_message_server_post_update(connector, RDS_SERVER_BEGIN_UPDATE);
+				updateOpen = TRUE;
+			}
+
+			for (index = 0; index < count; index++)
+				freerds_message_server_post_paint_rect(connector, &rects[index]);
+		}
+		else
+		{
+			extents = pixman_region32_extents(&region);
 
-			msg = freerds_server_message_copy((RDS_MSG_COMMON*) &paintRect);
+			rect.x = extents->x1;
+			rect.y = extents->y1;
+			rect.width = extents->x2 - extents->x1;
+			rect.height = extents->y2 - extents->y1;
 
-			MessageQueue_Post(connector->ServerQueue, (void*) connector, msg->type, (void*) msg, NULL);
+			freerds_message_server_post_paint_rect(connector, &rect);
 		}
 	}
 
+	if (updateOpen)
+		freerds_message_server_post_update(connector, RDS_SERVER_END_UPDATE);
+
 	pixman_region32_fini(&region);
 
+	freerds_message_server_arena_seal(connector);
+
+	if (freerds_message_ring_count(connector->ServerQueue))
+		freerds_message_ring_signal(connector->ServerQueue);
+
 	return 0;
 }
 
 int freerds_message_server_queue_process_pending_messages(rdsModuleConnector* connector)
 {
-	int count;
 	int status;
-	wMessage message;
-	wMessageQueue* queue;
+	RDS_MSG_COMMON* msg;
+	rdsMessageRing* queue;
 
-	count = 0;
 	status = 0;
 	queue = connector->ServerQueue;
 
-	while (MessageQueue_Peek(queue, &message, TRUE))
+	while ((msg = freerds_message_ring_peek(queue)) != NULL)
 	{
-		status = freerds_message_server_queue_process_message(connector, &message);
+		status = freerds_message_server_queue_process_message(connector, msg);
 
-		if (!status)
-			break;
+		freerds_message_ring_release(queue);
 
-		count++;
+		if (status < 0)
+			break;
 	}
 
+	if (!msg)
+		freerds_message_server_arena_recycle(connector);
+
 	return status;
 }
 
 int freerds_message_server_connector_init(rdsModuleConnector* connector)
 {
+	int index;
+
 	connector->ServerProxy = (rdsServerInterface*) malloc(sizeof(rdsServerInterface));
 
 	//mod->ServerProxy = NULL; /* disable */
@@ -472,8 +880,28 @@ int freerds_message_server_connector_init(rdsModuleConnector* connector)
 	}
 
 	connector->MaxFps = connector->fps = 60;
-	connector->ServerList = LinkedList_New();
-	connector->ServerQueue = MessageQueue_New();
+	connector->DamageMode = RDS_DAMAGE_MODE_RECTS;
+	connector->OrderMode = TRUE;
+	connector->ClippingEnabled = FALSE;
+	connector->ServerList = freerds_message_ring_new(RDS_SERVER_LIST_SIZE);
+	connector->ServerQueue = freerds_message_ring_new(RDS_SERVER_QUEUE_SIZE);
+
+	connector->ServerArena = NULL;
+	connector->ServerArenas = (rdsArena**) calloc(RDS_SERVER_ARENA_COUNT, sizeof(rdsArena*));
+
+	for (index = 0; connector->ServerArenas && (index < RDS_SERVER_ARENA_COUNT); index++)
+	{
+		connector->ServerArenas[index] = freerds_arena_new(RDS_SERVER_ARENA_BLOCK_SIZE);
+
+		if (!connector->ServerArenas[index])
+		{
+			while (index--)
+				freerds_arena_free(connector->ServerArenas[index]);
+
+			free(connector->ServerArenas);
+			connector->ServerArenas = NULL;
+		}
+	}
 
 	return 0;
 }
@@ -0,0 +1,151 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Pointer Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#include "pointer.h"
+
+static UINT32 freerds_pointer_hash(RDS_MSG_SET_POINTER* msg, UINT32 lengthXorMask)
+{
+	UINT32 index;
+	UINT32 hash;
+
+	hash = 2166136261U;
+
+	hash = (hash ^ msg->xorBpp) * 16777619U;
+	hash = (hash ^ msg->xPos) * 16777619U;
+	hash = (hash ^ msg->yPos) * 16777619U;
+
+	for (index = 0; index < lengthXorMask; index++)
+		hash = (hash ^ msg->xorMaskData[index]) * 16777619U;
+
+	for (index = 0; index < RDS_POINTER_AND_MASK_SIZE; index++)
+		hash = (hash ^ msg->andMaskData[index]) * 16777619U;
+
+	return hash;
+}
+
+rdsPointerCache* freerds_pointer_cache_new(rdpSettings* settings)
+{
+	rdsPointerCache* cache;
+
+	cache = (rdsPointerCache*) calloc(1, sizeof(rdsPointerCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->current = -1;
+	cache->numEntries = MIN(settings->PointerCacheSize, RDS_POINTER_CACHE_MAX_ENTRIES);
+
+	if (!cache->numEntries)
+		return cache;
+
+	cache->entries = (rdsPointerEntry*) calloc(cache->numEntries, sizeof(rdsPointerEntry));
+
+	if (!cache->entries)
+		cache->numEntries = 0;
+
+	return cache;
+}
+
+void freerds_pointer_cache_free(rdsPointerCache* cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->entries);
+	free(cache);
+}
+
+/**
+ * Returns the client cache index holding the pointer, or the index it has to be
+ * sent to when cached is FALSE, or -1 when the client has no pointer cache.
+ */
+
+int freerds_pointer_cache_get(rdsPointerCache* cache, RDS_MSG_SET_POINTER* msg, BOOL* cached)
+{
+	UINT32 hash;
+	UINT32 index;
+	UINT32 lengthXorMask;
+	int victim;
+	rdsPointerEntry* entry;
+
+	if (!cache->numEntries)
+		return -1;
+
+	if (!msg->xorBpp)
+		lengthXorMask = 32 * 32 * 3;
+	else
+		lengthXorMask = ((msg->xorBpp + 7) / 8) * 32 * 32;
+
+	if ((lengthXorMask > RDS_POINTER_XOR_MASK_MAX_SIZE) || (msg->lengthXorMask < lengthXorMask) ||
+			(msg->lengthAndMask < RDS_POINTER_AND_MASK_SIZE))
+		return -1;
+
+	hash = freerds_pointer_hash(msg, lengthXorMask);
+	cache->stamp++;
+	victim = -1;
+
+	for (index = 0; index < cache->numEntries; index++)
+	{
+		entry = &cache->entries[index];
+
+		if (!entry->valid)
+		{
+			if ((victim < 0) || cache->entries[victim].valid)
+				victim = index;
+
+			continue;
+		}
+
+		if ((entry->hash == hash) && (entry->xorBpp == msg->xorBpp) &&
+				(entry->xPos == msg->xPos) && (entry->yPos == msg->yPos) &&
+				(memcmp(entry->xorMaskData, msg->xorMaskData, lengthXorMask) == 0) &&
+				(memcmp(entry->andMaskData, msg->andMaskData, RDS_POINTER_AND_MASK_SIZE) == 0))
+		{
+			entry->stamp = cache->stamp;
+			*cached = TRUE;
+			return index;
+		}
+
+		if ((victim < 0) || (cache->entries[victim].valid && (entry->stamp < cache->entries[victim].stamp)))
+			victim = index;
+	}
+
+	entry = &cache->entries[victim];
+
+	CopyMemory(entry->xorMaskData, msg->xorMaskData, lengthXorMask);
+	CopyMemory(entry->andMaskData, msg->andMaskData, RDS_POINTER_AND_MASK_SIZE);
+
+	entry->valid = TRUE;
+	entry->hash = hash;
+	entry->stamp = cache->stamp;
+	entry->xorBpp = msg->xorBpp;
+	entry->xPos = msg->xPos;
+	entry->yPos = msg->yPos;
+	entry->lengthXorMask = lengthXorMask;
+
+	*cached = FALSE;
+
+	return victim;
+}
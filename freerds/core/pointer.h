@@ -0,0 +1,65 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Pointer Cache
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_POINTER_H
+#define RDS_NG_POINTER_H
+
+#include "core.h"
+
+#define RDS_POINTER_CACHE_MAX_ENTRIES	32
+#define RDS_POINTER_XOR_MASK_MAX_SIZE	(32 * 32 * 4)
+#define RDS_POINTER_AND_MASK_SIZE	(32 * 32 / 8)
+
+/**
+ * Server-side mirror of the client pointer cache.
+ *
+ * Pointer shapes are matched by content, so a shape the client already
+ * holds is selected with a cached pointer update instead of being sent
+ * again. The least recently used entry is replaced when the cache is full.
+ */
+
+struct rds_pointer_entry
+{
+	BOOL valid;
+	UINT32 hash;
+	UINT32 stamp;
+	UINT32 xorBpp;
+	UINT32 xPos;
+	UINT32 yPos;
+	UINT32 lengthXorMask;
+	BYTE xorMaskData[RDS_POINTER_XOR_MASK_MAX_SIZE];
+	BYTE andMaskData[RDS_POINTER_AND_MASK_SIZE];
+};
+typedef struct rds_pointer_entry rdsPointerEntry;
+
+struct rds_pointer_cache
+{
+	UINT32 stamp;
+	int current;
+	UINT32 numEntries;
+	rdsPointerEntry* entries;
+};
+typedef struct rds_pointer_cache rdsPointerCache;
+
+rdsPointerCache* freerds_pointer_cache_new(rdpSettings* settings);
+void freerds_pointer_cache_free(rdsPointerCache* cache);
+
+int freerds_pointer_cache_get(rdsPointerCache* cache, RDS_MSG_SET_POINTER* msg, BOOL* cached);
+
+#endif /* RDS_NG_POINTER_H */
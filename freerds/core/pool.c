@@ -0,0 +1,413 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Encoder Worker Pool
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include "pool.h"
+#include "estimator.h"
+
+struct rds_encoder_pool
+{
+	CRITICAL_SECTION lock;
+	HANDLE WorkSemaphore;
+
+	int threadCount;
+	HANDLE* threads;
+
+	rdsEncoderClient* head;
+	rdsEncoderClient* tail;
+};
+typedef struct rds_encoder_pool rdsEncoderPool;
+
+static rdsEncoderPool* g_EncoderPool = NULL;
+static volatile LONG g_EncoderPoolState = 0;
+
+/**
+ * Scheduling, called with the pool lock held: the client at the head of the
+ * active list gives up one job and goes back to the tail if it has more.
+ */
+
+static rdsEncoderJob* freerds_encoder_pool_next_job(rdsEncoderPool* pool)
+{
+	rdsEncoderJob* job;
+	rdsEncoderClient* client;
+
+	client = pool->head;
+
+	if (!client)
+		return NULL;
+
+	pool->head = client->next;
+
+	if (!pool->head)
+		pool->tail = NULL;
+
+	client->next = NULL;
+
+	job = client->head;
+	client->head = job->next;
+
+	if (!client->head)
+	{
+		client->tail = NULL;
+		client->active = FALSE;
+	}
+	else
+	{
+		if (pool->tail)
+			pool->tail->next = client;
+		else
+			pool->head = client;
+
+		pool->tail = client;
+	}
+
+	return job;
+}
+
+static rdsEncoderJob* freerds_encoder_pool_steal_job(rdsEncoderPool* pool, rdsEncoderClient* client)
+{
+	rdsEncoderJob* job;
+	rdsEncoderClient* prev;
+	rdsEncoderClient* node;
+
+	job = client->head;
+
+	if (!job)
+		return NULL;
+
+	client->head = job->next;
+
+	if (client->head)
+		return job;
+
+	client->tail = NULL;
+	client->active = FALSE;
+
+	prev = NULL;
+	node = pool->head;
+
+	while (node && (node != client))
+	{
+		prev = node;
+		node = node->next;
+	}
+
+	if (node)
+	{
+		if (prev)
+			prev->next = node->next;
+		else
+			pool->head = node->next;
+
+		if (pool->tail == node)
+			pool->tail = prev;
+
+		node->next = NULL;
+	}
+
+	return job;
+}
+
+/**
+ * A RemoteFX paint only needs to be split when its encoded size could
+ * exceed the maximum request size. Anything smaller is encoded as a single
+ * message, sparing the split its per-message tile copies and allocations.
+ */
+
+RFX_MESSAGE* freerds_encoder_rfx_encode(RFX_CONTEXT* context, const RFX_RECT* rect, BYTE* data,
+		int width, int height, int scanline, int* numMessages, int maxDataSize)
+{
+	int tiles;
+	RFX_MESSAGE* message;
+
+	*numMessages = 0;
+
+	if ((rect->width < 1) || (rect->height < 1))
+		return NULL;
+
+	tiles = (((rect->x + rect->width - 1) / 64) - (rect->x / 64) + 1) *
+			(((rect->y + rect->height - 1) / 64) - (rect->y / 64) + 1);
+
+	if (((tiles * RDS_ENCODER_RFX_TILE_MAX_SIZE) + RDS_ENCODER_RFX_MESSAGE_OVERHEAD) > maxDataSize)
+	{
+		return rfx_encode_messages(context, rect, 1, data, width, height,
+				scanline, numMessages, maxDataSize);
+	}
+
+	message = rfx_encode_message(context, rect, 1, data, width, height, scanline);
+
+	if (message)
+		*numMessages = 1;
+
+	return message;
+}
+
+void freerds_encoder_rfx_free(RFX_CONTEXT* context, RFX_MESSAGE* messages, int numMessages)
+{
+	int index;
+
+	if (!messages)
+		return;
+
+	if (!messages->freeArray)
+	{
+		/* single message, released along with its own allocation */
+		rfx_message_free(context, messages);
+		return;
+	}
+
+	for (index = 0; index < numMessages; index++)
+		rfx_message_free(context, &messages[index]);
+
+	free(messages);
+}
+
+static void freerds_encoder_job_run(rdsEncoderJob* job, RFX_CONTEXT* rfx_context, NSC_CONTEXT* nsc_context)
+{
+	if (job->codec == RDS_ENCODER_CODEC_RFX)
+	{
+		rfx_context_set_pixel_format(rfx_context, job->pixelFormat);
+		freerds_estimator_rfx_select(rfx_context, job->quality);
+
+		job->context = (void*) rfx_context;
+		job->messages = (void*) freerds_encoder_rfx_encode(rfx_context, &job->rect, job->data,
+				job->width, job->height, job->scanline, &job->numMessages, job->maxDataSize);
+	}
+	else if (job->codec == RDS_ENCODER_CODEC_NSC)
+	{
+		nsc_context_set_pixel_format(nsc_context, job->pixelFormat);
+
+		job->context = (void*) nsc_context;
+		job->messages = (void*) nsc_encode_messages(nsc_context, job->data,
+				job->x, job->y, job->width, job->height, job->scanline,
+				&job->numMessages, job->maxDataSize);
+	}
+
+	if (!job->messages)
+		job->numMessages = 0;
+
+	if (InterlockedDecrement(&job->client->pending) == 0)
+		SetEvent(job->client->DoneEvent);
+}
+
+static void* freerds_encoder_pool_thread(void* arg)
+{
+	rdsEncoderJob* job;
+	RFX_CONTEXT* rfx_context;
+	NSC_CONTEXT* nsc_context;
+	rdsEncoderPool* pool = (rdsEncoderPool*) arg;
+
+	rfx_context = rfx_context_new(TRUE);
+	rfx_context->mode = RLGR3;
+	freerds_estimator_rfx_init(rfx_context);
+
+	nsc_context = nsc_context_new();
+
+	while (WaitForSingleObject(pool->WorkSemaphore, INFINITE) == WAIT_OBJECT_0)
+	{
+		while (1)
+		{
+			EnterCriticalSection(&pool->lock);
+			job = freerds_encoder_pool_next_job(pool);
+			LeaveCriticalSection(&pool->lock);
+
+			if (!job)
+				break;
+
+			freerds_encoder_job_run(job, rfx_context, nsc_context);
+		}
+	}
+
+	rfx_context_free(rfx_context);
+	nsc_context_free(nsc_context);
+
+	return NULL;
+}
+
+static rdsEncoderPool* freerds_encoder_pool_new(void)
+{
+	int index;
+	SYSTEM_INFO sysinfo;
+	rdsEncoderPool* pool;
+
+	pool = (rdsEncoderPool*) calloc(1, sizeof(rdsEncoderPool));
+
+	if (!pool)
+		return NULL;
+
+	GetSystemInfo(&sysinfo);
+
+	pool->threadCount = sysinfo.dwNumberOfProcessors;
+
+	if (pool->threadCount < 1)
+		pool->threadCount = 1;
+
+	InitializeCriticalSection(&pool->lock);
+	pool->WorkSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+
+	pool->threads = (HANDLE*) calloc(pool->threadCount, sizeof(HANDLE));
+
+	for (index = 0; index < pool->threadCount; index++)
+	{
+		pool->threads[index] = CreateThread(NULL, 0,
+				(LPTHREAD_START_ROUTINE) freerds_encoder_pool_thread, (void*) pool, 0, NULL);
+	}
+
+	return pool;
+}
+
+static rdsEncoderPool* freerds_encoder_pool_get(void)
+{
+	LONG state;
+
+	state = InterlockedCompareExchange(&g_EncoderPoolState, 1, 0);
+
+	if (state == 0)
+	{
+		g_EncoderPool = freerds_encoder_pool_new();
+		InterlockedExchange(&g_EncoderPoolState, 2);
+	}
+	else
+	{
+		while (InterlockedCompareExchange(&g_EncoderPoolState, 2, 2) != 2)
+			Sleep(1);
+	}
+
+	return g_EncoderPool;
+}
+
+int freerds_encoder_pool_thread_count(void)
+{
+	rdsEncoderPool* pool = freerds_encoder_pool_get();
+
+	return (pool) ? pool->threadCount : 0;
+}
+
+rdsEncoderClient* freerds_encoder_client_new(void)
+{
+	rdsEncoderClient* client;
+
+	if (!freerds_encoder_pool_get())
+		return NULL;
+
+	client = (rdsEncoderClient*) calloc(1, sizeof(rdsEncoderClient));
+
+	if (!client)
+		return NULL;
+
+	client->DoneEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+
+	return client;
+}
+
+void freerds_encoder_client_free(rdsEncoderClient* client)
+{
+	if (!client)
+		return;
+
+	CloseHandle(client->DoneEvent);
+	free(client);
+}
+
+rdsEncoderJob* freerds_encoder_client_add_job(rdsEncoderClient* client)
+{
+	rdsEncoderJob* job;
+
+	if (client->count >= RDS_ENCODER_MAX_JOBS)
+		return NULL;
+
+	job = &client->jobs[client->count++];
+	ZeroMemory(job, sizeof(rdsEncoderJob));
+	job->client = client;
+
+	return job;
+}
+
+/**
+ * Encodes all jobs added since the last reset and returns once every one of
+ * them is done. The calling thread encodes with its own codec contexts
+ * whatever the workers have not picked up yet.
+ */
+
+int freerds_encoder_client_encode(rdsEncoderClient* client, RFX_CONTEXT* rfx_context, NSC_CONTEXT* nsc_context)
+{
+	int index;
+	rdsEncoderJob* job;
+	rdsEncoderPool* pool = g_EncoderPool;
+
+	if (!client->count)
+		return 0;
+
+	for (index = 0; index < client->count; index++)
+		client->jobs[index].next = (index + 1 < client->count) ? &client->jobs[index + 1] : NULL;
+
+	client->pending = client->count;
+	ResetEvent(client->DoneEvent);
+
+	EnterCriticalSection(&pool->lock);
+
+	client->head = &client->jobs[0];
+	client->tail = &client->jobs[client->count - 1];
+
+	if (!client->active)
+	{
+		client->active = TRUE;
+		client->next = NULL;
+
+		if (pool->tail)
+			pool->tail->next = client;
+		else
+			pool->head = client;
+
+		pool->tail = client;
+	}
+
+	LeaveCriticalSection(&pool->lock);
+
+	ReleaseSemaphore(pool->WorkSemaphore, MIN(client->count, pool->threadCount), NULL);
+
+	while (1)
+	{
+		EnterCriticalSection(&pool->lock);
+		job = freerds_encoder_pool_steal_job(pool, client);
+		LeaveCriticalSection(&pool->lock);
+
+		if (!job)
+			break;
+
+		freerds_encoder_job_run(job, rfx_context, nsc_context);
+	}
+
+	WaitForSingleObject(client->DoneEvent, INFINITE);
+
+	return 0;
+}
+
+void freerds_encoder_client_reset(rdsEncoderClient* client)
+{
+	client->count = 0;
+	client->head = client->tail = NULL;
+}
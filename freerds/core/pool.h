@@ -0,0 +1,100 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Encoder Worker Pool
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_POOL_H
+#define RDS_NG_POOL_H
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/codec/rfx.h>
+#include <freerdp/codec/nsc.h>
+
+#define RDS_ENCODER_CODEC_RFX		1
+#define RDS_ENCODER_CODEC_NSC		2
+
+#define RDS_ENCODER_MAX_JOBS		32
+#define RDS_ENCODER_BAND_HEIGHT		64
+
+#define RDS_ENCODER_RFX_TILE_MAX_SIZE		((64 * 64 * 3 * 2) + 64)
+#define RDS_ENCODER_RFX_MESSAGE_OVERHEAD	1024
+
+/**
+ * Process-wide encoder pool shared by all connections.
+ *
+ * A paint is split into horizontal bands aligned on the 64x64 tile grid,
+ * each band being encoded as one job. Workers take jobs round-robin from
+ * the connections with pending work so that a busy session cannot starve
+ * the others. The submitting thread encodes its own jobs while waiting,
+ * and reads the results back in band order.
+ */
+
+typedef struct rds_encoder_job rdsEncoderJob;
+typedef struct rds_encoder_client rdsEncoderClient;
+
+struct rds_encoder_job
+{
+	rdsEncoderClient* client;
+	rdsEncoderJob* next;
+
+	int codec;
+	int pixelFormat;
+	BYTE* data;
+	int x, y;
+	int width;
+	int height;
+	int scanline;
+	int maxDataSize;
+	int quality;
+	RFX_RECT rect;
+
+	void* context;
+	void* messages;
+	int numMessages;
+};
+
+struct rds_encoder_client
+{
+	rdsEncoderClient* next;
+	BOOL active;
+
+	rdsEncoderJob* head;
+	rdsEncoderJob* tail;
+
+	int count;
+	rdsEncoderJob jobs[RDS_ENCODER_MAX_JOBS];
+
+	volatile LONG pending;
+	HANDLE DoneEvent;
+};
+
+int freerds_encoder_pool_thread_count(void);
+
+rdsEncoderClient* freerds_encoder_client_new(void);
+void freerds_encoder_client_free(rdsEncoderClient* client);
+
+rdsEncoderJob* freerds_encoder_client_add_job(rdsEncoderClient* client);
+int freerds_encoder_client_encode(rdsEncoderClient* client, RFX_CONTEXT* rfx_context, NSC_CONTEXT* nsc_context);
+void freerds_encoder_client_reset(rdsEncoderClient* client);
+
+RFX_MESSAGE* freerds_encoder_rfx_encode(RFX_CONTEXT* context, const RFX_RECT* rect, BYTE* data,
+		int width, int height, int scanline, int* numMessages, int maxDataSize);
+void freerds_encoder_rfx_free(RFX_CONTEXT* context, RFX_MESSAGE* messages, int numMessages);
+
+#endif /* RDS_NG_POOL_H */
@@ -42,6 +42,11 @@
 #include "makecert.h"
 
 #include "channels.h"
+#include "transmit.h"
+#include "frame.h"
+#include "estimator.h"
+#include "encoder.h"
+#include "capture.h"
 
 void freerds_peer_context_new(freerdp_peer* client, rdsConnection* context)
 {
@@ -167,6 +172,18 @@ BOOL freerds_peer_activate(freerdp_peer* client)
 	if (settings->RemoteFxCodec || settings->NSCodec)
 		connection->codecMode = TRUE;
 
+	if (connection->codecMode && !connection->transmit)
+		connection->transmit = freerds_transmit_new(connection);
+
+	freerds_encoder_set_free(connection->encoders);
+	connection->encoders = freerds_encoder_set_new(connection);
+
+	freerds_frame_ring_free(connection->frames);
+	connection->frames = freerds_frame_ring_new(settings->FrameAcknowledge);
+
+	if (!connection->capture)
+		connection->capture = freerds_capture_new(getenv("FREERDS_CAPTURE_DIR"));
+
 	auth_status = freerds_authenticate(settings->Username, settings->Password, &error_code);
 
 	if (!connection->connector)
@@ -342,16 +359,13 @@ void freerds_input_register_callbacks(rdpInput* input)
 
 void freerds_update_frame_acknowledge(rdpContext* context, UINT32 frameId)
 {
-	SURFACE_FRAME* frame;
 	rdsConnection* connection = (rdsConnection*) context;
 
-	frame = (SURFACE_FRAME*) ListDictionary_GetItemValue(connection->FrameList, (void*) (size_t) frameId);
+	freerds_frame_ring_acknowledge(connection->frames, frameId);
+	freerds_estimator_frame_acknowledge(connection->estimator, frameId);
 
-	if (frame)
-	{
-		ListDictionary_Remove(connection->FrameList, (void*) (size_t) frameId);
-		free(frame);
-	}
+	if (connection->connector)
+		freerds_client_inbound_paint_deferred(connection->connector);
 }
 
 void* freerds_connection_main_thread(void* arg)
@@ -425,7 +439,11 @@ void* freerds_connection_main_thread(void* arg)
 
 		if (WaitForSingleObject(ClientEvent, 0) == WAIT_OBJECT_0)
 		{
-			if (client->CheckFileDescriptor(client) != TRUE)
+			freerds_transmit_suspend(connection);
+			status = client->CheckFileDescriptor(client);
+			freerds_transmit_resume(connection);
+
+			if (status != TRUE)
 			{
 				fprintf(stderr, "Failed to check freerdp file descriptor\n");
 				break;
@@ -434,7 +452,11 @@ void* freerds_connection_main_thread(void* arg)
 
 		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
 		{
-			if (WTSVirtualChannelManagerCheckFileDescriptor(connection->vcm) != TRUE)
+			freerds_transmit_suspend(connection);
+			status = WTSVirtualChannelManagerCheckFileDescriptor(connection->vcm);
+			freerds_transmit_resume(connection);
+
+			if (status != TRUE)
 			{
 				fprintf(stderr, "WTSVirtualChannelManagerCheckFileDescriptor failure\n");
 				break;
@@ -458,6 +480,12 @@ void* freerds_connection_main_thread(void* arg)
 
 	fprintf(stderr, "Client %s disconnected.\n", client->hostname);
 
+	if (connection->transmit)
+	{
+		freerds_transmit_free(connection->transmit);
+		connection->transmit = NULL;
+	}
+
 	client->Disconnect(client);
 
 	freerdp_peer_context_free(client);
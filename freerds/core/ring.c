@@ -0,0 +1,229 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server Message Ring
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ring.h"
+#include "arena.h"
+
+/**
+ * The producer owns head and the consumer owns tail. Each side reads the
+ * other's index with a full barrier so that slot contents are published
+ * before the index that makes them visible.
+ */
+
+static UINT32 freerds_message_ring_load(volatile LONG* index)
+{
+	return (UINT32) InterlockedCompareExchange(index, 0, 0);
+}
+
+rdsMessageRing* freerds_message_ring_new(UINT32 size)
+{
+	rdsMessageRing* ring;
+
+	if (!size || (size & (size - 1)))
+	{
+		fprintf(stderr, "%s: ring size %d is not a power of two\n", __FUNCTION__, size);
+		return NULL;
+	}
+
+	ring = (rdsMessageRing*) calloc(1, sizeof(rdsMessageRing));
+
+	if (!ring)
+		return NULL;
+
+	ring->size = size;
+	ring->mask = size - 1;
+	ring->slots = (rdsMessageSlot*) calloc(size, sizeof(rdsMessageSlot));
+	ring->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!ring->slots || !ring->event)
+	{
+		freerds_message_ring_free(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+void freerds_message_ring_free(rdsMessageRing* ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->slots)
+	{
+		while (freerds_message_ring_peek(ring))
+			freerds_message_ring_release(ring);
+
+		free(ring->slots);
+	}
+
+	if (ring->event)
+		CloseHandle(ring->event);
+
+	free(ring);
+}
+
+HANDLE freerds_message_ring_event(rdsMessageRing* ring)
+{
+	return ring->event;
+}
+
+UINT32 freerds_message_ring_count(rdsMessageRing* ring)
+{
+	return freerds_message_ring_load(&ring->head) - freerds_message_ring_load(&ring->tail);
+}
+
+/**
+ * Producer side: returns RDS_MESSAGE_RING_FULL if the ring is full, the caller decides
+ * whether to wait, and RDS_MESSAGE_RING_NO_MEMORY if the payload could not be copied.
+ * Message payloads are copied into the given frame arena, or onto the heap without one.
+ */
+
+int freerds_message_ring_write(rdsMessageRing* ring, RDS_MSG_COMMON* msg, rdsArena* arena)
+{
+	UINT32 size;
+	UINT32 head;
+	rdsMessageSlot* slot;
+
+	head = (UINT32) ring->head;
+
+	if ((head - freerds_message_ring_load(&ring->tail)) >= ring->size)
+		return RDS_MESSAGE_RING_FULL;
+
+	slot = &ring->slots[head & ring->mask];
+	slot->heap = NULL;
+
+	if (!arena && freerds_arena_message_has_payload(msg))
+	{
+		slot->heap = (RDS_MSG_COMMON*) freerds_server_message_copy(msg);
+
+		if (!slot->heap)
+			return RDS_MESSAGE_RING_NO_MEMORY;
+	}
+	else
+	{
+		size = (UINT32) freerds_server_message_size(msg->type);
+
+		if (size > sizeof(RDS_MSG_SERVER_SLOT))
+			size = sizeof(RDS_MSG_SERVER_SLOT);
+
+		CopyMemory(&(slot->msg), msg, size);
+
+		if (arena && freerds_arena_message_has_payload(msg))
+		{
+			if (freerds_arena_copy_message_payload(arena, &(slot->msg.common)) < 0)
+				return RDS_MESSAGE_RING_NO_MEMORY;
+		}
+	}
+
+	InterlockedExchange(&ring->head, (LONG) (head + 1));
+
+	return 0;
+}
+
+/**
+ * Moves the message at the tail of src to the head of dst, keeping its payload.
+ * The src slot still has to be released by the caller.
+ */
+
+int freerds_message_ring_move(rdsMessageRing* dst, rdsMessageRing* src)
+{
+	UINT32 head;
+	rdsMessageSlot* srcSlot;
+	rdsMessageSlot* dstSlot;
+
+	head = (UINT32) dst->head;
+
+	if ((head - freerds_message_ring_load(&dst->tail)) >= dst->size)
+		return RDS_MESSAGE_RING_FULL;
+
+	srcSlot = &src->slots[((UINT32) src->tail) & src->mask];
+	dstSlot = &dst->slots[head & dst->mask];
+
+	CopyMemory(dstSlot, srcSlot, sizeof(rdsMessageSlot));
+	srcSlot->heap = NULL;
+
+	InterlockedExchange(&dst->head, (LONG) (head + 1));
+
+	return 0;
+}
+
+UINT32 freerds_message_ring_head(rdsMessageRing* ring)
+{
+	return (UINT32) ring->head;
+}
+
+UINT32 freerds_message_ring_tail(rdsMessageRing* ring)
+{
+	return (UINT32) ring->tail;
+}
+
+void freerds_message_ring_signal(rdsMessageRing* ring)
+{
+	SetEvent(ring->event);
+}
+
+/**
+ * Consumer side: the returned message stays valid until freerds_message_ring_release.
+ * Writing does not touch the event: producers call freerds_message_ring_signal after
+ * publishing their messages. The event is reset when the ring is found empty and the
+ * head is checked again, so a message published before the reset is still returned,
+ * and one published after it is followed by the producer's signal.
+ */
+
+RDS_MSG_COMMON* freerds_message_ring_peek(rdsMessageRing* ring)
+{
+	UINT32 tail;
+	rdsMessageSlot* slot;
+
+	tail = (UINT32) ring->tail;
+
+	if (tail == freerds_message_ring_load(&ring->head))
+	{
+		ResetEvent(ring->event);
+
+		if (tail == freerds_message_ring_load(&ring->head))
+			return NULL;
+	}
+
+	slot = &ring->slots[tail & ring->mask];
+
+	return (slot->heap) ? slot->heap : &(slot->msg.common);
+}
+
+void freerds_message_ring_release(rdsMessageRing* ring)
+{
+	UINT32 tail;
+	rdsMessageSlot* slot;
+
+	tail = (UINT32) ring->tail;
+	slot = &ring->slots[tail & ring->mask];
+
+	if (slot->heap)
+	{
+		freerds_server_message_free(slot->heap);
+		slot->heap = NULL;
+	}
+
+	InterlockedExchange(&ring->tail, (LONG) (tail + 1));
+}
@@ -0,0 +1,111 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server Message Ring
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_RING_H
+#define RDS_NG_RING_H
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#include <freerds/freerds.h>
+
+#define RDS_MESSAGE_RING_FULL		-1
+#define RDS_MESSAGE_RING_NO_MEMORY	-2
+
+/**
+ * Single-producer, single-consumer ring of server messages.
+ *
+ * Messages are copied inline into fixed-size slots. Out-of-line data (bitmap
+ * data, pointer shapes, credentials, glyph data, window title and rects) goes
+ * into the connector frame arena, or falls back to a heap copy which is
+ * released with the slot. Clipping and the other fixed-size messages have no
+ * out-of-line data: the slot copy is all they own.
+ */
+
+union _RDS_MSG_SERVER_SLOT
+{
+	RDS_MSG_COMMON common;
+	RDS_MSG_BEGIN_UPDATE beginUpdate;
+	RDS_MSG_END_UPDATE endUpdate;
+	RDS_MSG_SET_CLIPPING_REGION setClippingRegion;
+	RDS_MSG_OPAQUE_RECT opaqueRect;
+	RDS_MSG_SCREEN_BLT screenBlt;
+	RDS_MSG_PAINT_RECT paintRect;
+	RDS_MSG_PATBLT patBlt;
+	RDS_MSG_DSTBLT dstBlt;
+	RDS_MSG_LINE_TO lineTo;
+	RDS_MSG_CREATE_OFFSCREEN_SURFACE createOffscreenSurface;
+	RDS_MSG_SWITCH_OFFSCREEN_SURFACE switchOffscreenSurface;
+	RDS_MSG_DELETE_OFFSCREEN_SURFACE deleteOffscreenSurface;
+	RDS_MSG_PAINT_OFFSCREEN_SURFACE paintOffscreenSurface;
+	RDS_MSG_SET_PALETTE setPalette;
+	RDS_MSG_CACHE_GLYPH cacheGlyph;
+	RDS_MSG_GLYPH_INDEX glyphIndex;
+	RDS_MSG_SET_POINTER setPointer;
+	RDS_MSG_SET_SYSTEM_POINTER setSystemPointer;
+	RDS_MSG_SHARED_FRAMEBUFFER sharedFramebuffer;
+	RDS_MSG_BEEP beep;
+	RDS_MSG_RESET reset;
+	RDS_MSG_WINDOW_NEW_UPDATE windowNewUpdate;
+	RDS_MSG_WINDOW_DELETE windowDelete;
+	RDS_MSG_LOGON_USER logonUser;
+	RDS_MSG_LOGOFF_USER logoffUser;
+};
+typedef union _RDS_MSG_SERVER_SLOT RDS_MSG_SERVER_SLOT;
+
+struct rds_message_slot
+{
+	RDS_MSG_COMMON* heap;
+	RDS_MSG_SERVER_SLOT msg;
+};
+typedef struct rds_message_slot rdsMessageSlot;
+
+struct rds_message_ring
+{
+	UINT32 size;
+	UINT32 mask;
+	rdsMessageSlot* slots;
+	HANDLE event;
+
+	/* written by the producer only */
+	volatile LONG head;
+	BYTE pad0[64 - sizeof(LONG)];
+
+	/* written by the consumer only */
+	volatile LONG tail;
+	BYTE pad1[64 - sizeof(LONG)];
+};
+
+rdsMessageRing* freerds_message_ring_new(UINT32 size);
+void freerds_message_ring_free(rdsMessageRing* ring);
+
+HANDLE freerds_message_ring_event(rdsMessageRing* ring);
+UINT32 freerds_message_ring_count(rdsMessageRing* ring);
+UINT32 freerds_message_ring_head(rdsMessageRing* ring);
+UINT32 freerds_message_ring_tail(rdsMessageRing* ring);
+
+int freerds_message_ring_write(rdsMessageRing* ring, RDS_MSG_COMMON* msg, rdsArena* arena);
+int freerds_message_ring_move(rdsMessageRing* dst, rdsMessageRing* src);
+void freerds_message_ring_signal(rdsMessageRing* ring);
+
+RDS_MSG_COMMON* freerds_message_ring_peek(rdsMessageRing* ring);
+void freerds_message_ring_release(rdsMessageRing* ring);
+
+#endif /* RDS_NG_RING_H */
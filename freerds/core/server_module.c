@@ -31,6 +31,71 @@
 #include <sys/stat.h>
 
 #include "freerds.h"
+#include "transmit.h"
+#include "glyph.h"
+#include "bitmap.h"
+#include "offscreen.h"
+#include "color.h"
+#include "classify.h"
+#include "frame.h"
+#include "estimator.h"
+#include "encoder.h"
+#include "capture.h"
+
+/**
+ * In codec mode, every paint between BeginUpdate and EndUpdate
+ * is sent within a single frame, bracketed by frame markers.
+ * The frame is opened by the first paint, so that an update without
+ * any does not use up a frame. The frame rate follows the bandwidth
+ * estimator, while the frame ring withholds new frames as long as the
+ * client has not acknowledged enough of the previous ones.
+ */
+
+static int freerds_client_inbound_frame_begin(rdsModuleConnector* connector)
+{
+	rdsConnection* connection;
+
+	connection = connector->connection;
+
+	if (!connection->codecMode || connection->frameOpen)
+		return 0;
+
+	if (!freerds_frame_ring_credit(connection->frames))
+		return 0;
+
+	connector->fps = freerds_estimator_update(connection->estimator, connector->MaxFps);
+
+	if (connector->fps < 1)
+		connector->fps = 1;
+
+	connection->frameId++;
+
+	freerds_frame_ring_begin(connection->frames, connection->frameId);
+	freerds_estimator_frame_begin(connection->estimator, connection->frameId);
+
+	freerds_orders_send_frame_marker(connection, SURFACECMD_FRAMEACTION_BEGIN, connection->frameId);
+	connection->frameOpen = TRUE;
+
+	return 0;
+}
+
+static int freerds_client_inbound_frame_end(rdsModuleConnector* connector)
+{
+	rdsConnection* connection;
+
+	connection = connector->connection;
+
+	if (!connection->frameOpen)
+		return 0;
+
+	freerds_orders_send_frame_marker(connection, SURFACECMD_FRAMEACTION_END, connection->frameId);
+	connection->frameOpen = FALSE;
+
+	freerds_frame_ring_end(connection->frames);
+	freerds_estimator_frame_end(connection->estimator);
+
+	return 0;
+}
 
 int freerds_client_inbound_begin_update(rdsModuleConnector* connector, RDS_MSG_BEGIN_UPDATE* msg)
 {
@@ -40,6 +105,16 @@ int freerds_client_inbound_begin_update(rdsModuleConnector* connector, RDS_MSG_B
 
 int freerds_client_inbound_end_update(rdsModuleConnector* connector, RDS_MSG_END_UPDATE* msg)
 {
+	rdsConnection* connection = connector->connection;
+
+	if (connection->capture && pixman_region32_not_empty(&connection->captureRegion))
+	{
+		freerds_capture_write(connection->capture, &(connector->framebuffer), &connection->captureRegion);
+		pixman_region32_fini(&connection->captureRegion);
+		pixman_region32_init(&connection->captureRegion);
+	}
+
+	freerds_client_inbound_frame_end(connector);
 	freerds_orders_end_paint(connector->connection);
 	connector->client->VBlankEvent(connector);
 	return 0;
@@ -56,72 +131,793 @@ int freerds_client_inbound_is_terminated(rdsModuleConnector* connector)
 	return g_is_term();
 }
 
+/**
+ * Drawing orders reach the connection thread only when the pipeline
+ * decided they can be replayed by the client (see queue_pack).
+ * Orders outside of an update are sent in a paint of their own.
+ */
+
+static BOOL freerds_client_inbound_order_begin(rdsConnection* connection)
+{
+	if (connection->paintOpen)
+		return FALSE;
+
+	freerds_orders_begin_paint(connection);
+
+	return TRUE;
+}
+
+static void freerds_client_inbound_order_end(rdsConnection* connection, BOOL paintOpened,
+		int x, int y, int width, int height)
+{
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+
+	freerds_shadow_framebuffer_invalidate_rect(connection, x, y, width, height);
+}
+
+static xrdpRect* freerds_client_inbound_order_clip(rdsConnection* connection)
+{
+	return connection->clipEnabled ? &(connection->clipRect) : NULL;
+}
+
 int freerds_client_inbound_opaque_rect(rdsModuleConnector* connector, RDS_MSG_OPAQUE_RECT* msg)
 {
-	/* TODO */
+	BOOL paintOpened;
+	rdsConnection* connection = connector->connection;
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_rect(connection, msg->nLeftRect, msg->nTopRect,
+			msg->nWidth, msg->nHeight, msg->color,
+			freerds_client_inbound_order_clip(connection));
+
+	freerds_client_inbound_order_end(connection, paintOpened,
+			msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
 
 	return 0;
 }
 
 int freerds_client_inbound_screen_blt(rdsModuleConnector* connector, RDS_MSG_SCREEN_BLT* msg)
 {
-	/* TODO */
+	BOOL paintOpened;
+	rdsConnection* connection = connector->connection;
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_screen_blt(connection, msg->nLeftRect, msg->nTopRect,
+			msg->nWidth, msg->nHeight, msg->nXSrc, msg->nYSrc, 0xCC,
+			freerds_client_inbound_order_clip(connection));
+
+	freerds_client_inbound_order_end(connection, paintOpened,
+			msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
 
 	return 0;
 }
 
-int freerds_client_inbound_paint_rect(rdsModuleConnector* connector, RDS_MSG_PAINT_RECT* msg)
+static int freerds_client_inbound_paint_rect_send(rdsModuleConnector* connector, int bpp, RDS_MSG_PAINT_RECT* msg)
+{
+	rdsEncoderSet* encoders;
+	rdsConnection* connection = connector->connection;
+
+	encoders = connection->encoders;
+
+	if (connection->codecMode)
+	{
+		freerds_encoder_encode(encoders, encoders ? encoders->surface : NULL, bpp, msg);
+	}
+	else
+	{
+		freerds_orders_flush(connection);
+		freerds_encoder_encode(encoders, encoders ? encoders->bitmap : NULL, bpp, msg);
+	}
+
+	return 0;
+}
+
+/**
+ * Scrolled or moved content found by the motion detector is copied
+ * by the client from its own screen, ahead of any pending encodes.
+ */
+
+static int freerds_client_inbound_paint_scroll(rdsModuleConnector* connector, RDS_MSG_PAINT_RECT* msg)
+{
+	BOOL paintOpened;
+	rdsConnection* connection;
+	RDS_MSG_SCREEN_BLT screenBlt;
+
+	connection = connector->connection;
+
+	if (!connector->OrderMode || !connection->settings->OrderSupport[NEG_SCRBLT_INDEX])
+		return 0;
+
+	if (!freerds_shadow_framebuffer_motion(connection, msg, &screenBlt))
+		return 0;
+
+	freerds_client_inbound_frame_begin(connector);
+	freerds_transmit_flush(connection);
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_screen_blt(connection, screenBlt.nLeftRect, screenBlt.nTopRect,
+			screenBlt.nWidth, screenBlt.nHeight, screenBlt.nXSrc, screenBlt.nYSrc, 0xCC, NULL);
+
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+	else
+		freerds_orders_flush(connection);
+
+	freerds_shadow_framebuffer_scroll(connection, &screenBlt);
+
+	return 1;
+}
+
+/**
+ * Cached tiles are sent as interleaved bitmaps at the session color depth,
+ * 24bpp for 32bpp sessions, so they are exact. Returns 0 when there is no
+ * interleaved format for the session.
+ */
+
+static int freerds_client_inbound_cache_bpp(rdpSettings* settings)
+{
+	switch (settings->ColorDepth)
+	{
+		case 15:
+			return 15;
+
+		case 16:
+			return 16;
+
+		case 24:
+		case 32:
+			return 24;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+/**
+ * Full 64x64 tiles seen before are replayed from the client bitmap cache
+ * with MemBlt and removed from the region left to encode.
+ */
+
+static int freerds_client_inbound_paint_cached(rdsModuleConnector* connector,
+		RDS_MSG_PAINT_RECT* msg, pixman_region32_t* region)
 {
+	int x, y;
 	int bpp;
-	int inFlightFrames;
-	SURFACE_FRAME* frame;
+	int index;
+	int count;
+	int tileStep;
+	UINT64 key;
+	BOOL cached;
+	BYTE* data;
+	BYTE* tile;
+	BOOL paintOpened;
+	pixman_box32_t box;
+	pixman_region32_t tileRegion;
+	rdsBitmapCache* cache;
+	rdsConnection* connection;
+	RDS_FRAMEBUFFER* framebuffer;
+
+	connection = connector->connection;
+	framebuffer = msg->framebuffer;
+
+	if (!connector->OrderMode || !connection->settings->OrderSupport[NEG_MEMBLT_INDEX])
+		return 0;
+
+	if (framebuffer->fbBytesPerPixel != 4)
+		return 0;
+
+	bpp = freerds_client_inbound_cache_bpp(connection->settings);
+
+	if (!bpp)
+		return 0;
+
+	if (!connection->bitmapCache)
+		connection->bitmapCache = freerds_bitmap_cache_new(connection->settings);
+
+	cache = connection->bitmapCache;
+
+	if (!cache || !cache->numEntries)
+		return 0;
+
+	tileStep = RDS_BITMAP_TILE_SIZE * ((bpp + 7) / 8);
+	tile = (BYTE*) malloc(tileStep * RDS_BITMAP_TILE_SIZE);
+
+	if (!tile)
+		return 0;
+
+	count = 0;
+	paintOpened = FALSE;
+
+	for (y = msg->nTopRect & ~(RDS_BITMAP_TILE_SIZE - 1); y < msg->nTopRect + msg->nHeight; y += RDS_BITMAP_TILE_SIZE)
+	{
+		for (x = msg->nLeftRect & ~(RDS_BITMAP_TILE_SIZE - 1); x < msg->nLeftRect + msg->nWidth; x += RDS_BITMAP_TILE_SIZE)
+		{
+			box.x1 = x;
+			box.y1 = y;
+			box.x2 = x + RDS_BITMAP_TILE_SIZE;
+			box.y2 = y + RDS_BITMAP_TILE_SIZE;
+
+			if ((box.x2 > framebuffer->fbWidth) || (box.y2 > framebuffer->fbHeight))
+				continue;
+
+			if (pixman_region32_contains_rectangle(region, &box) != PIXMAN_REGION_IN)
+				continue;
+
+			data = &framebuffer->fbSharedMemory[(y * framebuffer->fbScanline) + (x * 4)];
+
+			index = freerds_bitmap_cache_get(cache, data, framebuffer->fbScanline, &cached, &key);
+
+			if (index < 0)
+				continue;
+
+			if (!count)
+			{
+				freerds_client_inbound_frame_begin(connector);
+
+				if (connection->codecMode)
+					freerds_transmit_flush(connection);
+
+				paintOpened = freerds_client_inbound_order_begin(connection);
+			}
+
+			if (!cached)
+			{
+				freerds_color_convert(data, framebuffer->fbScanline, tile, tileStep,
+						RDS_BITMAP_TILE_SIZE, RDS_BITMAP_TILE_SIZE, bpp);
+
+				freerds_orders_send_keyed_bitmap2(connection, RDS_BITMAP_TILE_SIZE, RDS_BITMAP_TILE_SIZE, bpp,
+						(char*) tile, cache->cacheId, index, cache->persistent ? key : 0);
+			}
+
+			freerds_orders_mem_blt(connection, cache->cacheId, 0, x, y,
+					RDS_BITMAP_TILE_SIZE, RDS_BITMAP_TILE_SIZE, 0xCC, 0, 0, index, NULL);
+
+			pixman_region32_init_rect(&tileRegion, x, y, RDS_BITMAP_TILE_SIZE, RDS_BITMAP_TILE_SIZE);
+			pixman_region32_subtract(region, region, &tileRegion);
+			pixman_region32_fini(&tileRegion);
+
+			count++;
+		}
+	}
+
+	free(tile);
+
+	if (!count)
+		return 0;
+
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+	else
+		freerds_orders_flush(connection);
+
+	return count;
+}
+
+/**
+ * The tiles left to encode are classified by content. Solid fills become
+ * OpaqueRect orders and, in codec mode, text and UI tiles are sent through
+ * the lossless bitmap encoder, leaving photographic content to the codec.
+ */
+
+static int freerds_client_inbound_paint_classified(rdsModuleConnector* connector,
+		RDS_MSG_PAINT_RECT* msg, pixman_region32_t* region)
+{
+	int x, y;
+	int type;
+	int index;
+	int count;
+	int solids;
+	UINT32 color;
+	BYTE* data;
+	BOOL lossless;
+	BOOL solidFill;
+	BOOL paintOpened;
+	pixman_box32_t box;
+	pixman_box32_t* boxes;
+	pixman_region32_t subRegion;
+	pixman_region32_t textRegion;
+	RDS_MSG_PAINT_RECT subMsg;
+	rdsEncoderSet* encoders;
 	rdsConnection* connection;
 	rdpSettings* settings;
+	RDS_FRAMEBUFFER* framebuffer;
 
 	connection = connector->connection;
 	settings = connection->settings;
+	framebuffer = msg->framebuffer;
 
-	bpp = msg->framebuffer->fbBitsPerPixel;
+	if (framebuffer->fbBytesPerPixel != 4)
+		return 0;
 
-	if (connection->codecMode)
+	solidFill = (connector->OrderMode && settings->OrderSupport[NEG_OPAQUE_RECT_INDEX] &&
+			(settings->ColorDepth > 8)) ? TRUE : FALSE;
+	lossless = connection->codecMode;
+
+	if (!solidFill && !lossless)
+		return 0;
+
+	solids = 0;
+	paintOpened = FALSE;
+	pixman_region32_init(&textRegion);
+
+	for (y = msg->nTopRect & ~(RDS_BITMAP_TILE_SIZE - 1); y < msg->nTopRect + msg->nHeight; y += RDS_BITMAP_TILE_SIZE)
+	{
+		for (x = msg->nLeftRect & ~(RDS_BITMAP_TILE_SIZE - 1); x < msg->nLeftRect + msg->nWidth; x += RDS_BITMAP_TILE_SIZE)
+		{
+			box.x1 = MAX(x, msg->nLeftRect);
+			box.y1 = MAX(y, msg->nTopRect);
+			box.x2 = MIN(MIN(x + RDS_BITMAP_TILE_SIZE, msg->nLeftRect + msg->nWidth), framebuffer->fbWidth);
+			box.y2 = MIN(MIN(y + RDS_BITMAP_TILE_SIZE, msg->nTopRect + msg->nHeight), framebuffer->fbHeight);
+
+			if ((box.x2 <= box.x1) || (box.y2 <= box.y1))
+				continue;
+
+			if (pixman_region32_contains_rectangle(region, &box) != PIXMAN_REGION_IN)
+				continue;
+
+			data = &framebuffer->fbSharedMemory[(box.y1 * framebuffer->fbScanline) + (box.x1 * 4)];
+
+			type = freerds_tile_classify(data, framebuffer->fbScanline,
+					box.x2 - box.x1, box.y2 - box.y1, &color);
+
+			if ((type == RDS_TILE_SOLID) && solidFill)
+			{
+				if (!solids)
+				{
+					freerds_client_inbound_frame_begin(connector);
+
+					if (connection->codecMode)
+						freerds_transmit_flush(connection);
+
+					paintOpened = freerds_client_inbound_order_begin(connection);
+				}
+
+				freerds_orders_rect(connection, box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1,
+						freerds_color_pixel(color, settings->ColorDepth), NULL);
+
+				solids++;
+			}
+			else if ((type != RDS_TILE_PHOTO) && lossless)
+			{
+				pixman_region32_union_rect(&textRegion, &textRegion,
+						box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+			}
+			else
+			{
+				continue;
+			}
+
+			pixman_region32_init_rect(&subRegion, box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+			pixman_region32_subtract(region, region, &subRegion);
+			pixman_region32_fini(&subRegion);
+		}
+	}
+
+	if (solids)
 	{
-		inFlightFrames = ListDictionary_Count(connection->FrameList);
+		connection->ordersPending = TRUE;
 
-		if (inFlightFrames > settings->FrameAcknowledge)
-			connector->fps = (100 / (inFlightFrames + 1) * connector->MaxFps) / 100;
+		if (paintOpened)
+			freerds_orders_end_paint(connection);
 		else
-			connector->fps = connector->MaxFps;
+			freerds_orders_flush(connection);
+	}
+
+	boxes = pixman_region32_rectangles(&textRegion, &count);
+	encoders = connection->encoders;
+
+	if (count > 0)
+	{
+		freerds_client_inbound_frame_begin(connector);
+
+		freerds_encoder_flush(encoders, encoders ? encoders->surface : NULL);
+		freerds_orders_flush(connection);
+
+		for (index = 0; index < count; index++)
+		{
+			CopyMemory(&subMsg, msg, sizeof(RDS_MSG_PAINT_RECT));
+
+			subMsg.nLeftRect = boxes[index].x1;
+			subMsg.nTopRect = boxes[index].y1;
+			subMsg.nWidth = boxes[index].x2 - boxes[index].x1;
+			subMsg.nHeight = boxes[index].y2 - boxes[index].y1;
+
+			freerds_encoder_encode(encoders, encoders ? encoders->bitmap : NULL,
+					framebuffer->fbBitsPerPixel, &subMsg);
+		}
+	}
+
+	pixman_region32_fini(&textRegion);
+
+	return solids + count;
+}
+
+/**
+ * Offscreen surfaces are only used with primary drawing orders, since their
+ * content is uploaded and replayed with MemBlt.
+ */
+
+static BOOL freerds_client_inbound_offscreen_supported(rdsModuleConnector* connector)
+{
+	rdsConnection* connection = connector->connection;
+	rdpSettings* settings = connection->settings;
+
+	if (!connector->OrderMode || connection->codecMode)
+		return FALSE;
+
+	return (settings->OffscreenSupportLevel && settings->OrderSupport[NEG_MEMBLT_INDEX]) ? TRUE : FALSE;
+}
+
+static void freerds_client_inbound_offscreen_select(rdsConnection* connection, UINT32 id)
+{
+	BOOL paintOpened;
+	rdsOffscreenCache* cache = connection->offscreenCache;
+
+	if (!cache || (cache->current == id))
+		return;
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_send_switch_os_surface(connection, id);
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+
+	cache->current = id;
+}
+
+/**
+ * Uploads pixels sent inline by the X server into the selected offscreen
+ * surface, one tile at a time through the bitmap cache scratch slot, at the
+ * same color depth as cached tiles.
+ */
+
+static int freerds_client_inbound_paint_offscreen_data(rdsModuleConnector* connector, RDS_MSG_PAINT_RECT* msg)
+{
+	int x, y;
+	int cx, cy;
+	int bpp;
+	int width;
+	int tileStep;
+	BYTE* tile;
+	BOOL paintOpened;
+	rdsBitmapCache* bitmapCache;
+	rdsOffscreenCache* cache;
+	rdsConnection* connection;
+
+	connection = connector->connection;
+	cache = connection->offscreenCache;
+	bitmapCache = connection->bitmapCache;
+
+	if (!cache || !bitmapCache || (bitmapCache->scratchIndex < 0))
+		return 0;
+
+	if (!freerds_offscreen_cache_valid(cache, cache->target))
+		return 0;
+
+	if (msg->bitmapDataLength < (UINT32) (msg->nWidth * msg->nHeight * 4))
+		return 0;
+
+	bpp = freerds_client_inbound_cache_bpp(connection->settings);
+
+	if (!bpp)
+		return 0;
+
+	tile = (BYTE*) malloc(RDS_BITMAP_TILE_SIZE * RDS_BITMAP_TILE_SIZE * ((bpp + 7) / 8));
 
-		if (connector->fps < 1)
-			connector->fps = 1;
+	if (!tile)
+		return 0;
+
+	freerds_client_inbound_offscreen_select(connection, cache->target);
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	for (y = 0; y < msg->nHeight; y += RDS_BITMAP_TILE_SIZE)
+	{
+		for (x = 0; x < msg->nWidth; x += RDS_BITMAP_TILE_SIZE)
+		{
+			cx = MIN(RDS_BITMAP_TILE_SIZE, msg->nWidth - x);
+			cy = MIN(RDS_BITMAP_TILE_SIZE, msg->nHeight - y);
+
+			/* pixels past the right edge are left black and are not blitted */
+
+			width = (cx + 3) & ~3;
+			tileStep = width * ((bpp + 7) / 8);
+
+			if (width != cx)
+				ZeroMemory(tile, tileStep * cy);
 
-		frame = (SURFACE_FRAME*) malloc(sizeof(SURFACE_FRAME));
+			freerds_color_convert(&msg->bitmapData[(y * msg->nWidth * 4) + (x * 4)], msg->nWidth * 4,
+					tile, tileStep, cx, cy, bpp);
 
-		frame->frameId = ++connection->frameId;
-		ListDictionary_Add(connection->FrameList, (void*) (size_t) frame->frameId, frame);
+			freerds_orders_send_bitmap2(connection, width, cy, bpp, (char*) tile,
+					bitmapCache->cacheId, bitmapCache->scratchIndex, 0);
 
-		freerds_orders_send_frame_marker(connection, SURFACECMD_FRAMEACTION_BEGIN, frame->frameId);
-		freerds_send_surface_bits(connection, bpp, msg);
-		freerds_orders_send_frame_marker(connection, SURFACECMD_FRAMEACTION_END, frame->frameId);
+			freerds_orders_mem_blt(connection, bitmapCache->cacheId, 0, msg->nLeftRect + x, msg->nTopRect + y,
+					cx, cy, 0xCC, 0, 0, bitmapCache->scratchIndex, NULL);
+		}
+	}
+
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+
+	free(tile);
+
+	return 0;
+}
+
+/**
+ * While the link is congested, the content left for the codec is deferred
+ * for a few frames, so that a video does not hold back everything else.
+ * Deferred content is sent along with the next paint once over.
+ *
+ * Content is also withheld, for as long as needed, while the frame ring is
+ * out of credit. It accumulates in the same region and is sent from the
+ * framebuffer, that is in its latest state, once an acknowledgement returns.
+ *
+ * The shadow framebuffer already holds deferred content, so the motion
+ * detector refuses to copy from the deferred region.
+ */
+
+static void freerds_client_inbound_paint_defer(rdsModuleConnector* connector, pixman_region32_t* region)
+{
+	rdsEstimator* estimator;
+	rdsConnection* connection;
+
+	connection = connector->connection;
+	estimator = connection->estimator;
+
+	if (!connection->frameOpen && !freerds_frame_ring_credit(connection->frames))
+	{
+		pixman_region32_union(&connection->deferredRegion, &connection->deferredRegion, region);
+		pixman_region32_fini(region);
+		pixman_region32_init(region);
+		return;
+	}
+
+	if (!estimator)
+		return;
+
+	if (estimator->defer && (estimator->deferredFrames < RDS_ESTIMATOR_DEFER_FRAMES))
+	{
+		if (!pixman_region32_not_empty(region))
+			return;
+
+		pixman_region32_union(&connection->deferredRegion, &connection->deferredRegion, region);
+		pixman_region32_fini(region);
+		pixman_region32_init(region);
+
+		estimator->deferredFrames++;
+	}
+	else if (pixman_region32_not_empty(&connection->deferredRegion))
+	{
+		pixman_region32_union(region, region, &connection->deferredRegion);
+		pixman_region32_fini(&connection->deferredRegion);
+		pixman_region32_init(&connection->deferredRegion);
+
+		estimator->deferredFrames = 0;
+	}
+}
+
+static int freerds_client_inbound_paint_region(rdsModuleConnector* connector, int bpp,
+		RDS_MSG_PAINT_RECT* msg, pixman_region32_t* region)
+{
+	int index;
+	int count;
+	pixman_box32_t* boxes;
+	RDS_MSG_PAINT_RECT subMsg;
+
+	boxes = pixman_region32_rectangles(region, &count);
+
+	for (index = 0; index < count; index++)
+	{
+		freerds_frame_ring_add(connector->connection->frames, 0,
+				(boxes[index].x2 - boxes[index].x1) * (boxes[index].y2 - boxes[index].y1));
+	}
+
+	if ((count == 1) && (boxes[0].x1 == msg->nLeftRect) && (boxes[0].y1 == msg->nTopRect) &&
+			(boxes[0].x2 == msg->nLeftRect + msg->nWidth) && (boxes[0].y2 == msg->nTopRect + msg->nHeight))
+	{
+		freerds_client_inbound_paint_rect_send(connector, bpp, msg);
+		return 1;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		CopyMemory(&subMsg, msg, sizeof(RDS_MSG_PAINT_RECT));
+
+		subMsg.nLeftRect = boxes[index].x1;
+		subMsg.nTopRect = boxes[index].y1;
+		subMsg.nWidth = boxes[index].x2 - boxes[index].x1;
+		subMsg.nHeight = boxes[index].y2 - boxes[index].y1;
+
+		freerds_client_inbound_paint_rect_send(connector, bpp, &subMsg);
+	}
+
+	return count;
+}
+
+int freerds_client_inbound_paint_rect(rdsModuleConnector* connector, RDS_MSG_PAINT_RECT* msg)
+{
+	int bpp;
+	BOOL withheld;
+	BOOL frameOpen;
+	rdsConnection* connection;
+	pixman_region32_t region;
+
+	connection = connector->connection;
+
+	if (!msg->fbSegmentId && msg->bitmapData)
+	{
+		/* inline pixels are only sent to fill offscreen surfaces */
+
+		if (connection->offscreenCache && (connection->offscreenCache->target != RDS_OFFSCREEN_PRIMARY))
+			return freerds_client_inbound_paint_offscreen_data(connector, msg);
+
+		return 0;
+	}
+
+	freerds_client_inbound_offscreen_select(connection, RDS_OFFSCREEN_PRIMARY);
+
+	bpp = msg->framebuffer->fbBitsPerPixel;
+
+	pixman_region32_init(&region);
+
+	if (connection->capture && msg->fbSegmentId)
+	{
+		pixman_region32_union_rect(&connection->captureRegion, &connection->captureRegion,
+				msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
+	}
+
+	/* out of credit, nothing is sent: the shadow diff records the damage and paint_defer withholds it */
+
+	frameOpen = connection->frameOpen;
+	withheld = connection->codecMode && !frameOpen && !freerds_frame_ring_credit(connection->frames);
+
+	if (msg->fbSegmentId && connector->framebuffer.fbAttached)
+	{
+		if (!withheld)
+			freerds_client_inbound_paint_scroll(connector, msg);
+
+		freerds_shadow_framebuffer_diff(connection, msg, &region);
+
+		if (!withheld)
+		{
+			freerds_client_inbound_paint_cached(connector, msg, &region);
+			freerds_client_inbound_paint_classified(connector, msg, &region);
+		}
 	}
 	else
 	{
-		freerds_send_bitmap_update(connection, bpp, msg);
+		pixman_region32_union_rect(&region, &region,
+				msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
+	}
+
+	if (connection->codecMode)
+		freerds_client_inbound_paint_defer(connector, &region);
+
+	if (pixman_region32_not_empty(&region))
+	{
+		freerds_client_inbound_frame_begin(connector);
+		freerds_client_inbound_paint_region(connector, bpp, msg, &region);
 	}
 
+	/* within an update, the frame stays open until EndUpdate */
+
+	if (!frameOpen && !connection->paintOpen)
+		freerds_client_inbound_frame_end(connector);
+
+	pixman_region32_fini(&region);
+
 	return 0;
 }
 
+/**
+ * Sends the content deferred during congestion once the estimator no longer
+ * asks for it, which can happen on a frame acknowledgement without any paint.
+ */
+
+int freerds_client_inbound_paint_deferred(rdsModuleConnector* connector)
+{
+	pixman_box32_t* extents;
+	rdsConnection* connection;
+	RDS_MSG_PAINT_RECT msg;
+
+	connection = connector->connection;
+
+	if (!connection || connection->frameOpen || !connector->framebuffer.fbAttached)
+		return 0;
+
+	if (!pixman_region32_not_empty(&connection->deferredRegion))
+		return 0;
+
+	if (connection->estimator && connection->estimator->defer)
+		return 0;
+
+	if (!freerds_frame_ring_credit(connection->frames))
+		return 0;
+
+	extents = pixman_region32_extents(&connection->deferredRegion);
+
+	ZeroMemory(&msg, sizeof(RDS_MSG_PAINT_RECT));
+
+	msg.type = RDS_SERVER_PAINT_RECT;
+	msg.framebuffer = &(connector->framebuffer);
+	msg.fbSegmentId = connector->framebuffer.fbSegmentId;
+	msg.nLeftRect = extents->x1;
+	msg.nTopRect = extents->y1;
+	msg.nWidth = extents->x2 - extents->x1;
+	msg.nHeight = extents->y2 - extents->y1;
+
+	if (connection->estimator)
+		connection->estimator->deferredFrames = 0;
+
+	freerds_client_inbound_frame_begin(connector);
+
+	freerds_client_inbound_paint_region(connector, msg.framebuffer->fbBitsPerPixel,
+			&msg, &connection->deferredRegion);
+
+	freerds_client_inbound_frame_end(connector);
+
+	pixman_region32_fini(&connection->deferredRegion);
+	pixman_region32_init(&connection->deferredRegion);
+
+	return 1;
+}
+
 int freerds_client_inbound_patblt(rdsModuleConnector* connector, RDS_MSG_PATBLT* msg)
 {
-	/* TODO */
+	BOOL paintOpened;
+	xrdpBrush brush;
+	rdsConnection* connection = connector->connection;
+
+	brush.x_orgin = msg->brush.x;
+	brush.y_orgin = msg->brush.y;
+	brush.style = msg->brush.style;
+	CopyMemory(brush.pattern, msg->brush.p8x8, 8);
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	/* freerds_orders_pat_blt takes the colors swapped */
+
+	freerds_orders_pat_blt(connection, msg->nLeftRect, msg->nTopRect,
+			msg->nWidth, msg->nHeight, msg->bRop, msg->foreColor, msg->backColor,
+			&brush, freerds_client_inbound_order_clip(connection));
+
+	freerds_client_inbound_order_end(connection, paintOpened,
+			msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
 
 	return 0;
 }
 
 int freerds_client_inbound_dstblt(rdsModuleConnector* connector, RDS_MSG_DSTBLT* msg)
 {
-	/* TODO */
+	BOOL paintOpened;
+	rdsConnection* connection = connector->connection;
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_dest_blt(connection, msg->nLeftRect, msg->nTopRect,
+			msg->nWidth, msg->nHeight, msg->bRop,
+			freerds_client_inbound_order_clip(connection));
+
+	freerds_client_inbound_order_end(connection, paintOpened,
+			msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
 
 	return 0;
 }
@@ -147,7 +943,14 @@ int freerds_client_inbound_set_palette(rdsModuleConnector* connector, RDS_MSG_SE
 
 int freerds_client_inbound_set_clipping_region(rdsModuleConnector* connector, RDS_MSG_SET_CLIPPING_REGION* msg)
 {
-	/* TODO */
+	rdsConnection* connection = connector->connection;
+
+	connection->clipEnabled = msg->bNullRegion ? FALSE : TRUE;
+
+	connection->clipRect.left = msg->nLeftRect;
+	connection->clipRect.top = msg->nTopRect;
+	connection->clipRect.right = msg->nLeftRect + msg->nWidth;
+	connection->clipRect.bottom = msg->nTopRect + msg->nHeight;
 
 	return 0;
 }
@@ -164,9 +967,171 @@ int freerds_client_inbound_cache_glyph(rdsModuleConnector* connector, RDS_MSG_CA
 	return freerds_orders_send_font(connector->connection, msg);
 }
 
+/**
+ * Maps the glyphs carried by a GlyphIndex message to client glyph cache
+ * entries, sending the ones the client does not have yet, and rewrites
+ * the glyph fragment with the client cache indices.
+ */
+
+static int freerds_client_inbound_glyph_resolve(rdsConnection* connection, RDS_MSG_GLYPH_INDEX* msg, BYTE* fragment)
+{
+	int cacheId;
+	int cacheIndex;
+	BOOL cached;
+	UINT32 index;
+	UINT32 offset;
+	UINT32 cellSize;
+	BYTE* ptr;
+	BYTE* end;
+	rdsGlyphCache* cache;
+	RDS_GLYPH_DATA glyph;
+	RDS_MSG_CACHE_GLYPH cacheGlyph;
+	RDS_GLYPH_DATA glyphs[256];
+	BYTE indices[256];
+
+	if ((msg->cGlyphs > RDS_GLYPH_CACHE_MAX_ENTRIES) || (msg->cbData > 255))
+		return -1;
+
+	if (!connection->glyphCache)
+		connection->glyphCache = freerds_glyph_cache_new(connection->settings);
+
+	cache = connection->glyphCache;
+
+	if (!cache)
+		return -1;
+
+	cellSize = 0;
+	ptr = msg->glyphs;
+	end = msg->glyphs + msg->cbGlyphs;
+
+	for (index = 0; index < msg->cGlyphs; index++)
+	{
+		if ((end - ptr) < 8)
+			break;
+
+		glyphs[index].x = (INT16) (ptr[0] | (ptr[1] << 8));
+		glyphs[index].y = (INT16) (ptr[2] | (ptr[3] << 8));
+		glyphs[index].cx = ptr[4] | (ptr[5] << 8);
+		glyphs[index].cy = ptr[6] | (ptr[7] << 8);
+		ptr += 8;
+
+		glyphs[index].cb = ((glyphs[index].cx + 7) / 8) * glyphs[index].cy;
+		glyphs[index].aj = ptr;
+
+		if (!glyphs[index].cb || ((UINT32) (end - ptr) < glyphs[index].cb))
+			break;
+
+		ptr += glyphs[index].cb;
+
+		cellSize = MAX(cellSize, freerds_glyph_cell_size(glyphs[index].cx, glyphs[index].cy));
+	}
+
+	if (index < msg->cGlyphs)
+		return -1;
+
+	cacheId = freerds_glyph_cache_select(cache, cellSize, msg->cGlyphs);
+
+	if (cacheId < 0)
+		return -1;
+
+	freerds_glyph_cache_begin(cache);
+
+	for (index = 0; index < msg->cGlyphs; index++)
+	{
+		cacheIndex = freerds_glyph_cache_get(cache, cacheId, &glyphs[index], &cached);
+
+		if (cacheIndex < 0)
+			return -1;
+
+		indices[index] = (BYTE) cacheIndex;
+
+		if (cached)
+			continue;
+
+		CopyMemory(&glyph, &glyphs[index], sizeof(RDS_GLYPH_DATA));
+		glyph.cacheIndex = cacheIndex;
+		glyph.aj = cache->tables[cacheId].entries[cacheIndex].aj;
+
+		ZeroMemory(&cacheGlyph, sizeof(RDS_MSG_CACHE_GLYPH));
+		cacheGlyph.cacheId = cacheId;
+		cacheGlyph.cGlyphs = 1;
+		cacheGlyph.glyphData = &glyph;
+
+		freerds_orders_send_font(connection, &cacheGlyph);
+	}
+
+	/* each glyph index may be followed by a one or three byte delta */
+
+	for (offset = 0; offset < msg->cbData; )
+	{
+		if (msg->data[offset] >= msg->cGlyphs)
+			return -1;
+
+		fragment[offset] = indices[msg->data[offset]];
+		offset++;
+
+		if (!msg->ulCharInc && !(msg->flAccel & SO_CHAR_INC_EQUAL_BM_BASE) && (offset < msg->cbData))
+		{
+			if (msg->data[offset] & 0x80)
+			{
+				if (offset + 3 > msg->cbData)
+					return -1;
+
+				CopyMemory(&fragment[offset], &msg->data[offset], 3);
+				offset += 3;
+			}
+			else
+			{
+				fragment[offset] = msg->data[offset];
+				offset++;
+			}
+		}
+	}
+
+	msg->cacheId = cacheId;
+	msg->data = fragment;
+
+	return 0;
+}
+
 int freerds_client_inbound_glyph_index(rdsModuleConnector* connector, RDS_MSG_GLYPH_INDEX* msg)
 {
-	/* TODO */
+	BOOL paintOpened;
+	BYTE fragment[256];
+	RDS_MSG_GLYPH_INDEX glyphIndex;
+	RDS_MSG_PAINT_RECT paintRect;
+	rdsConnection* connection = connector->connection;
+
+	CopyMemory(&glyphIndex, msg, sizeof(RDS_MSG_GLYPH_INDEX));
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	if (msg->cGlyphs && (freerds_client_inbound_glyph_resolve(connection, &glyphIndex, fragment) < 0))
+	{
+		/* the glyphs do not fit the client caches: send the text area from the framebuffer */
+
+		if (paintOpened)
+			freerds_orders_end_paint(connection);
+
+		if (!connector->framebuffer.fbAttached)
+			return 0;
+
+		ZeroMemory(&paintRect, sizeof(RDS_MSG_PAINT_RECT));
+		paintRect.type = RDS_SERVER_PAINT_RECT;
+		paintRect.framebuffer = &(connector->framebuffer);
+		paintRect.fbSegmentId = connector->framebuffer.fbSegmentId;
+		paintRect.nLeftRect = msg->bkLeft;
+		paintRect.nTopRect = msg->bkTop;
+		paintRect.nWidth = msg->bkRight - msg->bkLeft;
+		paintRect.nHeight = msg->bkBottom - msg->bkTop;
+
+		return freerds_client_inbound_paint_rect(connector, &paintRect);
+	}
+
+	freerds_orders_text(connection, &glyphIndex, freerds_client_inbound_order_clip(connection));
+
+	freerds_client_inbound_order_end(connection, paintOpened, msg->bkLeft, msg->bkTop,
+			msg->bkRight - msg->bkLeft, msg->bkBottom - msg->bkTop);
 
 	return 0;
 }
@@ -188,6 +1153,8 @@ int freerds_client_inbound_shared_framebuffer(rdsModuleConnector* connector, RDS
 		connector->framebuffer.fbSharedMemory = (BYTE*) shmat(connector->framebuffer.fbSegmentId, 0, 0);
 		connector->framebuffer.fbAttached = TRUE;
 
+		freerds_shadow_framebuffer_invalidate(connector->connection);
+
 		printf("attached segment %d to %p\n",
 				connector->framebuffer.fbSegmentId, connector->framebuffer.fbSharedMemory);
 
@@ -218,22 +1185,115 @@ int freerds_client_inbound_reset(rdsModuleConnector* connector, RDS_MSG_RESET* m
 
 int freerds_client_inbound_create_offscreen_surface(rdsModuleConnector* connector, RDS_MSG_CREATE_OFFSCREEN_SURFACE* msg)
 {
+	BOOL paintOpened;
+	rdsConnection* connection;
+	CREATE_OFFSCREEN_BITMAP_ORDER createOffscreenBitmap;
+
+	connection = connector->connection;
+
+	if (!freerds_client_inbound_offscreen_supported(connector))
+		return 0;
+
+	if (!connection->bitmapCache)
+		connection->bitmapCache = freerds_bitmap_cache_new(connection->settings);
+
+	if (!connection->offscreenCache)
+		connection->offscreenCache = freerds_offscreen_cache_new(connection->settings);
+
+	if (!connection->bitmapCache || !connection->offscreenCache)
+		return 0;
+
+	if (connection->bitmapCache->scratchIndex < 0)
+		return 0;
+
+	/* without a format to upload its content in, the surface is never created */
+
+	if (!freerds_client_inbound_cache_bpp(connection->settings))
+		return 0;
+
+	if (!freerds_offscreen_cache_create(connection->offscreenCache, msg->cacheIndex,
+			msg->nWidth, msg->nHeight, &createOffscreenBitmap))
+		return 0;
+
+	paintOpened = freerds_client_inbound_order_begin(connection);
+
+	freerds_orders_send_create_os_surface(connection, &createOffscreenBitmap);
+	connection->ordersPending = TRUE;
+
+	if (paintOpened)
+		freerds_orders_end_paint(connection);
+
 	return 0;
 }
 
 int freerds_client_inbound_switch_offscreen_surface(rdsModuleConnector* connector, RDS_MSG_SWITCH_OFFSCREEN_SURFACE* msg)
 {
+	rdsOffscreenCache* cache = connector->connection->offscreenCache;
+
+	if (!cache)
+		return 0;
+
+	/* surfaces are selected lazily when drawn to, the screen right away */
+
+	cache->target = msg->cacheIndex;
+
+	if (cache->target == RDS_OFFSCREEN_PRIMARY)
+		freerds_client_inbound_offscreen_select(connector->connection, RDS_OFFSCREEN_PRIMARY);
+
 	return 0;
 }
 
 int freerds_client_inbound_delete_offscreen_surface(rdsModuleConnector* connector, RDS_MSG_DELETE_OFFSCREEN_SURFACE* msg)
 {
+	rdsOffscreenCache* cache = connector->connection->offscreenCache;
+
+	if (cache)
+		freerds_offscreen_cache_delete(cache, msg->cacheIndex);
+
 	return 0;
 }
 
 int freerds_client_inbound_paint_offscreen_surface(rdsModuleConnector* connector, RDS_MSG_PAINT_OFFSCREEN_SURFACE* msg)
 {
-	return 0;
+	BOOL paintOpened;
+	rdsOffscreenCache* cache;
+	RDS_MSG_PAINT_RECT paintRect;
+	rdsConnection* connection = connector->connection;
+
+	cache = connection->offscreenCache;
+
+	if (cache && freerds_client_inbound_offscreen_supported(connector) &&
+			freerds_offscreen_cache_valid(cache, msg->cacheIndex))
+	{
+		freerds_client_inbound_offscreen_select(connection, RDS_OFFSCREEN_PRIMARY);
+
+		paintOpened = freerds_client_inbound_order_begin(connection);
+
+		freerds_orders_mem_blt(connection, 0xFF, 0, msg->nLeftRect, msg->nTopRect,
+				msg->nWidth, msg->nHeight, msg->bRop, msg->nXSrc, msg->nYSrc, msg->cacheIndex,
+				freerds_client_inbound_order_clip(connection));
+
+		freerds_client_inbound_order_end(connection, paintOpened,
+				msg->nLeftRect, msg->nTopRect, msg->nWidth, msg->nHeight);
+
+		return 0;
+	}
+
+	/* the surface was never created on the client: send the area from the framebuffer */
+
+	if (!connector->framebuffer.fbAttached)
+		return 0;
+
+	ZeroMemory(&paintRect, sizeof(RDS_MSG_PAINT_RECT));
+	paintRect.type = RDS_SERVER_PAINT_RECT;
+	paintRect.framebuffer = &(connector->framebuffer);
+	paintRect.fbSegmentId = connector->framebuffer.fbSegmentId;
+	paintRect.nLeftRect = msg->nLeftRect;
+	paintRect.nTopRect = msg->nTopRect;
+	paintRect.nWidth = msg->nWidth;
+	paintRect.nHeight = msg->nHeight;
+
+	return freerds_client_inbound_paint_rect(connector, &paintRect);
 }
 
 int freerds_client_inbound_window_new_update(rdsModuleConnector* connector, RDS_MSG_WINDOW_NEW_UPDATE* msg)
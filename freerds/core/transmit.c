@@ -0,0 +1,234 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Transmit Stage
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include "transmit.h"
+#include "frame.h"
+#include "estimator.h"
+
+static void* freerds_transmit_thread(void* arg)
+{
+	DWORD nCount;
+	HANDLE events[2];
+	rdsTransmitItem* item;
+	rdsTransmitQueue* transmit = (rdsTransmitQueue*) arg;
+	rdsConnection* connection = transmit->connection;
+	rdpUpdate* update = ((rdpContext*) connection)->update;
+
+	nCount = 0;
+	events[nCount++] = transmit->StopEvent;
+	events[nCount++] = transmit->UsedSlots;
+
+	while (WaitForMultipleObjects(nCount, events, FALSE, INFINITE) == (WAIT_OBJECT_0 + 1))
+	{
+		item = &transmit->items[transmit->tail % RDS_TRANSMIT_QUEUE_SIZE];
+
+		if (item->type == RDS_TRANSMIT_SURFACE_BITS)
+		{
+			IFCALL(update->SurfaceBits, update->context, &item->cmd);
+		}
+		else if (item->type == RDS_TRANSMIT_FRAME_MARKER)
+		{
+			IFCALL(update->SurfaceFrameMarker, update->context, &item->marker);
+		}
+
+		transmit->tail++;
+
+		InterlockedDecrement(&transmit->pending);
+		SetEvent(transmit->ProgressEvent);
+
+		ReleaseSemaphore(transmit->FreeSlots, 1, NULL);
+	}
+
+	return NULL;
+}
+
+rdsTransmitQueue* freerds_transmit_new(rdsConnection* connection)
+{
+	int index;
+	rdsTransmitQueue* transmit;
+
+	transmit = (rdsTransmitQueue*) calloc(1, sizeof(rdsTransmitQueue));
+
+	if (!transmit)
+		return NULL;
+
+	transmit->connection = connection;
+
+	for (index = 0; index < RDS_TRANSMIT_QUEUE_SIZE; index++)
+		transmit->items[index].s = Stream_New(NULL, 16384);
+
+	transmit->StopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	transmit->ProgressEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	transmit->FreeSlots = CreateSemaphore(NULL, RDS_TRANSMIT_QUEUE_SIZE, RDS_TRANSMIT_QUEUE_SIZE, NULL);
+	transmit->UsedSlots = CreateSemaphore(NULL, 0, RDS_TRANSMIT_QUEUE_SIZE, NULL);
+
+	transmit->Thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) freerds_transmit_thread,
+			(void*) transmit, 0, NULL);
+
+	return transmit;
+}
+
+void freerds_transmit_free(rdsTransmitQueue* transmit)
+{
+	int index;
+
+	if (!transmit)
+		return;
+
+	freerds_transmit_flush(transmit->connection);
+
+	SetEvent(transmit->StopEvent);
+	WaitForSingleObject(transmit->Thread, INFINITE);
+	CloseHandle(transmit->Thread);
+
+	CloseHandle(transmit->StopEvent);
+	CloseHandle(transmit->ProgressEvent);
+	CloseHandle(transmit->FreeSlots);
+	CloseHandle(transmit->UsedSlots);
+
+	for (index = 0; index < RDS_TRANSMIT_QUEUE_SIZE; index++)
+		Stream_Free(transmit->items[index].s, TRUE);
+
+	free(transmit);
+}
+
+/**
+ * Returns the stream to encode the next SurfaceBits into: the stream of the
+ * next transmit slot, waiting for one to be free, or s without a transmit stage.
+ */
+
+wStream* freerds_transmit_acquire(rdsConnection* connection, wStream* s)
+{
+	rdsTransmitQueue* transmit = connection->transmit;
+
+	if (!transmit)
+		return s;
+
+	WaitForSingleObject(transmit->FreeSlots, INFINITE);
+	ReleaseSemaphore(transmit->FreeSlots, 1, NULL);
+
+	return transmit->items[transmit->head % RDS_TRANSMIT_QUEUE_SIZE].s;
+}
+
+static rdsTransmitItem* freerds_transmit_begin(rdsTransmitQueue* transmit)
+{
+	WaitForSingleObject(transmit->FreeSlots, INFINITE);
+
+	return &transmit->items[transmit->head % RDS_TRANSMIT_QUEUE_SIZE];
+}
+
+static void freerds_transmit_end(rdsTransmitQueue* transmit)
+{
+	transmit->head++;
+	InterlockedIncrement(&transmit->pending);
+
+	ReleaseSemaphore(transmit->UsedSlots, 1, NULL);
+}
+
+int freerds_transmit_surface_bits(rdsConnection* connection, SURFACE_BITS_COMMAND* cmd)
+{
+	rdsTransmitItem* item;
+	rdsTransmitQueue* transmit = connection->transmit;
+	rdpUpdate* update = ((rdpContext*) connection)->update;
+
+	freerds_frame_ring_add(connection->frames, cmd->bitmapDataLength, 0);
+	freerds_estimator_add_bytes(connection->estimator, cmd->bitmapDataLength);
+
+	if (!transmit || connection->transmitDirect)
+	{
+		IFCALL(update->SurfaceBits, update->context, cmd);
+		return 0;
+	}
+
+	item = freerds_transmit_begin(transmit);
+
+	item->type = RDS_TRANSMIT_SURFACE_BITS;
+	CopyMemory(&item->cmd, cmd, sizeof(SURFACE_BITS_COMMAND));
+
+	/* bitmapData normally already points into the slot stream */
+
+	if (cmd->bitmapData != Stream_Buffer(item->s))
+	{
+		Stream_SetPosition(item->s, 0);
+		Stream_EnsureCapacity(item->s, cmd->bitmapDataLength);
+		Stream_Write(item->s, cmd->bitmapData, cmd->bitmapDataLength);
+		item->cmd.bitmapData = Stream_Buffer(item->s);
+	}
+
+	freerds_transmit_end(transmit);
+
+	return 0;
+}
+
+int freerds_transmit_frame_marker(rdsConnection* connection, SURFACE_FRAME_MARKER* marker)
+{
+	rdsTransmitItem* item;
+	rdsTransmitQueue* transmit = connection->transmit;
+	rdpUpdate* update = connection->client->update;
+
+	if (!transmit || connection->transmitDirect)
+	{
+		IFCALL(update->SurfaceFrameMarker, (rdpContext*) connection, marker);
+		return 0;
+	}
+
+	item = freerds_transmit_begin(transmit);
+
+	item->type = RDS_TRANSMIT_FRAME_MARKER;
+	CopyMemory(&item->marker, marker, sizeof(SURFACE_FRAME_MARKER));
+
+	freerds_transmit_end(transmit);
+
+	return 0;
+}
+
+int freerds_transmit_flush(rdsConnection* connection)
+{
+	rdsTransmitQueue* transmit = connection->transmit;
+
+	if (!transmit)
+		return 0;
+
+	while (InterlockedCompareExchange(&transmit->pending, 0, 0) > 0)
+		WaitForSingleObject(transmit->ProgressEvent, INFINITE);
+
+	return 0;
+}
+
+int freerds_transmit_suspend(rdsConnection* connection)
+{
+	freerds_transmit_flush(connection);
+	connection->transmitDirect = TRUE;
+
+	return 0;
+}
+
+void freerds_transmit_resume(rdsConnection* connection)
+{
+	connection->transmitDirect = FALSE;
+}
@@ -0,0 +1,86 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Transmit Stage
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_TRANSMIT_H
+#define RDS_NG_TRANSMIT_H
+
+#include "core.h"
+
+#define RDS_TRANSMIT_QUEUE_SIZE		16
+
+#define RDS_TRANSMIT_SURFACE_BITS	1
+#define RDS_TRANSMIT_FRAME_MARKER	2
+
+/**
+ * Graphics pipeline, per connection:
+ *
+ * damage collection (connector thread, freerds_message_server_queue_pack)
+ * -> encode (connection thread, ServerQueue processing)
+ * -> transmit (transmit thread, SurfaceBits and frame markers)
+ *
+ * The encoder writes directly into the stream of a free transmit slot, so
+ * encoded data is not copied again. The queue is bounded: the encoder blocks
+ * when the client cannot keep up. Anything sent to the client outside of
+ * the queue must be preceded by freerds_transmit_flush to keep ordering.
+ *
+ * The connection thread also writes to the peer when it handles client and
+ * virtual channel traffic. That work is bracketed by freerds_transmit_suspend
+ * and freerds_transmit_resume: the queue is flushed first, and SurfaceBits
+ * and frame markers produced meanwhile are written directly, so the transmit
+ * thread never writes at the same time.
+ */
+
+struct rds_transmit_item
+{
+	UINT32 type;
+	wStream* s;
+	SURFACE_BITS_COMMAND cmd;
+	SURFACE_FRAME_MARKER marker;
+};
+typedef struct rds_transmit_item rdsTransmitItem;
+
+struct rds_transmit_queue
+{
+	rdsConnection* connection;
+
+	HANDLE Thread;
+	HANDLE StopEvent;
+	HANDLE FreeSlots;
+	HANDLE UsedSlots;
+	HANDLE ProgressEvent;
+
+	UINT32 head;
+	UINT32 tail;
+	volatile LONG pending;
+	rdsTransmitItem items[RDS_TRANSMIT_QUEUE_SIZE];
+};
+typedef struct rds_transmit_queue rdsTransmitQueue;
+
+rdsTransmitQueue* freerds_transmit_new(rdsConnection* connection);
+void freerds_transmit_free(rdsTransmitQueue* transmit);
+
+wStream* freerds_transmit_acquire(rdsConnection* connection, wStream* s);
+int freerds_transmit_surface_bits(rdsConnection* connection, SURFACE_BITS_COMMAND* cmd);
+int freerds_transmit_frame_marker(rdsConnection* connection, SURFACE_FRAME_MARKER* marker);
+int freerds_transmit_flush(rdsConnection* connection);
+
+int freerds_transmit_suspend(rdsConnection* connection);
+void freerds_transmit_resume(rdsConnection* connection);
+
+#endif /* RDS_NG_TRANSMIT_H */
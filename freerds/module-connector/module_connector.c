@@ -29,6 +29,8 @@
 #include <winpr/thread.h>
 #include <winpr/synch.h>
 
+#include "shm.h"
+
 rdsModuleConnector* freerds_module_connector_new(rdsConnection* connection)
 {
 	rdpSettings* settings;
@@ -69,6 +71,8 @@ void freerds_module_connector_free(rdsModuleConnector* connector)
 	Stream_Free(connector->OutboundStream, TRUE);
 	Stream_Free(connector->InboundStream, TRUE);
 
+	freerds_shm_transport_free(connector->ShmTransport);
+
 	CloseHandle(connector->StopEvent);
 	CloseHandle(connector->hClientPipe);
 
@@ -45,7 +45,7 @@ int freerds_client_outbound_synchronize_keyboard_event(rdsModuleConnector* conne
 	length = freerds_write_synchronize_keyboard_event(NULL, &msg);
 	freerds_write_synchronize_keyboard_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -70,7 +70,7 @@ int freerds_client_outbound_scancode_keyboard_event(rdsModuleConnector* connecto
 	length = freerds_write_scancode_keyboard_event(NULL, &msg);
 	freerds_write_scancode_keyboard_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -94,7 +94,7 @@ int freerds_client_outbound_virtual_keyboard_event(rdsModuleConnector* connector
 	length = freerds_write_virtual_keyboard_event(NULL, &msg);
 	freerds_write_virtual_keyboard_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -118,7 +118,7 @@ int freerds_client_outbound_unicode_keyboard_event(rdsModuleConnector* connector
 	length = freerds_write_unicode_keyboard_event(NULL, &msg);
 	freerds_write_unicode_keyboard_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -143,7 +143,7 @@ int freerds_client_outbound_mouse_event(rdsModuleConnector* connector, DWORD fla
 	length = freerds_write_mouse_event(NULL, &msg);
 	freerds_write_mouse_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -168,7 +168,7 @@ int freerds_client_outbound_extended_mouse_event(rdsModuleConnector* connector,
 	length = freerds_write_extended_mouse_event(NULL, &msg);
 	freerds_write_extended_mouse_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -189,7 +189,7 @@ int freerds_client_outbound_vblank_event(rdsModuleConnector* connector)
 	length = freerds_write_vblank_event(NULL, &msg);
 	freerds_write_vblank_event(s, &msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), length);
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
 
 	return status;
 }
@@ -217,19 +217,78 @@ rdsClientInterface* freerds_client_outbound_interface_new()
 	return client;
 }
 
+/**
+ * In batch mode, server messages are appended to the outbound stream and
+ * written together by freerds_server_outbound_flush, which is also done
+ * once the stream grows past RDS_OUTBOUND_BATCH_SIZE. Otherwise each
+ * message is written on its own.
+ *
+ * In non-blocking mode, a flush only writes what the pipe or shared memory
+ * ring accepts and keeps the rest at the front of the outbound stream for
+ * the next one.
+ */
+
 int freerds_server_outbound_write_message(rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
 {
-	int status;
 	wStream* s;
 
 	s = connector->OutboundStream;
-	Stream_SetPosition(s, 0);
+
+	if (!connector->OutboundBatch)
+		Stream_SetPosition(s, 0);
 
 	freerds_server_message_write(NULL, msg);
 	Stream_EnsureRemainingCapacity(s, msg->length);
 	freerds_server_message_write(s, msg);
 
-	status = freerds_named_pipe_write(connector->hClientPipe, Stream_Buffer(s), msg->length);
+	if (connector->OutboundBatch && (Stream_GetPosition(s) < RDS_OUTBOUND_BATCH_SIZE))
+		return msg->length;
+
+	return freerds_server_outbound_flush(connector);
+}
+
+int freerds_server_outbound_flush(rdsModuleConnector* connector)
+{
+	int length;
+	int status;
+	wStream* s;
+
+	s = connector->OutboundStream;
+	length = Stream_GetPosition(s);
+
+	if (length < 1)
+		return 0;
+
+	if (!connector->OutboundNonBlocking)
+	{
+		Stream_SetPosition(s, 0);
+		return freerds_transport_write(connector, Stream_Buffer(s), length, TRUE);
+	}
+
+	status = freerds_transport_write(connector, Stream_Buffer(s), length, FALSE);
+
+	if (status < 0)
+	{
+		Stream_SetPosition(s, 0);
+		return -1;
+	}
+
+	if (status < length)
+		MoveMemory(Stream_Buffer(s), &(Stream_Buffer(s)[status]), length - status);
+
+	Stream_SetPosition(s, length - status);
+
+	return status;
+}
+
+int freerds_server_outbound_batch(rdsModuleConnector* connector, BOOL batch)
+{
+	int status = 0;
+
+	if (!batch)
+		status = freerds_server_outbound_flush(connector);
+
+	connector->OutboundBatch = batch;
 
 	return status;
 }
@@ -22,4 +22,6 @@
 
 #include <freerds/freerds.h>
 
+#define RDS_OUTBOUND_BATCH_SIZE		65536
+
 #endif /* RDS_NG_OUTBOUND_H */
@@ -21,14 +21,18 @@
 #include "config.h"
 #endif
 
+#include <stddef.h>
+
 #include <freerds/freerds.h>
 
 #include "protocol.h"
+#include "schema.h"
 
 typedef int (*pXrdpMessageRead)(wStream* s, RDS_MSG_COMMON* msg);
 typedef int (*pXrdpMessageWrite)(wStream* s, RDS_MSG_COMMON* msg);
 typedef void* (*pXrdpMessageCopy)(RDS_MSG_COMMON* msg);
 typedef void (*pXrdpMessageFree)(RDS_MSG_COMMON* msg);
+typedef int (*pXrdpMessageCall)(void* iface, rdsModuleConnector* connector, RDS_MSG_COMMON* msg);
 
 struct _RDS_MSG_DEFINITION
 {
@@ -38,6 +42,7 @@ struct _RDS_MSG_DEFINITION
 	pXrdpMessageWrite Write;
 	pXrdpMessageCopy Copy;
 	pXrdpMessageFree Free;
+	pXrdpMessageCall Call;
 };
 typedef struct _RDS_MSG_DEFINITION RDS_MSG_DEFINITION;
 
@@ -88,214 +93,122 @@ int freerds_write_common_header(wStream* s, RDS_MSG_COMMON* msg)
 	return 0;
 }
 
-/* Client Messages */
-
-int freerds_read_synchronize_keyboard_event(wStream* s, RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4)
-		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-
-	return 0;
-}
-
-int freerds_write_synchronize_keyboard_event(wStream* s, RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 4;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->flags);
-
-	return 0;
-}
-
-int freerds_read_scancode_keyboard_event(wStream* s, RDS_MSG_SCANCODE_KEYBOARD_EVENT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-	Stream_Read_UINT32(s, msg->code);
-	Stream_Read_UINT32(s, msg->keyboardType);
-
-	return 0;
-}
+/**
+ * Field Codec
+ */
 
-int freerds_write_scancode_keyboard_event(wStream* s, RDS_MSG_SCANCODE_KEYBOARD_EVENT* msg)
+struct _RDS_MSG_FIELD
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->flags);
-	Stream_Write_UINT32(s, msg->code);
-	Stream_Write_UINT32(s, msg->keyboardType);
-
-	return 0;
-}
+	UINT16 offset;
+	UINT16 size;
+};
+typedef struct _RDS_MSG_FIELD RDS_MSG_FIELD;
 
-int freerds_read_virtual_keyboard_event(wStream* s, RDS_MSG_VIRTUAL_KEYBOARD_EVENT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 8)
-		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-	Stream_Read_UINT32(s, msg->code);
+#define RDS_MSG_FIELD_ENTRY(_type, _wire, _member) \
+	{ (UINT16) offsetof(_type, _member), (UINT16) sizeof(_wire) },
 
-	return 0;
-}
+#define RDS_MSG_FIELD_VALUE(_msg, _field) \
+	((UINT32*) &(((BYTE*) (_msg))[(_field)->offset]))
 
-int freerds_write_virtual_keyboard_event(wStream* s, RDS_MSG_VIRTUAL_KEYBOARD_EVENT* msg)
+static UINT32 freerds_message_fields_length(const RDS_MSG_FIELD* fields)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 8;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->flags);
-	Stream_Write_UINT32(s, msg->code);
-
-	return 0;
-}
+	int index;
+	UINT32 length = 0;
 
-int freerds_read_unicode_keyboard_event(wStream* s, RDS_MSG_UNICODE_KEYBOARD_EVENT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 8)
-		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-	Stream_Read_UINT32(s, msg->code);
+	for (index = 0; fields[index].size; index++)
+		length += fields[index].size;
 
-	return 0;
+	return length;
 }
 
-int freerds_write_unicode_keyboard_event(wStream* s, RDS_MSG_UNICODE_KEYBOARD_EVENT* msg)
+static int freerds_message_read_fields(wStream* s, RDS_MSG_COMMON* msg, const RDS_MSG_FIELD* fields)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 8;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->flags);
-	Stream_Write_UINT32(s, msg->code);
-
-	return 0;
-}
+	int index;
+	UINT32* value;
 
-int freerds_read_mouse_event(wStream* s, RDS_MSG_MOUSE_EVENT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
+	if (Stream_GetRemainingLength(s) < freerds_message_fields_length(fields))
 		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-	Stream_Read_UINT32(s, msg->x);
-	Stream_Read_UINT32(s, msg->y);
-
-	return 0;
-}
-
-int freerds_write_mouse_event(wStream* s, RDS_MSG_MOUSE_EVENT* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
-
-	if (!s)
-		return msg->length;
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+	for (index = 0; fields[index].size; index++)
+	{
+		value = RDS_MSG_FIELD_VALUE(msg, &fields[index]);
 
-	Stream_Write_UINT32(s, msg->flags);
-	Stream_Write_UINT32(s, msg->x);
-	Stream_Write_UINT32(s, msg->y);
+		if (fields[index].size == 2)
+			Stream_Read_UINT16(s, *value);
+		else
+			Stream_Read_UINT32(s, *value);
+	}
 
 	return 0;
 }
 
-int freerds_read_extended_mouse_event(wStream* s, RDS_MSG_EXTENDED_MOUSE_EVENT* msg)
+static int freerds_message_write_fields(wStream* s, RDS_MSG_COMMON* msg, const RDS_MSG_FIELD* fields, UINT32 msgFlags)
 {
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-	Stream_Read_UINT32(s, msg->flags);
-	Stream_Read_UINT32(s, msg->x);
-	Stream_Read_UINT32(s, msg->y);
-
-	return 0;
-}
+	int index;
+	UINT32* value;
 
-int freerds_write_extended_mouse_event(wStream* s, RDS_MSG_EXTENDED_MOUSE_EVENT* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
+	msg->msgFlags = msgFlags;
+	msg->length = freerds_write_common_header(NULL, msg) + freerds_message_fields_length(fields);
 
 	if (!s)
 		return msg->length;
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->flags);
-	Stream_Write_UINT32(s, msg->x);
-	Stream_Write_UINT32(s, msg->y);
-
-	return 0;
-}
-
-int freerds_read_vblank_event(wStream* s, RDS_MSG_VBLANK_EVENT* msg)
-{
-	return 0;
-}
+	if (msgFlags & RDS_MSG_FLAG_RECT)
+	{
+		msg->rect.x = *RDS_MSG_FIELD_VALUE(msg, &fields[0]);
+		msg->rect.y = *RDS_MSG_FIELD_VALUE(msg, &fields[1]);
+		msg->rect.width = *RDS_MSG_FIELD_VALUE(msg, &fields[2]);
+		msg->rect.height = *RDS_MSG_FIELD_VALUE(msg, &fields[3]);
+	}
 
-int freerds_write_vblank_event(wStream* s, RDS_MSG_VBLANK_EVENT* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON *)msg);
+	freerds_write_common_header(s, msg);
 
-	if (!s)
-		return msg->length;
+	for (index = 0; fields[index].size; index++)
+	{
+		value = RDS_MSG_FIELD_VALUE(msg, &fields[index]);
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+		if (fields[index].size == 2)
+			Stream_Write_UINT16(s, *value);
+		else
+			Stream_Write_UINT32(s, *value);
+	}
 
 	return 0;
 }
 
+/**
+ * Fixed-size messages get a field table and freerds_read_name and
+ * freerds_write_name functions generated from their field list.
+ */
 
-int freerds_read_capabilities(wStream* s, RDS_MSG_CAPABILITIES* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-	Stream_Read_UINT32(s, msg->DesktopWidth);
-	Stream_Read_UINT32(s, msg->DesktopHeight);
-	Stream_Read_UINT32(s, msg->ColorDepth);
-
-	return 0;
-}
-
-int freerds_write_capabilities(wStream* s, RDS_MSG_CAPABILITIES* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
+#define RDS_MSG_FIELD_CODEC(_M, _name, _msgFlags) \
+	static const RDS_MSG_FIELD _M##_FIELD_TABLE[] = \
+	{ \
+		_M##_FIELDS(RDS_MSG_FIELD_ENTRY, _M) \
+		{ 0, 0 } \
+	}; \
+	int freerds_read_##_name(wStream* s, _M* msg) \
+	{ \
+		return freerds_message_read_fields(s, (RDS_MSG_COMMON*) msg, _M##_FIELD_TABLE); \
+	} \
+	int freerds_write_##_name(wStream* s, _M* msg) \
+	{ \
+		return freerds_message_write_fields(s, (RDS_MSG_COMMON*) msg, _M##_FIELD_TABLE, _msgFlags); \
+	}
 
-	if (!s)
-		return msg->length;
+#define RDS_MSG_CODEC_FIELDS(_M, _name)		RDS_MSG_FIELD_CODEC(_M, _name, 0)
+#define RDS_MSG_CODEC_RECT(_M, _name)		RDS_MSG_FIELD_CODEC(_M, _name, RDS_MSG_FLAG_RECT)
+#define RDS_MSG_CODEC_CUSTOM(_M, _name)
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+#define RDS_MSG_CODEC_ENTRY(_T, _Name, _name, _codec, ...) \
+	RDS_MSG_CODEC_##_codec(RDS_MSG_##_T, _name)
 
-	Stream_Write_UINT32(s, msg->DesktopWidth);
-	Stream_Write_UINT32(s, msg->DesktopHeight);
-	Stream_Write_UINT32(s, msg->ColorDepth);
+RDS_SERVER_MSG_SCHEMA(RDS_MSG_CODEC_ENTRY, RDS_MSG_CODEC_ENTRY)
+RDS_CLIENT_MSG_SCHEMA(RDS_MSG_CODEC_ENTRY, RDS_MSG_CODEC_ENTRY)
 
-	return 0;
-}
+/**
+ * Client Messages
+ */
 
 int freerds_read_refresh_rect(wStream* s, RDS_MSG_REFRESH_RECT* msg)
 {
@@ -350,942 +263,311 @@ int freerds_write_refresh_rect(wStream* s, RDS_MSG_REFRESH_RECT* msg)
  */
 
 /**
- * BeginUpdate
+ * PaintRect
  */
 
-int freerds_read_begin_update(wStream* s, RDS_MSG_BEGIN_UPDATE* msg)
+int freerds_read_paint_rect(wStream* s, RDS_MSG_PAINT_RECT* msg)
 {
+	if (Stream_GetRemainingLength(s) < 12)
+		return -1;
+
+	Stream_Read_UINT16(s, msg->nLeftRect);
+	Stream_Read_UINT16(s, msg->nTopRect);
+	Stream_Read_UINT16(s, msg->nWidth);
+	Stream_Read_UINT16(s, msg->nHeight);
+	Stream_Read_UINT32(s, msg->bitmapDataLength);
+
+	if (msg->bitmapDataLength)
+	{
+		if (Stream_GetRemainingLength(s) < msg->bitmapDataLength)
+			return -1;
+
+		Stream_GetPointer(s, msg->bitmapData);
+		Stream_Seek(s, msg->bitmapDataLength);
+		msg->fbSegmentId = 0;
+	}
+	else
+	{
+		if (Stream_GetRemainingLength(s) < 4)
+			return -1;
+		Stream_Read_UINT32(s, msg->fbSegmentId);
+		msg->bitmapData = NULL;
+	}
+
+	if (Stream_GetRemainingLength(s) < 8)
+		return -1;
+	Stream_Read_UINT16(s, msg->nWidth);
+	Stream_Read_UINT16(s, msg->nHeight);
+	Stream_Read_UINT16(s, msg->nXSrc);
+	Stream_Read_UINT16(s, msg->nYSrc);
+
 	return 0;
 }
 
-int freerds_write_begin_update(wStream* s, RDS_MSG_BEGIN_UPDATE* msg)
+int freerds_write_paint_rect(wStream* s, RDS_MSG_PAINT_RECT* msg)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg);
+	msg->msgFlags = RDS_MSG_FLAG_RECT;
+	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 20;
+
+	if (msg->fbSegmentId)
+		msg->length += 4;
+	else
+		msg->length += msg->bitmapDataLength;
 
 	if (!s)
 		return msg->length;
 
+	msg->rect.x = msg->nLeftRect;
+	msg->rect.y = msg->nTopRect;
+	msg->rect.width = msg->nWidth;
+	msg->rect.height = msg->nHeight;
+
 	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
 
+	Stream_Write_UINT16(s, msg->nLeftRect);
+	Stream_Write_UINT16(s, msg->nTopRect);
+	Stream_Write_UINT16(s, msg->nWidth);
+	Stream_Write_UINT16(s, msg->nHeight);
+
+	if (msg->fbSegmentId)
+	{
+		Stream_Write_UINT32(s, 0);
+		Stream_Write_UINT32(s, msg->fbSegmentId);
+	}
+	else
+	{
+		Stream_Write_UINT32(s, msg->bitmapDataLength);
+		Stream_Write(s, msg->bitmapData, msg->bitmapDataLength);
+	}
+
+	Stream_Write_UINT16(s, msg->nWidth);
+	Stream_Write_UINT16(s, msg->nHeight);
+	Stream_Write_UINT16(s, msg->nXSrc);
+	Stream_Write_UINT16(s, msg->nYSrc);
+
 	return 0;
 }
 
-void* freerds_begin_update_copy(RDS_MSG_BEGIN_UPDATE* msg)
+void* freerds_paint_rect_copy(RDS_MSG_PAINT_RECT* msg)
 {
-	RDS_MSG_BEGIN_UPDATE* dup = NULL;
+	RDS_MSG_PAINT_RECT* dup = NULL;
 
-	dup = (RDS_MSG_BEGIN_UPDATE*) malloc(sizeof(RDS_MSG_BEGIN_UPDATE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_BEGIN_UPDATE));
+	dup = (RDS_MSG_PAINT_RECT*) malloc(sizeof(RDS_MSG_PAINT_RECT));
+	CopyMemory(dup, msg, sizeof(RDS_MSG_PAINT_RECT));
+
+	if (msg->bitmapDataLength)
+	{
+		dup->bitmapData = (BYTE*) malloc(msg->bitmapDataLength);
+		CopyMemory(dup->bitmapData, msg->bitmapData, msg->bitmapDataLength);
+	}
 
 	return (void*) dup;
 }
 
-void freerds_begin_update_free(RDS_MSG_BEGIN_UPDATE* msg)
+void freerds_paint_rect_free(RDS_MSG_PAINT_RECT* msg)
 {
+	if (msg->bitmapDataLength)
+		free(msg->bitmapData);
+
 	free(msg);
 }
 
-static RDS_MSG_DEFINITION RDS_MSG_BEGIN_UPDATE_DEFINITION =
-{
-	sizeof(RDS_MSG_BEGIN_UPDATE), "BeginUpdate",
-	(pXrdpMessageRead) freerds_read_begin_update,
-	(pXrdpMessageWrite) freerds_write_begin_update,
-	(pXrdpMessageCopy) freerds_begin_update_copy,
-	(pXrdpMessageFree) freerds_begin_update_free
-};
-
 /**
- * EndUpdate
+ * PatBlt
  */
 
-int freerds_read_end_update(wStream* s, RDS_MSG_END_UPDATE* msg)
+int freerds_read_patblt(wStream* s, RDS_MSG_PATBLT* msg)
 {
+	if (Stream_GetRemainingLength(s) < 60)
+		return -1;
+
+	Stream_Read_UINT32(s, msg->nLeftRect);
+	Stream_Read_UINT32(s, msg->nTopRect);
+	Stream_Read_UINT32(s, msg->nWidth);
+	Stream_Read_UINT32(s, msg->nHeight);
+	Stream_Read_UINT32(s, msg->bRop);
+	Stream_Read_UINT32(s, msg->backColor);
+	Stream_Read_UINT32(s, msg->foreColor);
+
+	Stream_Read_UINT32(s, msg->brush.x);
+	Stream_Read_UINT32(s, msg->brush.y);
+	Stream_Read_UINT32(s, msg->brush.bpp);
+	Stream_Read_UINT32(s, msg->brush.style);
+	Stream_Read_UINT32(s, msg->brush.hatch);
+	Stream_Read_UINT32(s, msg->brush.index);
+	msg->brush.data = msg->brush.p8x8;
+	Stream_Read(s, msg->brush.data, 8);
+
 	return 0;
 }
 
-int freerds_write_end_update(wStream* s, RDS_MSG_END_UPDATE* msg)
+int freerds_write_patblt(wStream* s, RDS_MSG_PATBLT* msg)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg);
+	msg->msgFlags = RDS_MSG_FLAG_RECT;
+	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 60;
 
 	if (!s)
 		return msg->length;
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+	msg->rect.x = msg->nLeftRect;
+	msg->rect.y = msg->nTopRect;
+	msg->rect.width = msg->nWidth;
+	msg->rect.height = msg->nHeight;
 
-	return 0;
-}
-
-void* freerds_end_update_copy(RDS_MSG_END_UPDATE* msg)
-{
-	RDS_MSG_END_UPDATE* dup = NULL;
-
-	dup = (RDS_MSG_END_UPDATE*) malloc(sizeof(RDS_MSG_END_UPDATE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_END_UPDATE));
-
-	return (void*) dup;
-}
-
-void freerds_end_update_free(RDS_MSG_END_UPDATE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_END_UPDATE_DEFINITION =
-{
-	sizeof(RDS_MSG_END_UPDATE), "EndUpdate",
-	(pXrdpMessageRead) freerds_read_end_update,
-	(pXrdpMessageWrite) freerds_write_end_update,
-	(pXrdpMessageCopy) freerds_end_update_copy,
-	(pXrdpMessageFree) freerds_end_update_free
-};
-
-/**
- * SetClippingRegion
- */
-
-int freerds_read_set_clipping_region(wStream* s, RDS_MSG_SET_CLIPPING_REGION* msg)
-{
-	if (Stream_GetRemainingLength(s) < 10)
-		return -1;
-
-	Stream_Read_UINT16(s, msg->bNullRegion);
-	Stream_Read_UINT16(s, msg->nLeftRect);
-	Stream_Read_UINT16(s, msg->nTopRect);
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-
-	return 0;
-}
-
-int freerds_write_set_clipping_region(wStream* s, RDS_MSG_SET_CLIPPING_REGION* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 10;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT16(s, msg->bNullRegion);
-	Stream_Write_UINT16(s, msg->nLeftRect);
-	Stream_Write_UINT16(s, msg->nTopRect);
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-
-	return 0;
-}
-
-void* freerds_set_clipping_region_copy(RDS_MSG_SET_CLIPPING_REGION* msg)
-{
-	RDS_MSG_SET_CLIPPING_REGION* dup = NULL;
-
-	dup = (RDS_MSG_SET_CLIPPING_REGION*) malloc(sizeof(RDS_MSG_SET_CLIPPING_REGION));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SET_CLIPPING_REGION));
-
-	return (void*) dup;
-}
-
-void freerds_set_clipping_region_free(RDS_MSG_SET_CLIPPING_REGION* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_SET_CLIPPING_REGION_DEFINITION =
-{
-	sizeof(RDS_MSG_SET_CLIPPING_REGION), "SetClippingRegion",
-	(pXrdpMessageRead) freerds_read_set_clipping_region,
-	(pXrdpMessageWrite) freerds_write_set_clipping_region,
-	(pXrdpMessageCopy) freerds_set_clipping_region_copy,
-	(pXrdpMessageFree) freerds_set_clipping_region_free
-};
-
-/**
- * OpaqueRect
- */
-
-int freerds_read_opaque_rect(wStream* s, RDS_MSG_OPAQUE_RECT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-
-	Stream_Read_UINT16(s, msg->nLeftRect);
-	Stream_Read_UINT16(s, msg->nTopRect);
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-	Stream_Read_UINT32(s, msg->color);
-
-	return 0;
-}
-
-int freerds_write_opaque_rect(wStream* s, RDS_MSG_OPAQUE_RECT* msg)
-{
-	msg->msgFlags = RDS_MSG_FLAG_RECT;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
-
-	if (!s)
-		return msg->length;
-
-	msg->rect.x = msg->nLeftRect;
-	msg->rect.y = msg->nTopRect;
-	msg->rect.width = msg->nWidth;
-	msg->rect.height = msg->nHeight;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT16(s, msg->nLeftRect);
-	Stream_Write_UINT16(s, msg->nTopRect);
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-	Stream_Write_UINT32(s, msg->color);
-
-	return 0;
-}
-
-void* freerds_opaque_rect_copy(RDS_MSG_OPAQUE_RECT* msg)
-{
-	RDS_MSG_OPAQUE_RECT* dup = NULL;
-
-	dup = (RDS_MSG_OPAQUE_RECT*) malloc(sizeof(RDS_MSG_OPAQUE_RECT));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_OPAQUE_RECT));
-
-	return (void*) dup;
-}
-
-void freerds_opaque_rect_free(RDS_MSG_OPAQUE_RECT* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_OPAQUE_RECT_DEFINITION =
-{
-	sizeof(RDS_MSG_OPAQUE_RECT), "OpaqueRect",
-	(pXrdpMessageRead) freerds_read_opaque_rect,
-	(pXrdpMessageWrite) freerds_write_opaque_rect,
-	(pXrdpMessageCopy) freerds_opaque_rect_copy,
-	(pXrdpMessageFree) freerds_opaque_rect_free
-};
-
-/**
- * ScreenBlt
- */
-
-int freerds_read_screen_blt(wStream* s, RDS_MSG_SCREEN_BLT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-
-	Stream_Read_UINT16(s, msg->nLeftRect);
-	Stream_Read_UINT16(s, msg->nTopRect);
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-	Stream_Read_UINT16(s, msg->nXSrc);
-	Stream_Read_UINT16(s, msg->nYSrc);
-
-	return 0;
-}
-
-int freerds_write_screen_blt(wStream* s, RDS_MSG_SCREEN_BLT* msg)
-{
-	msg->msgFlags = RDS_MSG_FLAG_RECT;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 12;
-
-	if (!s)
-		return msg->length;
-
-	msg->rect.x = msg->nLeftRect;
-	msg->rect.y = msg->nTopRect;
-	msg->rect.width = msg->nWidth;
-	msg->rect.height = msg->nHeight;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT16(s, msg->nLeftRect);
-	Stream_Write_UINT16(s, msg->nTopRect);
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-	Stream_Write_UINT16(s, msg->nXSrc);
-	Stream_Write_UINT16(s, msg->nYSrc);
-
-	return 0;
-}
-
-void* freerds_screen_blt_copy(RDS_MSG_SCREEN_BLT* msg)
-{
-	RDS_MSG_SCREEN_BLT* dup = NULL;
-
-	dup = (RDS_MSG_SCREEN_BLT*) malloc(sizeof(RDS_MSG_SCREEN_BLT));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SCREEN_BLT));
-
-	return (void*) dup;
-}
-
-void freerds_screen_blt_free(RDS_MSG_SCREEN_BLT* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_SCREEN_BLT_DEFINITION =
-{
-	sizeof(RDS_MSG_SCREEN_BLT), "ScreenBlt",
-	(pXrdpMessageRead) freerds_read_screen_blt,
-	(pXrdpMessageWrite) freerds_write_screen_blt,
-	(pXrdpMessageCopy) freerds_screen_blt_copy,
-	(pXrdpMessageFree) freerds_screen_blt_free
-};
-
-/**
- * PaintRect
- */
-
-int freerds_read_paint_rect(wStream* s, RDS_MSG_PAINT_RECT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 12)
-		return -1;
-
-	Stream_Read_UINT16(s, msg->nLeftRect);
-	Stream_Read_UINT16(s, msg->nTopRect);
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-	Stream_Read_UINT32(s, msg->bitmapDataLength);
-
-	if (msg->bitmapDataLength)
-	{
-		if (Stream_GetRemainingLength(s) < msg->bitmapDataLength)
-			return -1;
-
-		Stream_GetPointer(s, msg->bitmapData);
-		Stream_Seek(s, msg->bitmapDataLength);
-	}
-	else
-	{
-		if (Stream_GetRemainingLength(s) < 4)
-			return -1;
-		Stream_Read_UINT32(s, msg->fbSegmentId);
-	}
-
-	if (Stream_GetRemainingLength(s) < 8)
-		return -1;
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-	Stream_Read_UINT16(s, msg->nXSrc);
-	Stream_Read_UINT16(s, msg->nYSrc);
-
-	return 0;
-}
-
-int freerds_write_paint_rect(wStream* s, RDS_MSG_PAINT_RECT* msg)
-{
-	msg->msgFlags = RDS_MSG_FLAG_RECT;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 20;
-
-	if (msg->fbSegmentId)
-		msg->length += 4;
-	else
-		msg->length += msg->bitmapDataLength;
-
-	if (!s)
-		return msg->length;
-
-	msg->rect.x = msg->nLeftRect;
-	msg->rect.y = msg->nTopRect;
-	msg->rect.width = msg->nWidth;
-	msg->rect.height = msg->nHeight;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT16(s, msg->nLeftRect);
-	Stream_Write_UINT16(s, msg->nTopRect);
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-
-	if (msg->fbSegmentId)
-	{
-		Stream_Write_UINT32(s, 0);
-		Stream_Write_UINT32(s, msg->fbSegmentId);
-	}
-	else
-	{
-		Stream_Write_UINT32(s, msg->bitmapDataLength);
-		Stream_Write(s, msg->bitmapData, msg->bitmapDataLength);
-	}
-
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-	Stream_Write_UINT16(s, msg->nXSrc);
-	Stream_Write_UINT16(s, msg->nYSrc);
-
-	return 0;
-}
-
-void* freerds_paint_rect_copy(RDS_MSG_PAINT_RECT* msg)
-{
-	RDS_MSG_PAINT_RECT* dup = NULL;
-
-	dup = (RDS_MSG_PAINT_RECT*) malloc(sizeof(RDS_MSG_PAINT_RECT));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_PAINT_RECT));
-
-	if (msg->bitmapDataLength)
-	{
-		dup->bitmapData = (BYTE*) malloc(msg->bitmapDataLength);
-		CopyMemory(dup->bitmapData, msg->bitmapData, msg->bitmapDataLength);
-	}
-
-	return (void*) dup;
-}
-
-void freerds_paint_rect_free(RDS_MSG_PAINT_RECT* msg)
-{
-	if (msg->bitmapDataLength)
-		free(msg->bitmapData);
-
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_PAINT_RECT_DEFINITION =
-{
-	sizeof(RDS_MSG_PAINT_RECT), "PaintRect",
-	(pXrdpMessageRead) freerds_read_paint_rect,
-	(pXrdpMessageWrite) freerds_write_paint_rect,
-	(pXrdpMessageCopy) freerds_paint_rect_copy,
-	(pXrdpMessageFree) freerds_paint_rect_free
-};
-
-/**
- * PatBlt
- */
-
-int freerds_read_patblt(wStream* s, RDS_MSG_PATBLT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 60)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->nLeftRect);
-	Stream_Read_UINT32(s, msg->nTopRect);
-	Stream_Read_UINT32(s, msg->nWidth);
-	Stream_Read_UINT32(s, msg->nHeight);
-	Stream_Read_UINT32(s, msg->bRop);
-	Stream_Read_UINT32(s, msg->backColor);
-	Stream_Read_UINT32(s, msg->foreColor);
-
-	Stream_Read_UINT32(s, msg->brush.x);
-	Stream_Read_UINT32(s, msg->brush.y);
-	Stream_Read_UINT32(s, msg->brush.bpp);
-	Stream_Read_UINT32(s, msg->brush.style);
-	Stream_Read_UINT32(s, msg->brush.hatch);
-	Stream_Read_UINT32(s, msg->brush.index);
-	Stream_Read(s, msg->brush.data, 8);
-
-	return 0;
-}
-
-int freerds_write_patblt(wStream* s, RDS_MSG_PATBLT* msg)
-{
-	msg->msgFlags = RDS_MSG_FLAG_RECT;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 60;
-
-	if (!s)
-		return msg->length;
-
-	msg->rect.x = msg->nLeftRect;
-	msg->rect.y = msg->nTopRect;
-	msg->rect.width = msg->nWidth;
-	msg->rect.height = msg->nHeight;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->nLeftRect);
-	Stream_Write_UINT32(s, msg->nTopRect);
-	Stream_Write_UINT32(s, msg->nWidth);
-	Stream_Write_UINT32(s, msg->nHeight);
-	Stream_Write_UINT32(s, msg->bRop);
-	Stream_Write_UINT32(s, msg->backColor);
-	Stream_Write_UINT32(s, msg->foreColor);
-
-	Stream_Write_UINT32(s, msg->brush.x);
-	Stream_Write_UINT32(s, msg->brush.y);
-	Stream_Write_UINT32(s, msg->brush.bpp);
-	Stream_Write_UINT32(s, msg->brush.style);
-	Stream_Write_UINT32(s, msg->brush.hatch);
-	Stream_Write_UINT32(s, msg->brush.index);
-	Stream_Write(s, msg->brush.data, 8);
-
-	return 0;
-}
-
-void* freerds_patblt_copy(RDS_MSG_PATBLT* msg)
-{
-	RDS_MSG_PATBLT* dup = NULL;
-
-	dup = (RDS_MSG_PATBLT*) malloc(sizeof(RDS_MSG_PATBLT));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_PATBLT));
-
-	return (void*) dup;
-}
-
-void freerds_patblt_free(RDS_MSG_PATBLT* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_PATBLT_DEFINITION =
-{
-	sizeof(RDS_MSG_PATBLT), "PatBlt",
-	(pXrdpMessageRead) freerds_read_patblt,
-	(pXrdpMessageWrite) freerds_write_patblt,
-	(pXrdpMessageCopy) freerds_patblt_copy,
-	(pXrdpMessageFree) freerds_patblt_free
-};
-
-/**
- * DstBlt
- */
-
-int freerds_read_dstblt(wStream* s, RDS_MSG_DSTBLT* msg)
-{
-	if (Stream_GetRemainingLength(s) < 20)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->nLeftRect);
-	Stream_Read_UINT32(s, msg->nTopRect);
-	Stream_Read_UINT32(s, msg->nWidth);
-	Stream_Read_UINT32(s, msg->nHeight);
-	Stream_Read_UINT32(s, msg->bRop);
-
-	return 0;
-}
-
-int freerds_write_dstblt(wStream* s, RDS_MSG_DSTBLT* msg)
-{
-	msg->msgFlags = RDS_MSG_FLAG_RECT;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 20;
-
-	if (!s)
-		return msg->length;
-
-	msg->rect.x = msg->nLeftRect;
-	msg->rect.y = msg->nTopRect;
-	msg->rect.width = msg->nWidth;
-	msg->rect.height = msg->nHeight;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
 
 	Stream_Write_UINT32(s, msg->nLeftRect);
 	Stream_Write_UINT32(s, msg->nTopRect);
 	Stream_Write_UINT32(s, msg->nWidth);
 	Stream_Write_UINT32(s, msg->nHeight);
 	Stream_Write_UINT32(s, msg->bRop);
+	Stream_Write_UINT32(s, msg->backColor);
+	Stream_Write_UINT32(s, msg->foreColor);
 
-	return 0;
-}
-
-void* freerds_dstblt_copy(RDS_MSG_DSTBLT* msg)
-{
-	RDS_MSG_DSTBLT* dup = NULL;
-
-	dup = (RDS_MSG_DSTBLT*) malloc(sizeof(RDS_MSG_DSTBLT));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_DSTBLT));
-
-	return (void*) dup;
-}
-
-void freerds_dstblt_free(RDS_MSG_DSTBLT* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_DSTBLT_DEFINITION =
-{
-	sizeof(RDS_MSG_DSTBLT), "DstBlt",
-	(pXrdpMessageRead) freerds_read_dstblt,
-	(pXrdpMessageWrite) freerds_write_dstblt,
-	(pXrdpMessageCopy) freerds_dstblt_copy,
-	(pXrdpMessageFree) freerds_dstblt_free
-};
-
-/**
- * LineTo
- */
-
-int freerds_read_line_to(wStream* s, RDS_MSG_LINE_TO* msg)
-{
-	if (Stream_GetRemainingLength(s) < 8 * 4)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->nXStart);
-	Stream_Read_UINT32(s, msg->nYStart);
-	Stream_Read_UINT32(s, msg->nXEnd);
-	Stream_Read_UINT32(s, msg->nYEnd);
-	Stream_Read_UINT32(s, msg->bRop2);
-	Stream_Read_UINT32(s, msg->penStyle);
-	Stream_Read_UINT32(s, msg->penWidth);
-	Stream_Read_UINT32(s, msg->penColor);
-
-	return 0;
-}
-
-int freerds_write_line_to(wStream* s, RDS_MSG_LINE_TO* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 32;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->nXStart);
-	Stream_Write_UINT32(s, msg->nYStart);
-	Stream_Write_UINT32(s, msg->nXEnd);
-	Stream_Write_UINT32(s, msg->nYEnd);
-	Stream_Write_UINT32(s, msg->bRop2);
-	Stream_Write_UINT32(s, msg->penStyle);
-	Stream_Write_UINT32(s, msg->penWidth);
-	Stream_Write_UINT32(s, msg->penColor);
+	Stream_Write_UINT32(s, msg->brush.x);
+	Stream_Write_UINT32(s, msg->brush.y);
+	Stream_Write_UINT32(s, msg->brush.bpp);
+	Stream_Write_UINT32(s, msg->brush.style);
+	Stream_Write_UINT32(s, msg->brush.hatch);
+	Stream_Write_UINT32(s, msg->brush.index);
+	Stream_Write(s, msg->brush.data, 8);
 
 	return 0;
 }
 
-void* freerds_line_to_copy(RDS_MSG_LINE_TO* msg)
-{
-	RDS_MSG_LINE_TO* dup = NULL;
-
-	dup = (RDS_MSG_LINE_TO*) malloc(sizeof(RDS_MSG_LINE_TO));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_LINE_TO));
-
-	return (void*) dup;
-}
-
-void freerds_line_to_free(RDS_MSG_LINE_TO* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_LINE_TO_DEFINITION =
-{
-	sizeof(RDS_MSG_LINE_TO), "LineTo",
-	(pXrdpMessageRead) freerds_read_line_to,
-	(pXrdpMessageWrite) freerds_write_line_to,
-	(pXrdpMessageCopy) freerds_line_to_copy,
-	(pXrdpMessageFree) freerds_line_to_free
-};
-
 /**
- * CreateOffscreenSurface
+ * SetPalette
  */
 
-int freerds_read_create_offscreen_surface(wStream* s, RDS_MSG_CREATE_OFFSCREEN_SURFACE* msg)
+int freerds_read_set_palette(wStream* s, RDS_MSG_SET_PALETTE* msg)
 {
-	if (Stream_GetRemainingLength(s) < 8)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->cacheIndex);
-	Stream_Read_UINT16(s, msg->nWidth);
-	Stream_Read_UINT16(s, msg->nHeight);
-
 	return 0;
 }
 
-int freerds_write_create_offscreen_surface(wStream* s, RDS_MSG_CREATE_OFFSCREEN_SURFACE* msg)
+int freerds_write_set_palette(wStream* s, RDS_MSG_SET_PALETTE* msg)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 8;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->cacheIndex);
-	Stream_Write_UINT16(s, msg->nWidth);
-	Stream_Write_UINT16(s, msg->nHeight);
-
 	return 0;
 }
 
-void* freerds_create_offscreen_surface_copy(RDS_MSG_CREATE_OFFSCREEN_SURFACE* msg)
-{
-	RDS_MSG_CREATE_OFFSCREEN_SURFACE* dup = NULL;
-
-	dup = (RDS_MSG_CREATE_OFFSCREEN_SURFACE*) malloc(sizeof(RDS_MSG_CREATE_OFFSCREEN_SURFACE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_CREATE_OFFSCREEN_SURFACE));
-
-	return (void*) dup;
-}
-
-void freerds_create_offscreen_surface_free(RDS_MSG_CREATE_OFFSCREEN_SURFACE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_CREATE_OFFSCREEN_SURFACE_DEFINITION =
-{
-	sizeof(RDS_MSG_CREATE_OFFSCREEN_SURFACE), "CreateOffscreenSurface",
-	(pXrdpMessageRead) freerds_read_create_offscreen_surface,
-	(pXrdpMessageWrite) freerds_write_create_offscreen_surface,
-	(pXrdpMessageCopy) freerds_create_offscreen_surface_copy,
-	(pXrdpMessageFree) freerds_create_offscreen_surface_free
-};
-
 /**
- * SwitchOffscreenSurface
+ * CacheGlyph
  */
 
-int freerds_read_switch_offscreen_surface(wStream* s, RDS_MSG_SWITCH_OFFSCREEN_SURFACE* msg)
+int freerds_read_cache_glyph(wStream* s, RDS_MSG_CACHE_GLYPH* msg)
 {
-	if (Stream_GetRemainingLength(s) < 4)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->cacheIndex);
-
 	return 0;
 }
 
-int freerds_write_switch_offscreen_surface(wStream* s, RDS_MSG_SWITCH_OFFSCREEN_SURFACE* msg)
+int freerds_write_cache_glyph(wStream* s, RDS_MSG_CACHE_GLYPH* msg)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 4;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->cacheIndex);
-
 	return 0;
 }
 
-void* freerds_switch_offscreen_surface_copy(RDS_MSG_SWITCH_OFFSCREEN_SURFACE* msg)
-{
-	RDS_MSG_SWITCH_OFFSCREEN_SURFACE* dup = NULL;
-
-	dup = (RDS_MSG_SWITCH_OFFSCREEN_SURFACE*) malloc(sizeof(RDS_MSG_SWITCH_OFFSCREEN_SURFACE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SWITCH_OFFSCREEN_SURFACE));
-
-	return (void*) dup;
-}
-
-void freerds_switch_offscreen_surface_free(RDS_MSG_SWITCH_OFFSCREEN_SURFACE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_SWITCH_OFFSCREEN_SURFACE_DEFINITION =
-{
-	sizeof(RDS_MSG_SWITCH_OFFSCREEN_SURFACE), "SwitchOffscreenSurface",
-	(pXrdpMessageRead) freerds_read_switch_offscreen_surface,
-	(pXrdpMessageWrite) freerds_write_switch_offscreen_surface,
-	(pXrdpMessageCopy) freerds_switch_offscreen_surface_copy,
-	(pXrdpMessageFree) freerds_switch_offscreen_surface_free
-};
-
 /**
- * DeleteOffscreenSurface
+ * GlyphIndex
  */
 
-int freerds_read_delete_offscreen_surface(wStream* s, RDS_MSG_DELETE_OFFSCREEN_SURFACE* msg)
+int freerds_read_glyph_index(wStream* s, RDS_MSG_GLYPH_INDEX* msg)
 {
-	if (Stream_GetRemainingLength(s) < 4)
+	if (Stream_GetRemainingLength(s) < 100)
 		return -1;
-	Stream_Read_UINT32(s, msg->cacheIndex);
-
-	return 0;
-}
-
-int freerds_write_delete_offscreen_surface(wStream* s, RDS_MSG_DELETE_OFFSCREEN_SURFACE* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 4;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->cacheIndex);
-
-	return 0;
-}
 
-void* freerds_delete_offscreen_surface_copy(RDS_MSG_DELETE_OFFSCREEN_SURFACE* msg)
-{
-	RDS_MSG_DELETE_OFFSCREEN_SURFACE* dup = NULL;
+	Stream_Read_UINT32(s, msg->cacheId);
+	Stream_Read_UINT32(s, msg->flAccel);
+	Stream_Read_UINT32(s, msg->ulCharInc);
+	Stream_Read_UINT32(s, msg->fOpRedundant);
+	Stream_Read_UINT32(s, msg->backColor);
+	Stream_Read_UINT32(s, msg->foreColor);
+	Stream_Read_UINT32(s, msg->bkLeft);
+	Stream_Read_UINT32(s, msg->bkTop);
+	Stream_Read_UINT32(s, msg->bkRight);
+	Stream_Read_UINT32(s, msg->bkBottom);
+	Stream_Read_UINT32(s, msg->opLeft);
+	Stream_Read_UINT32(s, msg->opTop);
+	Stream_Read_UINT32(s, msg->opRight);
+	Stream_Read_UINT32(s, msg->opBottom);
 
-	dup = (RDS_MSG_DELETE_OFFSCREEN_SURFACE*) malloc(sizeof(RDS_MSG_DELETE_OFFSCREEN_SURFACE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_DELETE_OFFSCREEN_SURFACE));
+	Stream_Read_UINT32(s, msg->brush.x);
+	Stream_Read_UINT32(s, msg->brush.y);
+	Stream_Read_UINT32(s, msg->brush.bpp);
+	Stream_Read_UINT32(s, msg->brush.style);
+	Stream_Read_UINT32(s, msg->brush.hatch);
+	Stream_Read_UINT32(s, msg->brush.index);
+	msg->brush.data = msg->brush.p8x8;
+	Stream_Read(s, msg->brush.data, 8);
 
-	return (void*) dup;
-}
+	Stream_Read_UINT32(s, msg->x);
+	Stream_Read_UINT32(s, msg->y);
+	Stream_Read_UINT32(s, msg->cbData);
 
-void freerds_delete_offscreen_surface_free(RDS_MSG_DELETE_OFFSCREEN_SURFACE* msg)
-{
-	free(msg);
-}
+	if (Stream_GetRemainingLength(s) < msg->cbData + 8)
+		return -1;
 
-static RDS_MSG_DEFINITION RDS_MSG_DELETE_OFFSCREEN_SURFACE_DEFINITION =
-{
-	sizeof(RDS_MSG_DELETE_OFFSCREEN_SURFACE), "DeleteOffscreenSurface",
-	(pXrdpMessageRead) freerds_read_delete_offscreen_surface,
-	(pXrdpMessageWrite) freerds_write_delete_offscreen_surface,
-	(pXrdpMessageCopy) freerds_delete_offscreen_surface_copy,
-	(pXrdpMessageFree) freerds_delete_offscreen_surface_free
-};
+	Stream_GetPointer(s, msg->data);
+	Stream_Seek(s, msg->cbData);
 
-/**
- * PaintOffscreenSurface
- */
+	Stream_Read_UINT32(s, msg->cGlyphs);
+	Stream_Read_UINT32(s, msg->cbGlyphs);
 
-int freerds_read_paint_offscreen_surface(wStream* s, RDS_MSG_PAINT_OFFSCREEN_SURFACE* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4 * 8)
+	if (Stream_GetRemainingLength(s) < msg->cbGlyphs)
 		return -1;
-	Stream_Read_UINT32(s, msg->cacheIndex);
-	Stream_Read_UINT32(s, msg->nLeftRect);
-	Stream_Read_UINT32(s, msg->nTopRect);
-	Stream_Read_UINT32(s, msg->nWidth);
-	Stream_Read_UINT32(s, msg->nHeight);
-	Stream_Read_UINT32(s, msg->nXSrc);
-	Stream_Read_UINT32(s, msg->nYSrc);
-	Stream_Read_UINT32(s, msg->bRop);
+
+	Stream_GetPointer(s, msg->glyphs);
+	Stream_Seek(s, msg->cbGlyphs);
 
 	return 0;
 }
 
-int freerds_write_paint_offscreen_surface(wStream* s, RDS_MSG_PAINT_OFFSCREEN_SURFACE* msg)
+int freerds_write_glyph_index(wStream* s, RDS_MSG_GLYPH_INDEX* msg)
 {
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 32;
+	msg->msgFlags = RDS_MSG_FLAG_RECT;
+	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) +
+			108 + msg->cbData + msg->cbGlyphs;
 
 	if (!s)
 		return msg->length;
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->cacheIndex);
-	Stream_Write_UINT32(s, msg->nLeftRect);
-	Stream_Write_UINT32(s, msg->nTopRect);
-	Stream_Write_UINT32(s, msg->nWidth);
-	Stream_Write_UINT32(s, msg->nHeight);
-	Stream_Write_UINT32(s, msg->nXSrc);
-	Stream_Write_UINT32(s, msg->nYSrc);
-	Stream_Write_UINT32(s, msg->bRop);
-
-	return 0;
-}
-
-void* freerds_paint_offscreen_surface_copy(RDS_MSG_PAINT_OFFSCREEN_SURFACE* msg)
-{
-	RDS_MSG_PAINT_OFFSCREEN_SURFACE* dup = NULL;
-
-	dup = (RDS_MSG_PAINT_OFFSCREEN_SURFACE*) malloc(sizeof(RDS_MSG_PAINT_OFFSCREEN_SURFACE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_PAINT_OFFSCREEN_SURFACE));
-
-	return (void*) dup;
-}
-
-void freerds_paint_offscreen_surface_free(RDS_MSG_PAINT_OFFSCREEN_SURFACE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_PAINT_OFFSCREEN_SURFACE_DEFINITION =
-{
-	sizeof(RDS_MSG_PAINT_OFFSCREEN_SURFACE), "PaintOffscreenSurface",
-	(pXrdpMessageRead) freerds_read_paint_offscreen_surface,
-	(pXrdpMessageWrite) freerds_write_paint_offscreen_surface,
-	(pXrdpMessageCopy) freerds_paint_offscreen_surface_copy,
-	(pXrdpMessageFree) freerds_paint_offscreen_surface_free
-};
-
-/**
- * SetPalette
- */
-
-int freerds_read_set_palette(wStream* s, RDS_MSG_SET_PALETTE* msg)
-{
-	return 0;
-}
-
-int freerds_write_set_palette(wStream* s, RDS_MSG_SET_PALETTE* msg)
-{
-	return 0;
-}
-
-void* freerds_set_palette_copy(RDS_MSG_SET_PALETTE* msg)
-{
-	RDS_MSG_SET_PALETTE* dup = NULL;
-
-	dup = (RDS_MSG_SET_PALETTE*) malloc(sizeof(RDS_MSG_SET_PALETTE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SET_PALETTE));
-
-	return (void*) dup;
-}
-
-void freerds_set_palette_free(RDS_MSG_SET_PALETTE* msg)
-{
-	free(msg);
-}
-static RDS_MSG_DEFINITION RDS_MSG_SET_PALETTE_DEFINITION =
-{
-	sizeof(RDS_MSG_SET_PALETTE), "SetPalette",
-	(pXrdpMessageRead) freerds_read_set_palette,
-	(pXrdpMessageWrite) freerds_write_set_palette,
-	(pXrdpMessageCopy) freerds_set_palette_copy,
-	(pXrdpMessageFree) freerds_set_palette_free
-};
-
-/**
- * CacheGlyph
- */
-
-int freerds_read_cache_glyph(wStream* s, RDS_MSG_CACHE_GLYPH* msg)
-{
-	return 0;
-}
-
-int freerds_write_cache_glyph(wStream* s, RDS_MSG_CACHE_GLYPH* msg)
-{
-	return 0;
-}
-
-void* freerds_cache_glyph_copy(RDS_MSG_CACHE_GLYPH* msg)
-{
-	RDS_MSG_CACHE_GLYPH* dup = NULL;
+	/* the background rectangle bounds the opaque rectangle */
 
-	dup = (RDS_MSG_CACHE_GLYPH*) malloc(sizeof(RDS_MSG_CACHE_GLYPH));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_CACHE_GLYPH));
+	msg->rect.x = msg->bkLeft;
+	msg->rect.y = msg->bkTop;
+	msg->rect.width = msg->bkRight - msg->bkLeft;
+	msg->rect.height = msg->bkBottom - msg->bkTop;
 
-	return (void*) dup;
-}
+	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
 
-void freerds_cache_glyph_free(RDS_MSG_CACHE_GLYPH* msg)
-{
-	free(msg);
-}
+	Stream_Write_UINT32(s, msg->cacheId);
+	Stream_Write_UINT32(s, msg->flAccel);
+	Stream_Write_UINT32(s, msg->ulCharInc);
+	Stream_Write_UINT32(s, msg->fOpRedundant);
+	Stream_Write_UINT32(s, msg->backColor);
+	Stream_Write_UINT32(s, msg->foreColor);
+	Stream_Write_UINT32(s, msg->bkLeft);
+	Stream_Write_UINT32(s, msg->bkTop);
+	Stream_Write_UINT32(s, msg->bkRight);
+	Stream_Write_UINT32(s, msg->bkBottom);
+	Stream_Write_UINT32(s, msg->opLeft);
+	Stream_Write_UINT32(s, msg->opTop);
+	Stream_Write_UINT32(s, msg->opRight);
+	Stream_Write_UINT32(s, msg->opBottom);
 
-static RDS_MSG_DEFINITION RDS_MSG_CACHE_GLYPH_DEFINITION =
-{
-	sizeof(RDS_MSG_CACHE_GLYPH), "CacheGlyph",
-	(pXrdpMessageRead) freerds_read_cache_glyph,
-	(pXrdpMessageWrite) freerds_write_cache_glyph,
-	(pXrdpMessageCopy) freerds_cache_glyph_copy,
-	(pXrdpMessageFree) freerds_cache_glyph_free
-};
+	Stream_Write_UINT32(s, msg->brush.x);
+	Stream_Write_UINT32(s, msg->brush.y);
+	Stream_Write_UINT32(s, msg->brush.bpp);
+	Stream_Write_UINT32(s, msg->brush.style);
+	Stream_Write_UINT32(s, msg->brush.hatch);
+	Stream_Write_UINT32(s, msg->brush.index);
+	Stream_Write(s, msg->brush.p8x8, 8);
 
-/**
- * GlyphIndex
- */
+	Stream_Write_UINT32(s, msg->x);
+	Stream_Write_UINT32(s, msg->y);
+	Stream_Write_UINT32(s, msg->cbData);
+	Stream_Write(s, msg->data, msg->cbData);
 
-int freerds_read_glyph_index(wStream* s, RDS_MSG_GLYPH_INDEX* msg)
-{
-	return 0;
-}
+	Stream_Write_UINT32(s, msg->cGlyphs);
+	Stream_Write_UINT32(s, msg->cbGlyphs);
+	Stream_Write(s, msg->glyphs, msg->cbGlyphs);
 
-int freerds_write_glyph_index(wStream* s, RDS_MSG_GLYPH_INDEX* msg)
-{
 	return 0;
 }
 
@@ -1296,23 +578,34 @@ void* freerds_glyph_index_copy(RDS_MSG_GLYPH_INDEX* msg)
 	dup = (RDS_MSG_GLYPH_INDEX*) malloc(sizeof(RDS_MSG_GLYPH_INDEX));
 	CopyMemory(dup, msg, sizeof(RDS_MSG_GLYPH_INDEX));
 
+	dup->brush.data = dup->brush.p8x8;
+
+	if (dup->data)
+	{
+		dup->data = (BYTE*) malloc(dup->cbData);
+		CopyMemory(dup->data, msg->data, dup->cbData);
+	}
+
+	if (dup->glyphs)
+	{
+		dup->glyphs = (BYTE*) malloc(dup->cbGlyphs);
+		CopyMemory(dup->glyphs, msg->glyphs, dup->cbGlyphs);
+	}
+
 	return (void*) dup;
 }
 
 void freerds_glyph_index_free(RDS_MSG_GLYPH_INDEX* msg)
 {
+	if (msg->data)
+		free(msg->data);
+
+	if (msg->glyphs)
+		free(msg->glyphs);
+
 	free(msg);
 }
 
-static RDS_MSG_DEFINITION RDS_MSG_GLYPH_INDEX_DEFINITION =
-{
-	sizeof(RDS_MSG_GLYPH_INDEX), "GlyphIndex",
-	(pXrdpMessageRead) freerds_read_glyph_index,
-	(pXrdpMessageWrite) freerds_write_glyph_index,
-	(pXrdpMessageCopy) freerds_glyph_index_copy,
-	(pXrdpMessageFree) freerds_glyph_index_free
-};
-
 /**
  * SetPointer
  */
@@ -1417,132 +710,6 @@ void freerds_set_pointer_free(RDS_MSG_SET_POINTER* msg)
 	free(msg);
 }
 
-static RDS_MSG_DEFINITION RDS_MSG_SET_POINTER_DEFINITION =
-{
-	sizeof(RDS_MSG_SET_POINTER), "SetPointer",
-	(pXrdpMessageRead) freerds_read_set_pointer,
-	(pXrdpMessageWrite) freerds_write_set_pointer,
-	(pXrdpMessageCopy) freerds_set_pointer_copy,
-	(pXrdpMessageFree) freerds_set_pointer_free
-};
-
-/**
- * SetSystemPointer
- */
-
-int freerds_read_set_system_pointer(wStream* s, RDS_MSG_SET_SYSTEM_POINTER* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->ptrType);
-	return 0;
-}
-
-int freerds_write_set_system_pointer(wStream* s, RDS_MSG_SET_SYSTEM_POINTER* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) +
-			4;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->ptrType);
-	return 0;
-}
-
-void* freerds_set_system_pointer_copy(RDS_MSG_SET_SYSTEM_POINTER* msg)
-{
-	RDS_MSG_SET_SYSTEM_POINTER* dup = NULL;
-
-	dup = (RDS_MSG_SET_SYSTEM_POINTER*) malloc(sizeof(RDS_MSG_SET_SYSTEM_POINTER));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SET_SYSTEM_POINTER));
-
-	return (void*) dup;
-}
-
-void freerds_set_system_pointer_free(RDS_MSG_SET_SYSTEM_POINTER* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_SET_SYSTEM_POINTER_DEFINITION =
-{
-	sizeof(RDS_MSG_SET_SYSTEM_POINTER), "SetSystemPointer",
-	(pXrdpMessageRead) freerds_read_set_system_pointer,
-	(pXrdpMessageWrite) freerds_write_set_system_pointer,
-	(pXrdpMessageCopy) freerds_set_system_pointer_copy,
-	(pXrdpMessageFree) freerds_set_system_pointer_free
-};
-
-/**
- * SharedFramebuffer
- */
-
-int freerds_read_shared_framebuffer(wStream* s, RDS_MSG_SHARED_FRAMEBUFFER* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4 * 7)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->width);
-	Stream_Read_UINT32(s, msg->height);
-	Stream_Read_UINT32(s, msg->attach);
-	Stream_Read_UINT32(s, msg->scanline);
-	Stream_Read_UINT32(s, msg->segmentId);
-	Stream_Read_UINT32(s, msg->bitsPerPixel);
-	Stream_Read_UINT32(s, msg->bytesPerPixel);
-
-	return 0;
-}
-
-int freerds_write_shared_framebuffer(wStream* s, RDS_MSG_SHARED_FRAMEBUFFER* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 28;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->width);
-	Stream_Write_UINT32(s, msg->height);
-	Stream_Write_UINT32(s, msg->attach);
-	Stream_Write_UINT32(s, msg->scanline);
-	Stream_Write_UINT32(s, msg->segmentId);
-	Stream_Write_UINT32(s, msg->bitsPerPixel);
-	Stream_Write_UINT32(s, msg->bytesPerPixel);
-
-	return 0;
-}
-
-void* freerds_shared_framebuffer_copy(RDS_MSG_SHARED_FRAMEBUFFER* msg)
-{
-	RDS_MSG_SHARED_FRAMEBUFFER* dup = NULL;
-
-	dup = (RDS_MSG_SHARED_FRAMEBUFFER*) malloc(sizeof(RDS_MSG_SHARED_FRAMEBUFFER));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_SHARED_FRAMEBUFFER));
-
-	return (void*) dup;
-}
-
-void freerds_shared_framebuffer_free(RDS_MSG_SHARED_FRAMEBUFFER* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_SHARED_FRAMEBUFFER_DEFINITION =
-{
-	sizeof(RDS_MSG_SHARED_FRAMEBUFFER), "SharedFramebuffer",
-	(pXrdpMessageRead) freerds_read_shared_framebuffer,
-	(pXrdpMessageWrite) freerds_write_shared_framebuffer,
-	(pXrdpMessageCopy) freerds_shared_framebuffer_copy,
-	(pXrdpMessageFree) freerds_shared_framebuffer_free
-};
-
 /**
  * Beep
  */
@@ -1557,30 +724,6 @@ int freerds_write_beep(wStream* s, RDS_MSG_BEEP* msg)
 	return 0;
 }
 
-void* freerds_beep_copy(RDS_MSG_BEEP* msg)
-{
-	RDS_MSG_BEEP* dup = NULL;
-
-	dup = (RDS_MSG_BEEP*) malloc(sizeof(RDS_MSG_BEEP));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_BEEP));
-
-	return (void*) dup;
-}
-
-void freerds_beep_free(RDS_MSG_BEEP* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_BEEP_DEFINITION =
-{
-	sizeof(RDS_MSG_BEEP), "Beep",
-	(pXrdpMessageRead) freerds_read_beep,
-	(pXrdpMessageWrite) freerds_write_beep,
-	(pXrdpMessageCopy) freerds_beep_copy,
-	(pXrdpMessageFree) freerds_beep_free
-};
-
 /**
  * Reset
  */
@@ -1595,30 +738,6 @@ int freerds_write_reset(wStream* s, RDS_MSG_RESET* msg)
 	return 0;
 }
 
-void* freerds_reset_copy(RDS_MSG_RESET* msg)
-{
-	RDS_MSG_RESET* dup = NULL;
-
-	dup = (RDS_MSG_RESET*) malloc(sizeof(RDS_MSG_RESET));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_RESET));
-
-	return (void*) dup;
-}
-
-void freerds_reset_free(RDS_MSG_RESET* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_RESET_DEFINITION =
-{
-	sizeof(RDS_MSG_RESET), "Reset",
-	(pXrdpMessageRead) freerds_read_reset,
-	(pXrdpMessageWrite) freerds_write_reset,
-	(pXrdpMessageCopy) freerds_reset_copy,
-	(pXrdpMessageFree) freerds_reset_free
-};
-
 /**
  * WindowNewUpdate
  */
@@ -1826,83 +945,6 @@ int freerds_write_window_new_update(wStream* s, RDS_MSG_WINDOW_NEW_UPDATE* msg)
 	return 0;
 }
 
-void* freerds_window_new_update_copy(RDS_MSG_WINDOW_NEW_UPDATE* msg)
-{
-	RDS_MSG_WINDOW_NEW_UPDATE* dup = NULL;
-
-	dup = (RDS_MSG_WINDOW_NEW_UPDATE*) malloc(sizeof(RDS_MSG_WINDOW_NEW_UPDATE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_WINDOW_NEW_UPDATE));
-
-	return (void*) dup;
-}
-
-void freerds_window_new_update_free(RDS_MSG_WINDOW_NEW_UPDATE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_WINDOW_NEW_UPDATE_DEFINITION =
-{
-	sizeof(RDS_MSG_WINDOW_NEW_UPDATE), "WindowNewUpdate",
-	(pXrdpMessageRead) freerds_read_window_new_update,
-	(pXrdpMessageWrite) freerds_write_window_new_update,
-	(pXrdpMessageCopy) freerds_window_new_update_copy,
-	(pXrdpMessageFree) freerds_window_new_update_free
-};
-
-/**
- * WindowDelete
- */
-
-int freerds_read_window_delete(wStream* s, RDS_MSG_WINDOW_DELETE* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->windowId);
-
-	return 0;
-}
-
-int freerds_write_window_delete(wStream* s, RDS_MSG_WINDOW_DELETE* msg)
-{
-	msg->msgFlags = 0;
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 4;
-
-	if (!s)
-		return msg->length;
-
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
-
-	Stream_Write_UINT32(s, msg->windowId);
-
-	return 0;
-}
-
-void* freerds_window_delete_copy(RDS_MSG_WINDOW_DELETE* msg)
-{
-	RDS_MSG_WINDOW_DELETE* dup = NULL;
-
-	dup = (RDS_MSG_WINDOW_DELETE*) malloc(sizeof(RDS_MSG_WINDOW_DELETE));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_WINDOW_DELETE));
-
-	return (void*) dup;
-}
-
-void freerds_window_delete_free(RDS_MSG_WINDOW_DELETE* msg)
-{
-	free(msg);
-}
-
-static RDS_MSG_DEFINITION RDS_MSG_WINDOW_DELETE_DEFINITION =
-{
-	sizeof(RDS_MSG_WINDOW_DELETE), "WindowDelete",
-	(pXrdpMessageRead) freerds_read_window_delete,
-	(pXrdpMessageWrite) freerds_write_window_delete,
-	(pXrdpMessageCopy) freerds_window_delete_copy,
-	(pXrdpMessageFree) freerds_window_delete_free
-};
-
 /**
  * LogonUser
  */
@@ -2019,114 +1061,100 @@ void freerds_logon_user_free(RDS_MSG_LOGON_USER* msg)
 	free(msg);
 }
 
-static RDS_MSG_DEFINITION RDS_MSG_LOGON_USER_DEFINITION =
-{
-	sizeof(RDS_MSG_LOGON_USER), "LogonUser",
-	(pXrdpMessageRead) freerds_read_logon_user,
-	(pXrdpMessageWrite) freerds_write_logon_user,
-	(pXrdpMessageCopy) freerds_logon_user_copy,
-	(pXrdpMessageFree) freerds_logon_user_free
-};
-
 /**
- * LogoffUser
+ * Message Definitions
  */
 
-int freerds_read_logoff_user(wStream* s, RDS_MSG_LOGOFF_USER* msg)
-{
-	if (Stream_GetRemainingLength(s) < 4)
-		return -1;
-
-	Stream_Read_UINT32(s, msg->Flags);
-
-	return 0;
-}
-
-int freerds_write_logoff_user(wStream* s, RDS_MSG_LOGOFF_USER* msg)
-{
-	msg->msgFlags = 0;
+#define RDS_MSG_COPY_FLAT(_name)	NULL
+#define RDS_MSG_COPY_DEEP(_name)	(pXrdpMessageCopy) freerds_##_name##_copy
+#define RDS_MSG_FREE_FLAT(_name)	NULL
+#define RDS_MSG_FREE_DEEP(_name)	(pXrdpMessageFree) freerds_##_name##_free
+
+#define RDS_MSG_DEFINE(_M, _Name, _name, _copy, _call) \
+	static RDS_MSG_DEFINITION _M##_DEFINITION = \
+	{ \
+		sizeof(_M), #_Name, \
+		(pXrdpMessageRead) freerds_read_##_name, \
+		(pXrdpMessageWrite) freerds_write_##_name, \
+		RDS_MSG_COPY_##_copy(_name), \
+		RDS_MSG_FREE_##_copy(_name), \
+		(pXrdpMessageCall) _call \
+	};
+
+#define RDS_SERVER_MSG_CALL(_T, _Name, _name, _codec, _copy) \
+	static int freerds_server_call_##_name(rdsServerInterface* server, rdsModuleConnector* connector, RDS_MSG_##_T* msg) \
+	{ \
+		if (!server->_Name) \
+			return 0; \
+		return server->_Name(connector, msg); \
+	} \
+	RDS_MSG_DEFINE(RDS_MSG_##_T, _Name, _name, _copy, freerds_server_call_##_name)
+
+#define RDS_CLIENT_MSG_CALL(_T, _Name, _name, _codec, _copy, _args) \
+	static int freerds_client_call_##_name(rdsClientInterface* client, rdsModuleConnector* connector, RDS_MSG_##_T* msg) \
+	{ \
+		if (!client->_Name) \
+			return 0; \
+		return client->_Name _args; \
+	} \
+	RDS_MSG_DEFINE(RDS_MSG_##_T, _Name, _name, _copy, freerds_client_call_##_name)
+
+#define RDS_MSG_NO_CALL(_T, _Name, _name, _codec, _copy) \
+	RDS_MSG_DEFINE(RDS_MSG_##_T, _Name, _name, _copy, NULL)
+
+RDS_SERVER_MSG_SCHEMA(RDS_SERVER_MSG_CALL, RDS_MSG_NO_CALL)
+RDS_CLIENT_MSG_SCHEMA(RDS_CLIENT_MSG_CALL, RDS_MSG_NO_CALL)
 
-	msg->length = freerds_write_common_header(NULL, (RDS_MSG_COMMON*) msg) + 4;
+/**
+ * Dispatch Tables
+ */
 
-	if (!s)
-		return msg->length;
+#define RDS_SERVER_MSG_TABLE_ENTRY(_T, ...) \
+	[RDS_SERVER_##_T] = &RDS_MSG_##_T##_DEFINITION,
 
-	freerds_write_common_header(s, (RDS_MSG_COMMON*) msg);
+#define RDS_CLIENT_MSG_TABLE_ENTRY(_T, ...) \
+	[RDS_CLIENT_##_T - RDS_CLIENT_MSG_BASE] = &RDS_MSG_##_T##_DEFINITION,
 
-	Stream_Write_UINT32(s, msg->Flags);
+#define RDS_SERVER_MSG_COUNT	32
+#define RDS_CLIENT_MSG_BASE	100
+#define RDS_CLIENT_MSG_COUNT	16
 
-	return 0;
-}
+static RDS_MSG_DEFINITION* RDS_SERVER_MSG_DEFINITIONS[RDS_SERVER_MSG_COUNT] =
+{
+	RDS_SERVER_MSG_SCHEMA(RDS_SERVER_MSG_TABLE_ENTRY, RDS_SERVER_MSG_TABLE_ENTRY)
+};
 
-void* freerds_logoff_user_copy(RDS_MSG_LOGOFF_USER* msg)
+static RDS_MSG_DEFINITION* RDS_CLIENT_MSG_DEFINITIONS[RDS_CLIENT_MSG_COUNT] =
 {
-	RDS_MSG_LOGOFF_USER* dup = NULL;
+	RDS_CLIENT_MSG_SCHEMA(RDS_CLIENT_MSG_TABLE_ENTRY, RDS_CLIENT_MSG_TABLE_ENTRY)
+	[RDS_CLIENT_TRANSPORT - RDS_CLIENT_MSG_BASE] = &RDS_MSG_TRANSPORT_DEFINITION
+};
 
-	dup = (RDS_MSG_LOGOFF_USER*) malloc(sizeof(RDS_MSG_LOGOFF_USER));
-	CopyMemory(dup, msg, sizeof(RDS_MSG_LOGOFF_USER));
+static RDS_MSG_DEFINITION* freerds_server_message_definition(UINT32 type)
+{
+	if (type >= RDS_SERVER_MSG_COUNT)
+		return NULL;
 
-	return (void*) dup;
+	return RDS_SERVER_MSG_DEFINITIONS[type];
 }
 
-void freerds_logoff_user_free(RDS_MSG_LOGOFF_USER* msg)
+static RDS_MSG_DEFINITION* freerds_client_message_definition(UINT32 type)
 {
-	free(msg);
-}
+	if ((type < RDS_CLIENT_MSG_BASE) || (type >= RDS_CLIENT_MSG_BASE + RDS_CLIENT_MSG_COUNT))
+		return NULL;
 
-static RDS_MSG_DEFINITION RDS_MSG_LOGOFF_USER_DEFINITION =
-{
-	sizeof(RDS_MSG_LOGOFF_USER), "LogoffUser",
-	(pXrdpMessageRead) freerds_read_logoff_user,
-	(pXrdpMessageWrite) freerds_write_logoff_user,
-	(pXrdpMessageCopy) freerds_logoff_user_copy,
-	(pXrdpMessageFree) freerds_logoff_user_free
-};
+	return RDS_CLIENT_MSG_DEFINITIONS[type - RDS_CLIENT_MSG_BASE];
+}
 
 /**
  * Generic Functions
  */
 
-static RDS_MSG_DEFINITION* RDS_SERVER_MSG_DEFINITIONS[32] =
-{
-	NULL, /* 0 */
-	&RDS_MSG_BEGIN_UPDATE_DEFINITION, /* 1 */
-	&RDS_MSG_END_UPDATE_DEFINITION, /* 2 */
-	&RDS_MSG_SET_CLIPPING_REGION_DEFINITION, /* 3 */
-	&RDS_MSG_OPAQUE_RECT_DEFINITION, /* 4 */
-	&RDS_MSG_SCREEN_BLT_DEFINITION, /* 5 */
-	&RDS_MSG_PAINT_RECT_DEFINITION, /* 6 */
-	&RDS_MSG_PATBLT_DEFINITION, /* 7 */
-	&RDS_MSG_DSTBLT_DEFINITION, /* 8 */
-	&RDS_MSG_LINE_TO_DEFINITION, /* 9 */
-	&RDS_MSG_CREATE_OFFSCREEN_SURFACE_DEFINITION, /* 10 */
-	&RDS_MSG_SWITCH_OFFSCREEN_SURFACE_DEFINITION, /* 11 */
-	&RDS_MSG_DELETE_OFFSCREEN_SURFACE_DEFINITION, /* 12 */
-	&RDS_MSG_PAINT_OFFSCREEN_SURFACE_DEFINITION, /* 13 */
-	&RDS_MSG_SET_PALETTE_DEFINITION, /* 14 */
-	&RDS_MSG_CACHE_GLYPH_DEFINITION, /* 15 */
-	&RDS_MSG_GLYPH_INDEX_DEFINITION, /* 16 */
-	&RDS_MSG_SET_POINTER_DEFINITION, /* 17 */
-	&RDS_MSG_SHARED_FRAMEBUFFER_DEFINITION, /* 18 */
-	&RDS_MSG_BEEP_DEFINITION, /* 19 */
-	&RDS_MSG_RESET_DEFINITION, /* 20 */
-	&RDS_MSG_WINDOW_NEW_UPDATE_DEFINITION, /* 21 */
-	&RDS_MSG_WINDOW_DELETE_DEFINITION, /* 22 */
-	&RDS_MSG_SET_SYSTEM_POINTER_DEFINITION, /* 23 */
-	&RDS_MSG_LOGON_USER_DEFINITION, /* 24 */
-	&RDS_MSG_LOGOFF_USER_DEFINITION, /* 25 */
-	NULL, /* 26 */
-	NULL, /* 27 */
-	NULL, /* 28 */
-	NULL, /* 29 */
-	NULL, /* 30 */
-	NULL /* 31 */
-};
-
 int freerds_server_message_size(UINT32 type)
 {
 	RDS_MSG_DEFINITION* msgDef;
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[type];
+	msgDef = freerds_server_message_definition(type);
 
 	if (msgDef)
 	{
@@ -2141,7 +1169,7 @@ char* freerds_server_message_name(UINT32 type)
 {
 	RDS_MSG_DEFINITION* msgDef;
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[type];
+	msgDef = freerds_server_message_definition(type);
 
 	if (msgDef)
 	{
@@ -2157,7 +1185,7 @@ int freerds_server_message_read(wStream* s, RDS_MSG_COMMON* msg)
 	int status = 0;
 	RDS_MSG_DEFINITION* msgDef;
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[msg->type];
+	msgDef = freerds_server_message_definition(msg->type);
 
 	if (msgDef)
 	{
@@ -2172,19 +1200,16 @@ int freerds_server_message_write(wStream* s, RDS_MSG_COMMON* msg)
 {
 	RDS_MSG_DEFINITION* msgDef;
 
-	if (msg->type > 31)
+	msgDef = freerds_server_message_definition(msg->type);
+
+	if (!msgDef)
 	{
 		fprintf(stderr, "unable to treat message type %d\n", msg->type);
 		return 0;
 	}
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[msg->type];
-
-	if (msgDef)
-	{
-		if (msgDef->Write)
-			msgDef->Write(s, msg);
-	}
+	if (msgDef->Write)
+		msgDef->Write(s, msg);
 
 	return msg->length;
 }
@@ -2194,13 +1219,18 @@ void* freerds_server_message_copy(RDS_MSG_COMMON* msg)
 	void* dup = NULL;
 	RDS_MSG_DEFINITION* msgDef;
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[msg->type];
+	msgDef = freerds_server_message_definition(msg->type);
 
-	if (msgDef)
-	{
-		if (msgDef->Copy)
-			dup = msgDef->Copy(msg);
-	}
+	if (!msgDef)
+		return NULL;
+
+	if (msgDef->Copy)
+		return msgDef->Copy(msg);
+
+	dup = malloc(msgDef->Size);
+
+	if (dup)
+		CopyMemory(dup, msg, msgDef->Size);
 
 	return dup;
 }
@@ -2209,11 +1239,58 @@ void freerds_server_message_free(RDS_MSG_COMMON* msg)
 {
 	RDS_MSG_DEFINITION* msgDef;
 
-	msgDef = RDS_SERVER_MSG_DEFINITIONS[msg->type];
+	msgDef = freerds_server_message_definition(msg->type);
+
+	if (!msgDef)
+		return;
+
+	if (msgDef->Free)
+		msgDef->Free(msg);
+	else
+		free(msg);
+}
+
+/**
+ * Calls the interface member for the message type, dropping
+ * messages for which there is none.
+ */
+
+int freerds_server_message_call(rdsServerInterface* server, rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
+{
+	RDS_MSG_DEFINITION* msgDef;
+
+	msgDef = freerds_server_message_definition(msg->type);
+
+	if (!msgDef || !msgDef->Call)
+		return 0;
+
+	return msgDef->Call(server, connector, msg);
+}
+
+int freerds_client_message_read(wStream* s, RDS_MSG_COMMON* msg)
+{
+	int status = 0;
+	RDS_MSG_DEFINITION* msgDef;
+
+	msgDef = freerds_client_message_definition(msg->type);
 
 	if (msgDef)
 	{
-		if (msgDef->Free)
-			msgDef->Free(msg);
+		if (msgDef->Read)
+			status = msgDef->Read(s, msg);
 	}
+
+	return status;
+}
+
+int freerds_client_message_call(rdsClientInterface* client, rdsModuleConnector* connector, RDS_MSG_COMMON* msg)
+{
+	RDS_MSG_DEFINITION* msgDef;
+
+	msgDef = freerds_client_message_definition(msg->type);
+
+	if (!msgDef || !msgDef->Call)
+		return 0;
+
+	return msgDef->Call(client, connector, msg);
 }
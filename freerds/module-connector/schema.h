@@ -0,0 +1,220 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDS Message Schema
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_SCHEMA_H
+#define RDS_NG_SCHEMA_H
+
+/**
+ * Every message type is listed once here, and protocol.c expands the lists
+ * into its message definitions and the dispatch tables indexed by type.
+ *
+ * X(TYPE, Name, name, codec, copy[, args]) is a message dispatched to the
+ * member Name of the server or client interface, Y(TYPE, Name, name, codec,
+ * copy) one that is only serialized. TYPE names both RDS_SERVER_TYPE or
+ * RDS_CLIENT_TYPE and RDS_MSG_TYPE, and name the freerds_read_name and
+ * freerds_write_name functions.
+ *
+ * codec is FIELDS when the message is serialized from its field list
+ * below, RECT when the first four of those fields are also sent as the
+ * header rectangle, and CUSTOM when the read and write functions are
+ * written by hand.
+ *
+ * copy is FLAT when the message is copied and freed as a single block,
+ * and DEEP when freerds_name_copy and freerds_name_free are written by
+ * hand for out-of-line data.
+ *
+ * Client interface members take the message fields as arguments, which
+ * args lists in terms of connector and msg.
+ *
+ * TRANSPORT is sent in both directions and only listed once, on the server
+ * side; RDS_CLIENT_TRANSPORT shares its definition.
+ */
+
+#define RDS_SERVER_MSG_SCHEMA(X, Y) \
+	X(BEGIN_UPDATE, BeginUpdate, begin_update, FIELDS, FLAT) \
+	X(END_UPDATE, EndUpdate, end_update, FIELDS, FLAT) \
+	X(SET_CLIPPING_REGION, SetClippingRegion, set_clipping_region, FIELDS, FLAT) \
+	X(OPAQUE_RECT, OpaqueRect, opaque_rect, RECT, FLAT) \
+	X(SCREEN_BLT, ScreenBlt, screen_blt, RECT, FLAT) \
+	X(PAINT_RECT, PaintRect, paint_rect, CUSTOM, DEEP) \
+	X(PATBLT, PatBlt, patblt, CUSTOM, FLAT) \
+	X(DSTBLT, DstBlt, dstblt, RECT, FLAT) \
+	X(LINE_TO, LineTo, line_to, FIELDS, FLAT) \
+	X(CREATE_OFFSCREEN_SURFACE, CreateOffscreenSurface, create_offscreen_surface, FIELDS, FLAT) \
+	X(SWITCH_OFFSCREEN_SURFACE, SwitchOffscreenSurface, switch_offscreen_surface, FIELDS, FLAT) \
+	X(DELETE_OFFSCREEN_SURFACE, DeleteOffscreenSurface, delete_offscreen_surface, FIELDS, FLAT) \
+	X(PAINT_OFFSCREEN_SURFACE, PaintOffscreenSurface, paint_offscreen_surface, FIELDS, FLAT) \
+	X(SET_PALETTE, SetPalette, set_palette, CUSTOM, FLAT) \
+	X(CACHE_GLYPH, CacheGlyph, cache_glyph, CUSTOM, FLAT) \
+	X(GLYPH_INDEX, GlyphIndex, glyph_index, CUSTOM, DEEP) \
+	X(SET_POINTER, SetPointer, set_pointer, CUSTOM, DEEP) \
+	X(SHARED_FRAMEBUFFER, SharedFramebuffer, shared_framebuffer, FIELDS, FLAT) \
+	X(BEEP, Beep, beep, CUSTOM, FLAT) \
+	X(RESET, Reset, reset, CUSTOM, FLAT) \
+	X(WINDOW_NEW_UPDATE, WindowNewUpdate, window_new_update, CUSTOM, FLAT) \
+	X(WINDOW_DELETE, WindowDelete, window_delete, FIELDS, FLAT) \
+	X(SET_SYSTEM_POINTER, SetSystemPointer, set_system_pointer, FIELDS, FLAT) \
+	X(LOGON_USER, LogonUser, logon_user, CUSTOM, DEEP) \
+	X(LOGOFF_USER, LogoffUser, logoff_user, FIELDS, FLAT) \
+	Y(TRANSPORT, Transport, transport, FIELDS, FLAT)
+
+#define RDS_CLIENT_MSG_SCHEMA(X, Y) \
+	Y(CAPABILITIES, Capabilities, capabilities, FIELDS, FLAT) \
+	Y(REFRESH_RECT, RefreshRect, refresh_rect, CUSTOM, FLAT) \
+	X(SYNCHRONIZE_KEYBOARD_EVENT, SynchronizeKeyboardEvent, synchronize_keyboard_event, FIELDS, FLAT, \
+			(connector, msg->flags)) \
+	X(SCANCODE_KEYBOARD_EVENT, ScancodeKeyboardEvent, scancode_keyboard_event, FIELDS, FLAT, \
+			(connector, msg->flags, msg->code, msg->keyboardType)) \
+	X(VIRTUAL_KEYBOARD_EVENT, VirtualKeyboardEvent, virtual_keyboard_event, FIELDS, FLAT, \
+			(connector, msg->flags, msg->code)) \
+	X(UNICODE_KEYBOARD_EVENT, UnicodeKeyboardEvent, unicode_keyboard_event, FIELDS, FLAT, \
+			(connector, msg->flags, msg->code)) \
+	X(MOUSE_EVENT, MouseEvent, mouse_event, FIELDS, FLAT, \
+			(connector, msg->flags, msg->x, msg->y)) \
+	X(EXTENDED_MOUSE_EVENT, ExtendedMouseEvent, extended_mouse_event, FIELDS, FLAT, \
+			(connector, msg->flags, msg->x, msg->y)) \
+	X(VBLANK_EVENT, VBlankEvent, vblank_event, FIELDS, FLAT, \
+			(connector))
+
+/**
+ * Field lists, in wire order, as F(RDS_MSG_TYPE, wire type, member).
+ * Members are 32-bit integers, sent as UINT16 or UINT32.
+ */
+
+#define RDS_MSG_BEGIN_UPDATE_FIELDS(F, S)
+
+#define RDS_MSG_END_UPDATE_FIELDS(F, S)
+
+#define RDS_MSG_SET_CLIPPING_REGION_FIELDS(F, S) \
+	F(S, UINT16, bNullRegion) \
+	F(S, UINT16, nLeftRect) \
+	F(S, UINT16, nTopRect) \
+	F(S, UINT16, nWidth) \
+	F(S, UINT16, nHeight)
+
+#define RDS_MSG_OPAQUE_RECT_FIELDS(F, S) \
+	F(S, UINT16, nLeftRect) \
+	F(S, UINT16, nTopRect) \
+	F(S, UINT16, nWidth) \
+	F(S, UINT16, nHeight) \
+	F(S, UINT32, color)
+
+#define RDS_MSG_SCREEN_BLT_FIELDS(F, S) \
+	F(S, UINT16, nLeftRect) \
+	F(S, UINT16, nTopRect) \
+	F(S, UINT16, nWidth) \
+	F(S, UINT16, nHeight) \
+	F(S, UINT16, nXSrc) \
+	F(S, UINT16, nYSrc)
+
+#define RDS_MSG_DSTBLT_FIELDS(F, S) \
+	F(S, UINT32, nLeftRect) \
+	F(S, UINT32, nTopRect) \
+	F(S, UINT32, nWidth) \
+	F(S, UINT32, nHeight) \
+	F(S, UINT32, bRop)
+
+#define RDS_MSG_LINE_TO_FIELDS(F, S) \
+	F(S, UINT32, nXStart) \
+	F(S, UINT32, nYStart) \
+	F(S, UINT32, nXEnd) \
+	F(S, UINT32, nYEnd) \
+	F(S, UINT32, bRop2) \
+	F(S, UINT32, penStyle) \
+	F(S, UINT32, penWidth) \
+	F(S, UINT32, penColor)
+
+#define RDS_MSG_CREATE_OFFSCREEN_SURFACE_FIELDS(F, S) \
+	F(S, UINT32, cacheIndex) \
+	F(S, UINT16, nWidth) \
+	F(S, UINT16, nHeight)
+
+#define RDS_MSG_SWITCH_OFFSCREEN_SURFACE_FIELDS(F, S) \
+	F(S, UINT32, cacheIndex)
+
+#define RDS_MSG_DELETE_OFFSCREEN_SURFACE_FIELDS(F, S) \
+	F(S, UINT32, cacheIndex)
+
+#define RDS_MSG_PAINT_OFFSCREEN_SURFACE_FIELDS(F, S) \
+	F(S, UINT32, cacheIndex) \
+	F(S, UINT32, nLeftRect) \
+	F(S, UINT32, nTopRect) \
+	F(S, UINT32, nWidth) \
+	F(S, UINT32, nHeight) \
+	F(S, UINT32, nXSrc) \
+	F(S, UINT32, nYSrc) \
+	F(S, UINT32, bRop)
+
+#define RDS_MSG_SHARED_FRAMEBUFFER_FIELDS(F, S) \
+	F(S, UINT32, width) \
+	F(S, UINT32, height) \
+	F(S, UINT32, attach) \
+	F(S, UINT32, scanline) \
+	F(S, UINT32, segmentId) \
+	F(S, UINT32, bitsPerPixel) \
+	F(S, UINT32, bytesPerPixel)
+
+#define RDS_MSG_WINDOW_DELETE_FIELDS(F, S) \
+	F(S, UINT32, windowId)
+
+#define RDS_MSG_SET_SYSTEM_POINTER_FIELDS(F, S) \
+	F(S, UINT32, ptrType)
+
+#define RDS_MSG_LOGOFF_USER_FIELDS(F, S) \
+	F(S, UINT32, Flags)
+
+#define RDS_MSG_TRANSPORT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, segmentId) \
+	F(S, UINT32, size)
+
+#define RDS_MSG_CAPABILITIES_FIELDS(F, S) \
+	F(S, UINT32, DesktopWidth) \
+	F(S, UINT32, DesktopHeight) \
+	F(S, UINT32, ColorDepth)
+
+#define RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags)
+
+#define RDS_MSG_SCANCODE_KEYBOARD_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, code) \
+	F(S, UINT32, keyboardType)
+
+#define RDS_MSG_VIRTUAL_KEYBOARD_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, code)
+
+#define RDS_MSG_UNICODE_KEYBOARD_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, code)
+
+#define RDS_MSG_MOUSE_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, x) \
+	F(S, UINT32, y)
+
+#define RDS_MSG_EXTENDED_MOUSE_EVENT_FIELDS(F, S) \
+	F(S, UINT32, flags) \
+	F(S, UINT32, x) \
+	F(S, UINT32, y)
+
+#define RDS_MSG_VBLANK_EVENT_FIELDS(F, S)
+
+#endif /* RDS_NG_SCHEMA_H */
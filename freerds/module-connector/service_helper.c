@@ -25,6 +25,8 @@
 #include <freerds/service_helper.h>
 #include <winpr/synch.h>
 
+#include "shm.h"
+
 void* freerds_service_client_thread(void* arg)
 {
 	rdsModuleConnector* connector;
@@ -157,6 +159,8 @@ void freerds_service_free(rdsService* service)
 		Stream_Free(connector->OutboundStream, TRUE);
 		Stream_Free(connector->InboundStream, TRUE);
 
+		freerds_shm_transport_free(connector->ShmTransport);
+
 		if (connector->Endpoint)
 			free(connector->Endpoint);
 
@@ -0,0 +1,284 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared Memory Transport
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/shm.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+/**
+ * Ring indices are free-running byte counters. The producer owns head and
+ * the consumer owns tail; each reads the other's index with a full barrier,
+ * so ring contents are published before the index that makes them visible,
+ * and a producer that finds the ring empty after publishing its head knows
+ * the consumer may have gone idle and needs a signal.
+ */
+
+static UINT32 freerds_shm_ring_load(volatile LONG* index)
+{
+	return (UINT32) InterlockedCompareExchange(index, 0, 0);
+}
+
+static rdsShmTransport* freerds_shm_transport_new(int segmentId, BYTE* segment, UINT32 size, BOOL serverMode)
+{
+	rdsShmTransport* shm;
+
+	shm = (rdsShmTransport*) calloc(1, sizeof(rdsShmTransport));
+
+	if (!shm)
+		return NULL;
+
+	shm->segmentId = segmentId;
+	shm->size = size;
+	shm->header = (rdsShmHeader*) segment;
+
+	shm->data[RDS_SHM_RING_SERVER] = &segment[sizeof(rdsShmHeader)];
+	shm->data[RDS_SHM_RING_CLIENT] = &segment[sizeof(rdsShmHeader) + size];
+
+	shm->output = serverMode ? RDS_SHM_RING_SERVER : RDS_SHM_RING_CLIENT;
+	shm->input = serverMode ? RDS_SHM_RING_CLIENT : RDS_SHM_RING_SERVER;
+
+	shm->stream = Stream_New(shm->data[shm->input], size);
+	shm->carry = Stream_New(NULL, 8192);
+
+	if (!shm->stream || !shm->carry)
+	{
+		if (shm->stream)
+			Stream_Free(shm->stream, FALSE);
+
+		if (shm->carry)
+			Stream_Free(shm->carry, TRUE);
+
+		free(shm);
+		return NULL;
+	}
+
+	return shm;
+}
+
+rdsShmTransport* freerds_shm_transport_create(BOOL serverMode)
+{
+	int segmentId;
+	BYTE* segment;
+	rdsShmTransport* shm;
+
+	segmentId = shmget(IPC_PRIVATE, sizeof(rdsShmHeader) + (2 * RDS_SHM_RING_SIZE),
+			IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR);
+
+	if (segmentId == -1)
+	{
+		fprintf(stderr, "%s: shmget failed\n", __FUNCTION__);
+		return NULL;
+	}
+
+	segment = (BYTE*) shmat(segmentId, 0, 0);
+
+	if (segment == (BYTE*) -1)
+	{
+		fprintf(stderr, "%s: shmat failed\n", __FUNCTION__);
+		shmctl(segmentId, IPC_RMID, 0);
+		return NULL;
+	}
+
+	ZeroMemory(segment, sizeof(rdsShmHeader));
+	((rdsShmHeader*) segment)->magic = RDS_SHM_MAGIC;
+	((rdsShmHeader*) segment)->size = RDS_SHM_RING_SIZE;
+
+	shm = freerds_shm_transport_new(segmentId, segment, RDS_SHM_RING_SIZE, serverMode);
+
+	if (!shm)
+	{
+		shmdt(segment);
+		shmctl(segmentId, IPC_RMID, 0);
+		return NULL;
+	}
+
+	shm->owner = TRUE;
+
+	return shm;
+}
+
+rdsShmTransport* freerds_shm_transport_attach(int segmentId, UINT32 size, BOOL serverMode)
+{
+	BYTE* segment;
+	rdsShmHeader* header;
+	rdsShmTransport* shm;
+	struct shmid_ds info;
+
+	if (!size || (size & (size - 1)) || (size > RDS_SHM_RING_SIZE))
+	{
+		fprintf(stderr, "%s: invalid ring size %d\n", __FUNCTION__, size);
+		return NULL;
+	}
+
+	if (shmctl(segmentId, IPC_STAT, &info) != 0)
+		return NULL;
+
+	if (info.shm_segsz < (sizeof(rdsShmHeader) + (2 * (size_t) size)))
+	{
+		fprintf(stderr, "%s: segment %d is too small\n", __FUNCTION__, segmentId);
+		return NULL;
+	}
+
+	segment = (BYTE*) shmat(segmentId, 0, 0);
+
+	if (segment == (BYTE*) -1)
+	{
+		fprintf(stderr, "%s: shmat failed\n", __FUNCTION__);
+		return NULL;
+	}
+
+	header = (rdsShmHeader*) segment;
+
+	if ((header->magic != RDS_SHM_MAGIC) || (header->size != size))
+	{
+		fprintf(stderr, "%s: segment %d is not a transport segment\n", __FUNCTION__, segmentId);
+		shmdt(segment);
+		return NULL;
+	}
+
+	shm = freerds_shm_transport_new(segmentId, segment, size, serverMode);
+
+	if (!shm)
+		shmdt(segment);
+
+	return shm;
+}
+
+/**
+ * Marks the segment for removal once both sides are attached,
+ * so that it goes away with the last process to detach.
+ */
+
+void freerds_shm_transport_release_segment(rdsShmTransport* shm)
+{
+	if (!shm || !shm->owner || shm->removed)
+		return;
+
+	shmctl(shm->segmentId, IPC_RMID, 0);
+	shm->removed = TRUE;
+}
+
+void freerds_shm_transport_free(rdsShmTransport* shm)
+{
+	if (!shm)
+		return;
+
+	Stream_Free(shm->stream, FALSE);
+	Stream_Free(shm->carry, TRUE);
+
+	shmdt(shm->header);
+	freerds_shm_transport_release_segment(shm);
+
+	free(shm);
+}
+
+/**
+ * Copies as much of the data as the output ring has room for, returning
+ * the number of bytes written. signal is set to TRUE if the ring was
+ * empty, in which case the consumer has to be woken up.
+ */
+
+int freerds_shm_transport_write(rdsShmTransport* shm, BYTE* data, UINT32 length, BOOL* signal)
+{
+	BYTE* ring;
+	UINT32 head;
+	UINT32 tail;
+	UINT32 offset;
+	UINT32 count;
+	UINT32 first;
+	rdsShmRing* header;
+
+	header = &(shm->header->rings[shm->output]);
+	ring = shm->data[shm->output];
+
+	head = (UINT32) header->head;
+	tail = freerds_shm_ring_load(&header->tail);
+
+	count = shm->size - (head - tail);
+
+	if (length < count)
+		count = length;
+
+	if (!count)
+		return 0;
+
+	offset = head & (shm->size - 1);
+	first = shm->size - offset;
+
+	if (first > count)
+		first = count;
+
+	CopyMemory(&ring[offset], data, first);
+
+	if (count > first)
+		CopyMemory(ring, &data[first], count - first);
+
+	InterlockedExchange(&header->head, (LONG) (head + count));
+
+	if (freerds_shm_ring_load(&header->tail) == head)
+		*signal = TRUE;
+
+	return count;
+}
+
+/**
+ * Returns the number of bytes that can be read contiguously from the input
+ * ring, which ends either at the producer's head or at the end of the ring.
+ */
+
+UINT32 freerds_shm_transport_read(rdsShmTransport* shm, BYTE** data)
+{
+	UINT32 head;
+	UINT32 tail;
+	UINT32 offset;
+	UINT32 count;
+	rdsShmRing* header;
+
+	header = &(shm->header->rings[shm->input]);
+
+	tail = (UINT32) header->tail;
+	head = freerds_shm_ring_load(&header->head);
+
+	count = head - tail;
+	offset = tail & (shm->size - 1);
+
+	if (count > (shm->size - offset))
+		count = shm->size - offset;
+
+	*data = &(shm->data[shm->input][offset]);
+
+	return count;
+}
+
+void freerds_shm_transport_consume(rdsShmTransport* shm, UINT32 length)
+{
+	rdsShmRing* header;
+
+	header = &(shm->header->rings[shm->input]);
+
+	InterlockedExchange(&header->tail, (LONG) (((UINT32) header->tail) + length));
+}
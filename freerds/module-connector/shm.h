@@ -0,0 +1,94 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared Memory Transport
+ *
+ * Copyright 2013 Marc-Andre Moreau <marcandre.moreau@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RDS_NG_SHM_H
+#define RDS_NG_SHM_H
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/interlocked.h>
+
+#include <freerds/freerds.h>
+
+#define RDS_SHM_MAGIC			0x54534452 /* "RDST" */
+#define RDS_SHM_RING_SIZE		(4 * 1024 * 1024)
+#define RDS_SHM_WRITE_TIMEOUT		5000
+
+#define RDS_SHM_RING_SERVER		0
+#define RDS_SHM_RING_CLIENT		1
+
+/**
+ * Shared memory segment holding one single-producer, single-consumer byte
+ * ring per direction: server messages from the session module to freerds,
+ * and client messages back.
+ *
+ * The rings carry the same message stream as the pipe. Messages are read
+ * in place, except for the few that straddle the end of a ring or were only
+ * partially written, which are reassembled in a separate stream. The pipe
+ * then only carries signals, sent by the producer when a ring goes from
+ * empty to non-empty.
+ */
+
+struct rds_shm_ring
+{
+	/* written by the producer only */
+	volatile LONG head;
+	BYTE pad0[64 - sizeof(LONG)];
+
+	/* written by the consumer only */
+	volatile LONG tail;
+	BYTE pad1[64 - sizeof(LONG)];
+};
+typedef struct rds_shm_ring rdsShmRing;
+
+struct rds_shm_header
+{
+	UINT32 magic;
+	UINT32 size;
+	BYTE pad[64 - (2 * sizeof(UINT32))];
+	rdsShmRing rings[2];
+};
+typedef struct rds_shm_header rdsShmHeader;
+
+struct rds_shm_transport
+{
+	int segmentId;
+	BOOL owner;
+	BOOL removed;
+	BOOL active;
+	UINT32 size;
+	rdsShmHeader* header;
+	BYTE* data[2];
+	int input;
+	int output;
+	wStream* stream;
+	wStream* carry;
+};
+
+rdsShmTransport* freerds_shm_transport_create(BOOL serverMode);
+rdsShmTransport* freerds_shm_transport_attach(int segmentId, UINT32 size, BOOL serverMode);
+void freerds_shm_transport_free(rdsShmTransport* shm);
+
+void freerds_shm_transport_release_segment(rdsShmTransport* shm);
+
+int freerds_shm_transport_write(rdsShmTransport* shm, BYTE* data, UINT32 length, BOOL* signal);
+UINT32 freerds_shm_transport_read(rdsShmTransport* shm, BYTE** data);
+void freerds_shm_transport_consume(rdsShmTransport* shm, UINT32 length);
+
+#endif /* RDS_NG_SHM_H */
@@ -30,7 +30,12 @@
 #include <winpr/print.h>
 #include <winpr/thread.h>
 
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
 #include "protocol.h"
+#include "shm.h"
 
 #include "transport.h"
 
@@ -81,6 +86,167 @@ int freerds_named_pipe_write(HANDLE hNamedPipe, BYTE* data, DWORD length)
 	return TotalNumberOfBytesWritten;
 }
 
+/**
+ * Writes as much as the pipe accepts without blocking,
+ * returning the number of bytes written, or -1 on error.
+ */
+
+int freerds_named_pipe_write_nonblocking(HANDLE hNamedPipe, BYTE* data, DWORD length)
+{
+	int fd;
+	ssize_t status;
+	DWORD TotalNumberOfBytesWritten = 0;
+
+	fd = GetNamePipeFileDescriptor(hNamedPipe);
+
+	if (fd < 0)
+		return -1;
+
+	while (length > 0)
+	{
+		status = send(fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+		if (status < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+
+			return -1;
+		}
+
+		if (status == 0)
+			break;
+
+		TotalNumberOfBytesWritten += status;
+		length -= status;
+		data += status;
+	}
+
+	return TotalNumberOfBytesWritten;
+}
+
+/**
+ * Writes to the shared memory ring once it has been negotiated, signalling
+ * the peer over the pipe when the ring was empty, and to the pipe otherwise.
+ * Blocking writes wait for the peer to make room in the ring.
+ */
+
+static int freerds_transport_send_control(rdsModuleConnector* connector, UINT32 flags)
+{
+	int length;
+	int status;
+	wStream* s;
+	BYTE buffer[64];
+	RDS_MSG_TRANSPORT msg;
+	rdsShmTransport* shm;
+
+	shm = connector->ShmTransport;
+
+	msg.type = connector->ServerMode ? RDS_SERVER_TRANSPORT : RDS_CLIENT_TRANSPORT;
+	msg.flags = flags;
+	msg.segmentId = shm ? shm->segmentId : 0;
+	msg.size = shm ? shm->size : 0;
+
+	s = Stream_New(buffer, sizeof(buffer));
+
+	if (!s)
+		return -1;
+
+	length = freerds_write_transport(NULL, &msg);
+	freerds_write_transport(s, &msg);
+
+	status = freerds_named_pipe_write(connector->hClientPipe, buffer, length);
+
+	Stream_Free(s, FALSE);
+
+	return status;
+}
+
+int freerds_transport_write(rdsModuleConnector* connector, BYTE* data, UINT32 length, BOOL blocking)
+{
+	int status;
+	int waited = 0;
+	UINT32 total = 0;
+	BOOL signal = FALSE;
+	rdsShmTransport* shm;
+
+	shm = connector->ShmTransport;
+
+	if (!shm || !shm->active)
+	{
+		if (blocking)
+			return freerds_named_pipe_write(connector->hClientPipe, data, length);
+
+		return freerds_named_pipe_write_nonblocking(connector->hClientPipe, data, length);
+	}
+
+	while (total < length)
+	{
+		status = freerds_shm_transport_write(shm, &data[total], length - total, &signal);
+		total += status;
+
+		if ((total >= length) || !blocking)
+			break;
+
+		if (status > 0)
+			waited = 0;
+
+		if (signal)
+		{
+			if (freerds_transport_send_control(connector, RDS_TRANSPORT_SHM_SIGNAL) < 0)
+				return -1;
+
+			signal = FALSE;
+		}
+
+		if (waited++ >= RDS_SHM_WRITE_TIMEOUT)
+		{
+			fprintf(stderr, "%s: shared memory ring stalled\n", __FUNCTION__);
+			return -1;
+		}
+
+		Sleep(1);
+	}
+
+	if (signal)
+	{
+		if (freerds_transport_send_control(connector, RDS_TRANSPORT_SHM_SIGNAL) < 0)
+			return -1;
+	}
+
+	return total;
+}
+
+/**
+ * Offers a new shared memory segment to the peer. Until the peer accepts,
+ * everything keeps going through the pipe. A transport already in use, or
+ * an offer still waiting for an answer, is never replaced.
+ */
+
+int freerds_transport_shm_offer(rdsModuleConnector* connector)
+{
+	rdsShmTransport* shm;
+
+	if (connector->ShmTransport)
+	{
+		fprintf(stderr, "%s: shared memory transport already %s\n", __FUNCTION__,
+				connector->ShmTransport->active ? "active" : "offered");
+		return -1;
+	}
+
+	shm = freerds_shm_transport_create(connector->ServerMode);
+
+	if (!shm)
+		return -1;
+
+	connector->ShmTransport = shm;
+
+	return freerds_transport_send_control(connector, RDS_TRANSPORT_SHM_OFFER);
+}
+
 void freerds_named_pipe_get_endpoint_name(DWORD id, const char *endpoint, char *dest, int len)
 {
 	sprintf_s(dest, len, "\\\\.\\pipe\\FreeRDS_%d_%s", (int) id, endpoint);
@@ -192,355 +358,317 @@ HANDLE freerds_named_pipe_accept(HANDLE hServerPipe)
 
 int freerds_receive_server_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
 {
-	int status = 0;
-	rdsServerInterface* server;
+	int status;
+	RDS_MSG_SERVER msg;
 
-	server = connector->server;
+	if (common->type == RDS_SERVER_TRANSPORT)
+		return freerds_receive_transport_message(connector, s, common);
 
-	switch (common->type)
+	CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
+
+	if (common->type == RDS_SERVER_PAINT_RECT)
 	{
-		case RDS_SERVER_BEGIN_UPDATE:
-			{
-				RDS_MSG_BEGIN_UPDATE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->BeginUpdate(connector, &msg);
-			}
-			break;
+		msg.PaintRect.fbSegmentId = 0;
+		msg.PaintRect.framebuffer = NULL;
+	}
 
-		case RDS_SERVER_END_UPDATE:
-			{
-				RDS_MSG_END_UPDATE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->EndUpdate(connector, &msg);
-			}
-			break;
+	status = freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
 
-		case RDS_SERVER_OPAQUE_RECT:
-			{
-				RDS_MSG_OPAQUE_RECT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->OpaqueRect(connector, &msg);
-			}
-			break;
+	if (status < 0)
+		return status;
 
-		case RDS_SERVER_SCREEN_BLT:
-			{
-				RDS_MSG_SCREEN_BLT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->ScreenBlt(connector, &msg);
-			}
-			break;
+	if ((common->type == RDS_SERVER_PAINT_RECT) && msg.PaintRect.fbSegmentId)
+		msg.PaintRect.framebuffer = &(connector->framebuffer);
 
-		case RDS_SERVER_PATBLT:
-			{
-				RDS_MSG_PATBLT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->PatBlt(connector, &msg);
-			}
-			break;
+	return freerds_server_message_call(connector->server, connector, (RDS_MSG_COMMON*) &msg);
+}
 
-		case RDS_SERVER_DSTBLT:
-			{
-				RDS_MSG_DSTBLT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->DstBlt(connector, &msg);
-			}
-			break;
+int freerds_receive_client_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
+{
+	int status;
+	RDS_MSG_CLIENT msg;
 
-		case RDS_SERVER_PAINT_RECT:
-			{
-				int status;
-				RDS_MSG_PAINT_RECT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
+	if (common->type == RDS_CLIENT_TRANSPORT)
+		return freerds_receive_transport_message(connector, s, common);
 
-				msg.fbSegmentId = 0;
-				msg.framebuffer = NULL;
+	CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
 
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
+	status = freerds_client_message_read(s, (RDS_MSG_COMMON*) &msg);
 
-				if (msg.fbSegmentId)
-					msg.framebuffer = &(connector->framebuffer);
+	if (status < 0)
+		return status;
 
-				status = server->PaintRect(connector, &msg);
-			}
-			break;
+	return freerds_client_message_call(connector->client, connector, (RDS_MSG_COMMON*) &msg);
+}
 
-		case RDS_SERVER_SET_CLIPPING_REGION:
-			{
-				RDS_MSG_SET_CLIPPING_REGION msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->SetClippingRegion(connector, &msg);
-			}
-			break;
+int freerds_receive_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
+{
+	if (connector->ServerMode)
+		return freerds_receive_client_message(connector, s, common);
+	else
+		return freerds_receive_server_message(connector, s, common);
+}
 
-		case RDS_SERVER_LINE_TO:
-			{
-				RDS_MSG_LINE_TO msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->LineTo(connector, &msg);
-			}
-			break;
+static int freerds_transport_dispatch(rdsModuleConnector* connector, wStream* s)
+{
+	RDS_MSG_COMMON common;
 
-		case RDS_SERVER_SET_POINTER:
-			{
-				RDS_MSG_SET_POINTER msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->SetPointer(connector, &msg);
-			}
-			break;
+	if (freerds_read_common_header(s, &common) < 0)
+		return -1;
 
-		case RDS_SERVER_SET_SYSTEM_POINTER:
-			{
-				RDS_MSG_SET_SYSTEM_POINTER msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->SetSystemPointer(connector, &msg);
-			}
-			break;
+	return freerds_receive_message(connector, s, &common);
+}
 
-		case RDS_SERVER_CREATE_OFFSCREEN_SURFACE:
-			{
-				RDS_MSG_CREATE_OFFSCREEN_SURFACE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->CreateOffscreenSurface(connector, &msg);
-			}
-			break;
+/**
+ * Appends the next bytes of a message that did not arrive in one piece,
+ * dispatching it once complete. Returns the number of bytes taken.
+ */
 
-		case RDS_SERVER_SWITCH_OFFSCREEN_SURFACE:
-			{
-				RDS_MSG_SWITCH_OFFSCREEN_SURFACE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->SwitchOffscreenSurface(connector, &msg);
-			}
-			break;
+static int freerds_transport_shm_carry(rdsModuleConnector* connector, BYTE* data, UINT32 count)
+{
+	wStream* s;
+	UINT32 need;
+	UINT32 taken = 0;
+	UINT32 length = 0;
+	UINT32 position;
 
-		case RDS_SERVER_DELETE_OFFSCREEN_SURFACE:
-			{
-				RDS_MSG_DELETE_OFFSCREEN_SURFACE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->DeleteOffscreenSurface(connector, &msg);
-			}
-			break;
+	s = connector->ShmTransport->carry;
 
-		case RDS_SERVER_PAINT_OFFSCREEN_SURFACE:
-			{
-				RDS_MSG_PAINT_OFFSCREEN_SURFACE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->PaintOffscreenSurface(connector, &msg);
-			}
-			break;
+	while (taken < count)
+	{
+		position = Stream_GetPosition(s);
 
-		case RDS_SERVER_WINDOW_NEW_UPDATE:
-			{
-				RDS_MSG_WINDOW_NEW_UPDATE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->WindowNewUpdate(connector, &msg);
-			}
-			break;
+		if (position >= RDS_ORDER_HEADER_LENGTH)
+		{
+			length = freerds_peek_common_header_length(Stream_Buffer(s));
 
-		case RDS_SERVER_WINDOW_DELETE:
-			{
-				RDS_MSG_WINDOW_DELETE msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->WindowDelete(connector, &msg);
-			}
-			break;
+			if (length < RDS_ORDER_HEADER_LENGTH)
+				return -1;
 
-		case RDS_SERVER_SHARED_FRAMEBUFFER:
-			{
-				RDS_MSG_SHARED_FRAMEBUFFER msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->SharedFramebuffer(connector, &msg);
-			}
-			break;
+			if (position >= length)
+				break;
 
-		case RDS_SERVER_LOGON_USER:
-			{
-				RDS_MSG_LOGON_USER msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->LogonUser(connector, &msg);
-			}
-			break;
+			need = length - position;
+		}
+		else
+		{
+			need = RDS_ORDER_HEADER_LENGTH - position;
+		}
 
-		case RDS_SERVER_LOGOFF_USER:
-			{
-				RDS_MSG_LOGOFF_USER msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_server_message_read(s, (RDS_MSG_COMMON*) &msg);
-				status = server->LogoffUser(connector, &msg);
-			}
-			break;
+		if (need > (count - taken))
+			need = count - taken;
 
-		default:
-			status = 0;
-			break;
+		Stream_EnsureRemainingCapacity(s, need);
+		Stream_Write(s, &data[taken], need);
+		taken += need;
 	}
 
-	return status;
+	position = Stream_GetPosition(s);
+
+	if (position < RDS_ORDER_HEADER_LENGTH)
+		return taken;
+
+	length = freerds_peek_common_header_length(Stream_Buffer(s));
+
+	if (length < RDS_ORDER_HEADER_LENGTH)
+		return -1;
+
+	if (position >= length)
+	{
+		Stream_SetLength(s, length);
+		Stream_SetPosition(s, 0);
+
+		freerds_transport_dispatch(connector, s);
+
+		Stream_SetPosition(s, 0);
+	}
+
+	return taken;
 }
 
-int freerds_receive_client_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
+/**
+ * Dispatches everything in the input ring. Complete messages are read in
+ * place, and any partial message is moved into the carry stream so that
+ * the ring is always left empty and the next write to it is signalled.
+ */
+
+static int freerds_transport_shm_drain(rdsModuleConnector* connector)
 {
-	int status = 0;
-	rdsClientInterface* client;
+	int status;
+	wStream* s;
+	BYTE* data;
+	UINT32 count;
+	UINT32 offset;
+	UINT32 length;
+	rdsShmTransport* shm;
 
-	client = connector->client;
+	shm = connector->ShmTransport;
+	s = shm->stream;
 
-	switch (common->type)
+	while ((count = freerds_shm_transport_read(shm, &data)) > 0)
 	{
-		case RDS_CLIENT_SYNCHRONIZE_KEYBOARD_EVENT:
-			{
-				RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_synchronize_keyboard_event(s, &msg);
-				status = client->SynchronizeKeyboardEvent(connector, msg.flags);
-			}
-			break;
+		offset = 0;
 
-		case RDS_CLIENT_SCANCODE_KEYBOARD_EVENT:
-			{
-				RDS_MSG_SCANCODE_KEYBOARD_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_scancode_keyboard_event(s, &msg);
-				status = client->ScancodeKeyboardEvent(connector, msg.flags, msg.code, msg.keyboardType);
-			}
-			break;
+		if (Stream_GetPosition(shm->carry) > 0)
+		{
+			status = freerds_transport_shm_carry(connector, data, count);
 
-		case RDS_CLIENT_VIRTUAL_KEYBOARD_EVENT:
-			{
-				RDS_MSG_VIRTUAL_KEYBOARD_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_virtual_keyboard_event(s, &msg);
-				status = client->VirtualKeyboardEvent(connector, msg.flags, msg.code);
-			}
-			break;
+			if (status < 0)
+				return -1;
 
-		case RDS_CLIENT_UNICODE_KEYBOARD_EVENT:
-			{
-				RDS_MSG_UNICODE_KEYBOARD_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_unicode_keyboard_event(s, &msg);
-				status = client->UnicodeKeyboardEvent(connector, msg.flags, msg.code);
-			}
-			break;
+			offset = status;
+		}
 
-		case RDS_CLIENT_MOUSE_EVENT:
-			{
-				RDS_MSG_MOUSE_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_mouse_event(s, &msg);
-				status = client->MouseEvent(connector, msg.flags, msg.x, msg.y);
-			}
-			break;
+		while ((count - offset) >= RDS_ORDER_HEADER_LENGTH)
+		{
+			length = freerds_peek_common_header_length(&data[offset]);
 
-		case RDS_CLIENT_EXTENDED_MOUSE_EVENT:
-			{
-				RDS_MSG_EXTENDED_MOUSE_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_extended_mouse_event(s, &msg);
-				status = client->ExtendedMouseEvent(connector, msg.flags, msg.x, msg.y);
-			}
-			break;
+			if (length < RDS_ORDER_HEADER_LENGTH)
+				return -1;
 
-		case RDS_CLIENT_VBLANK_EVENT:
-			{
-				RDS_MSG_VBLANK_EVENT msg;
-				CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
-				freerds_read_vblank_event(s, &msg);
-				if (client->VBlankEvent)
-					status = client->VBlankEvent(connector);
-				else
-					status = 0;
-			}
-			break;
+			if (length > (count - offset))
+				break;
 
-		default:
-			status = 0;
-			break;
+			Stream_SetLength(s, (&data[offset] - shm->data[shm->input]) + length);
+			Stream_SetPointer(s, &data[offset]);
+
+			freerds_transport_dispatch(connector, s);
+
+			offset += length;
+		}
+
+		if (offset < count)
+		{
+			if (freerds_transport_shm_carry(connector, &data[offset], count - offset) < 0)
+				return -1;
+		}
+
+		freerds_shm_transport_consume(shm, count);
 	}
 
-	return status;
+	return 0;
 }
 
-int freerds_receive_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
+/**
+ * Handles the transport negotiation. The session module offers a segment,
+ * and switches its output to the ring once freerds accepts, after writing
+ * out whatever it still had queued for the pipe. Since signals follow the
+ * data they announce on the pipe, messages are seen in the order sent.
+ */
+
+int freerds_receive_transport_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common)
 {
-	if (connector->ServerMode)
-		return freerds_receive_client_message(connector, s, common);
-	else
-		return freerds_receive_server_message(connector, s, common);
+	BOOL nonBlocking;
+	RDS_MSG_TRANSPORT msg;
+	rdsShmTransport* shm;
+
+	CopyMemory(&msg, common, sizeof(RDS_MSG_COMMON));
+
+	if (freerds_read_transport(s, &msg) < 0)
+		return -1;
+
+	shm = connector->ShmTransport;
+
+	if ((msg.flags & RDS_TRANSPORT_SHM_OFFER) && !connector->ServerMode)
+	{
+		if (shm)
+			return freerds_transport_send_control(connector, 0);
+
+		shm = freerds_shm_transport_attach(msg.segmentId, msg.size, connector->ServerMode);
+
+		if (!shm)
+			return freerds_transport_send_control(connector, 0);
+
+		connector->ShmTransport = shm;
+
+		if (freerds_transport_send_control(connector, RDS_TRANSPORT_SHM_ACCEPT) < 0)
+			return -1;
+
+		shm->active = TRUE;
+
+		return 0;
+	}
+
+	if (!shm)
+		return 0;
+
+	if (connector->ServerMode && !shm->active)
+	{
+		if (!(msg.flags & RDS_TRANSPORT_SHM_ACCEPT))
+		{
+			fprintf(stderr, "%s: shared memory transport declined\n", __FUNCTION__);
+			freerds_shm_transport_free(shm);
+			connector->ShmTransport = NULL;
+			return 0;
+		}
+
+		nonBlocking = connector->OutboundNonBlocking;
+		connector->OutboundNonBlocking = FALSE;
+		freerds_server_outbound_flush(connector);
+		connector->OutboundNonBlocking = nonBlocking;
+
+		shm->active = TRUE;
+		freerds_shm_transport_release_segment(shm);
+	}
+
+	if ((msg.flags & RDS_TRANSPORT_SHM_SIGNAL) && shm->active)
+		return freerds_transport_shm_drain(connector);
+
+	return 0;
 }
 
+/**
+ * Reads whatever the pipe has available into the inbound stream, which
+ * grows as needed, and dispatches every complete message in it. A partial
+ * message at the end is moved to the front and completed on the next call.
+ */
+
 int freerds_transport_receive(rdsModuleConnector* connector)
 {
 	wStream* s;
 	int status;
-	int position;
+	BYTE* buffer;
 	UINT32 length;
-	RDS_MSG_COMMON common;
+	UINT32 offset;
+	UINT32 position;
 
 	s = connector->InboundStream;
 
-	if (Stream_GetPosition(s) < RDS_ORDER_HEADER_LENGTH)
-	{
-		status = freerds_named_pipe_read(connector->hClientPipe, Stream_Pointer(s),
-				RDS_ORDER_HEADER_LENGTH - Stream_GetPosition(s));
+	Stream_EnsureRemainingCapacity(s, RDS_TRANSPORT_READ_SIZE);
 
-		if (status < 0)
-			return -1;
+	status = freerds_named_pipe_read(connector->hClientPipe, Stream_Pointer(s),
+			Stream_Capacity(s) - Stream_GetPosition(s));
 
-		if (status > 0)
-			Stream_Seek(s, status);
-	}
+	if (status < 0)
+		return -1;
 
-	if (Stream_GetPosition(s) >= RDS_ORDER_HEADER_LENGTH)
+	position = Stream_GetPosition(s) + status;
+	buffer = Stream_Buffer(s);
+	offset = 0;
+
+	while ((position - offset) >= RDS_ORDER_HEADER_LENGTH)
 	{
-		length = freerds_peek_common_header_length(Stream_Buffer(s));
+		length = freerds_peek_common_header_length(&buffer[offset]);
 
-		if (length - Stream_GetPosition(s))
-		{
-			status = freerds_named_pipe_read(connector->hClientPipe, Stream_Pointer(s),
-				length - Stream_GetPosition(s));
+		if (length < RDS_ORDER_HEADER_LENGTH)
+			return -1;
 
-			if (status < 0)
-				return -1;
+		if (length > (position - offset))
+			break;
 
-			if (status > 0)
-				Stream_Seek(s, status);
-		}
-	}
+		Stream_SetLength(s, offset + length);
+		Stream_SetPointer(s, &buffer[offset]);
 
-	if (Stream_GetPosition(s) >= RDS_ORDER_HEADER_LENGTH)
-	{
-		length = freerds_peek_common_header_length(Stream_Buffer(s));
+		freerds_transport_dispatch(connector, s);
 
-		if (Stream_GetPosition(s) >= length)
-		{
-			position = Stream_GetPosition(s);
+		offset += length;
+	}
 
-			Stream_SetPosition(s, 0);
-			freerds_read_common_header(s, &common);
+	if (offset && (offset < position))
+		MoveMemory(buffer, &buffer[offset], position - offset);
 
-			status = freerds_receive_message(connector, s, &common);
-			Stream_SetPosition(s, 0);
-		}
-	}
+	Stream_SetLength(s, Stream_Capacity(s));
+	Stream_SetPosition(s, position - offset);
 
 	return 0;
 }
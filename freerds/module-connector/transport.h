@@ -24,4 +24,8 @@
 
 #define PIPE_BUFFER_SIZE	0xFFFF
 
+#define RDS_TRANSPORT_READ_SIZE	0x10000
+
+int freerds_receive_transport_message(rdsModuleConnector* connector, wStream* s, RDS_MSG_COMMON* common);
+
 #endif /* RDS_NG_TRANSPORT_H */
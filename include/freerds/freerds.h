@@ -33,6 +33,10 @@ typedef struct rds_module_connector rdsModuleConnector;
 
 typedef struct rds_connection rdsConnection;
 
+typedef struct rds_message_ring rdsMessageRing;
+typedef struct rds_arena rdsArena;
+typedef struct rds_shm_transport rdsShmTransport;
+
 /* Common Data Types */
 
 #define RDS_MSG_FLAG_RECT		0x00000001
@@ -86,6 +90,9 @@ typedef struct _RDS_FRAMEBUFFER RDS_FRAMEBUFFER;
 #define RDS_CODEC_NSCODEC		0x00000002
 #define RDS_CODEC_REMOTEFX		0x00000004
 
+#define RDS_DAMAGE_MODE_EXTENTS		0x00000000
+#define RDS_DAMAGE_MODE_RECTS		0x00000001
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -110,6 +117,7 @@ int freerds_write_common_header(wStream* s, RDS_MSG_COMMON* msg);
 #define RDS_CLIENT_MOUSE_EVENT			108
 #define RDS_CLIENT_EXTENDED_MOUSE_EVENT		109
 #define RDS_CLIENT_VBLANK_EVENT			110
+#define RDS_CLIENT_TRANSPORT			111
 
 struct _RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT
 {
@@ -192,6 +200,20 @@ struct _RDS_MSG_VBLANK_EVENT
 };
 typedef struct _RDS_MSG_VBLANK_EVENT RDS_MSG_VBLANK_EVENT;
 
+union _RDS_MSG_CLIENT
+{
+	RDS_MSG_SYNCHRONIZE_KEYBOARD_EVENT SynchronizeKeyboardEvent;
+	RDS_MSG_SCANCODE_KEYBOARD_EVENT ScancodeKeyboardEvent;
+	RDS_MSG_VIRTUAL_KEYBOARD_EVENT VirtualKeyboardEvent;
+	RDS_MSG_UNICODE_KEYBOARD_EVENT UnicodeKeyboardEvent;
+	RDS_MSG_MOUSE_EVENT MouseEvent;
+	RDS_MSG_EXTENDED_MOUSE_EVENT ExtendedMouseEvent;
+	RDS_MSG_CAPABILITIES Capabilities;
+	RDS_MSG_REFRESH_RECT RefreshRect;
+	RDS_MSG_VBLANK_EVENT VBlankEvent;
+};
+typedef union _RDS_MSG_CLIENT RDS_MSG_CLIENT;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -256,6 +278,7 @@ int freerds_write_vblank_event(wStream* s, RDS_MSG_VBLANK_EVENT* msg);
 #define RDS_SERVER_SET_SYSTEM_POINTER		23
 #define RDS_SERVER_LOGON_USER			24
 #define RDS_SERVER_LOGOFF_USER			25
+#define RDS_SERVER_TRANSPORT			26
 
 struct _RDS_MSG_BEGIN_UPDATE
 {
@@ -465,6 +488,16 @@ struct _RDS_MSG_CACHE_GLYPH
 };
 typedef struct _RDS_MSG_CACHE_GLYPH RDS_MSG_CACHE_GLYPH;
 
+#ifndef SO_FLAG_DEFAULT_PLACEMENT
+#define SO_FLAG_DEFAULT_PLACEMENT	0x01
+#define SO_HORIZONTAL			0x02
+#define SO_VERTICAL			0x04
+#define SO_REVERSED			0x08
+#define SO_ZERO_BEARINGS		0x10
+#define SO_CHAR_INC_EQUAL_BM_BASE	0x20
+#define SO_MAXEXT_EQUAL_BM_SIDE		0x40
+#endif
+
 struct _RDS_MSG_GLYPH_INDEX
 {
 	DEFINE_MSG_COMMON();
@@ -488,6 +521,16 @@ struct _RDS_MSG_GLYPH_INDEX
 	INT32 y;
 	UINT32 cbData;
 	BYTE* data;
+
+	/**
+	 * When cGlyphs is set, glyph indices in data refer to the glyphs
+	 * serialized in the glyphs buffer (INT16 x, INT16 y, UINT16 cx, UINT16 cy,
+	 * followed by the 1bpp, byte-aligned bitmap) and the server maps them
+	 * to client glyph cache entries.
+	 */
+	UINT32 cGlyphs;
+	UINT32 cbGlyphs;
+	BYTE* glyphs;
 };
 typedef struct _RDS_MSG_GLYPH_INDEX RDS_MSG_GLYPH_INDEX;
 
@@ -570,6 +613,25 @@ struct _RDS_MSG_LOGOFF_USER
 };
 typedef struct _RDS_MSG_LOGOFF_USER RDS_MSG_LOGOFF_USER;
 
+/**
+ * Transport negotiation, sent on the pipe in both directions
+ * as RDS_SERVER_TRANSPORT and RDS_CLIENT_TRANSPORT.
+ */
+
+#define RDS_TRANSPORT_SHM_OFFER			0x00000001
+#define RDS_TRANSPORT_SHM_ACCEPT		0x00000002
+#define RDS_TRANSPORT_SHM_SIGNAL		0x00000004
+
+struct _RDS_MSG_TRANSPORT
+{
+	DEFINE_MSG_COMMON();
+
+	UINT32 flags;
+	UINT32 segmentId;
+	UINT32 size;
+};
+typedef struct _RDS_MSG_TRANSPORT RDS_MSG_TRANSPORT;
+
 struct _RDS_MSG_SHARED_FRAMEBUFFER
 {
 	DEFINE_MSG_COMMON();
@@ -609,6 +671,9 @@ union _RDS_MSG_SERVER
 	RDS_MSG_RESET Reset;
 	RDS_MSG_WINDOW_NEW_UPDATE WindowNewUpdate;
 	RDS_MSG_WINDOW_DELETE WindowDelete;
+	RDS_MSG_LOGON_USER LogonUser;
+	RDS_MSG_LOGOFF_USER LogoffUser;
+	RDS_MSG_TRANSPORT Transport;
 };
 typedef union _RDS_MSG_SERVER RDS_MSG_SERVER;
 
@@ -712,6 +777,9 @@ struct rds_module_connector
 	HANDLE hClientPipe;
 	HANDLE hServerPipe;
 	wStream* OutboundStream;
+	BOOL OutboundBatch;
+	BOOL OutboundNonBlocking;
+	rdsShmTransport* ShmTransport;
 	wStream* InboundStream;
 	UINT32 InboundTotalLength;
 	UINT32 InboundTotalCount;
@@ -729,11 +797,17 @@ struct rds_module_connector
 
 	int fps;
 	int MaxFps;
+	int DamageMode;
+	BOOL OrderMode;
+	BOOL ClippingEnabled;
+	RDS_RECT ClippingRect;
 	HANDLE StopEvent;
 	HANDLE ServerTimer;
 	HANDLE ServerThread;
-	wLinkedList* ServerList;
-	wMessageQueue* ServerQueue;
+	rdsMessageRing* ServerList;
+	rdsMessageRing* ServerQueue;
+	rdsArena** ServerArenas;
+	rdsArena* ServerArena;
 	rdsServerInterface* ServerProxy;
 };
 
@@ -747,9 +821,17 @@ FREERDP_API char* freerds_server_message_name(UINT32 type);
 FREERDP_API int freerds_server_message_read(wStream* s, RDS_MSG_COMMON* msg);
 FREERDP_API int freerds_server_message_write(wStream* s, RDS_MSG_COMMON* msg);
 
+FREERDP_API int freerds_read_transport(wStream* s, RDS_MSG_TRANSPORT* msg);
+FREERDP_API int freerds_write_transport(wStream* s, RDS_MSG_TRANSPORT* msg);
+
 FREERDP_API void* freerds_server_message_copy(RDS_MSG_COMMON* msg);
 FREERDP_API void freerds_server_message_free(RDS_MSG_COMMON* msg);
 
+FREERDP_API int freerds_server_message_call(rdsServerInterface* server, rdsModuleConnector* connector, RDS_MSG_COMMON* msg);
+
+FREERDP_API int freerds_client_message_read(wStream* s, RDS_MSG_COMMON* msg);
+FREERDP_API int freerds_client_message_call(rdsClientInterface* client, rdsModuleConnector* connector, RDS_MSG_COMMON* msg);
+
 /**
  * New Clean Module Interface API
  */
@@ -762,8 +844,11 @@ FREERDP_API rdsClientInterface* freerds_server_inbound_interface_new(void);
 
 FREERDP_API int freerds_named_pipe_read(HANDLE hNamedPipe, BYTE* data, DWORD length);
 FREERDP_API int freerds_named_pipe_write(HANDLE hNamedPipe, BYTE* data, DWORD length);
+FREERDP_API int freerds_named_pipe_write_nonblocking(HANDLE hNamedPipe, BYTE* data, DWORD length);
 
 FREERDP_API int freerds_server_outbound_write_message(rdsModuleConnector* connector, RDS_MSG_COMMON* msg);
+FREERDP_API int freerds_server_outbound_batch(rdsModuleConnector* connector, BOOL batch);
+FREERDP_API int freerds_server_outbound_flush(rdsModuleConnector* connector);
 
 FREERDP_API void freerds_named_pipe_get_endpoint_name(DWORD id, const char *endpoint, char *dest, int len);
 FREERDP_API int freerds_named_pipe_clean(const char* pipeName);
@@ -775,6 +860,8 @@ FREERDP_API HANDLE freerds_named_pipe_connect_endpoint(DWORD id, const char* end
 FREERDP_API HANDLE freerds_named_pipe_create_endpoint(DWORD id, const char* endpoint);
 FREERDP_API HANDLE freerds_named_pipe_accept(HANDLE hServerPipe);
 
+FREERDP_API int freerds_transport_write(rdsModuleConnector* connector, BYTE* data, UINT32 length, BOOL blocking);
+FREERDP_API int freerds_transport_shm_offer(rdsModuleConnector* connector);
 FREERDP_API int freerds_transport_receive(rdsModuleConnector* connector);
 
 #ifdef __cplusplus
@@ -141,6 +141,9 @@ struct _rdpScreenInfoRec
 	ScreenWakeupHandlerProcPtr WakeupHandler;
 	CompositeProcPtr Composite;
 	GlyphsProcPtr Glyphs;
+	TrapezoidsProcPtr Trapezoids;
+	TrianglesProcPtr Triangles;
+	AddTrapsProcPtr AddTraps;
 
 	int segmentId;
 	int sharedMemory;
@@ -194,6 +197,9 @@ struct _rdpPixmapRec
 	int con_number;
 	int pad0;
 	int kind_width;
+	int rdpindex; /* offscreen surface id, -1 when not mirrored */
+	int use_count;
+	int dirty; /* drawn to since its last copy to a window */
 };
 typedef struct _rdpPixmapRec rdpPixmapRec;
 typedef rdpPixmapRec* rdpPixmapPtr;
@@ -241,6 +247,14 @@ void rdpGlyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
 		PictFormatPtr maskFormat,
 		INT16 xSrc, INT16 ySrc, int nlists, GlyphListPtr lists,
 		GlyphPtr* glyphs);
+void rdpTrapezoids(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+		PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc, int ntrap,
+		xTrapezoid* traps);
+void rdpTriangles(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+		PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc, int ntri,
+		xTriangle* tris);
+void rdpAddTraps(PicturePtr pPicture, INT16 xOff, INT16 yOff, int ntrap,
+		xTrap* traps);
 
 /* rdpinput.c */
 int rdpKeybdProc(DeviceIntPtr pDevice, int onoff);
@@ -272,6 +286,7 @@ int rdpup_init(void);
 int rdpup_check(void);
 int rdpup_begin_update(void);
 int rdpup_end_update(void);
+int rdpup_flush(void);
 int rdpup_check_attach_framebuffer();
 int rdpup_opaque_rect(RDS_MSG_OPAQUE_RECT* msg);
 int rdpup_screen_blt(short x, short y, int cx, int cy, short srcx, short srcy);
@@ -281,7 +296,13 @@ int rdpup_set_clipping_region(RDS_MSG_SET_CLIPPING_REGION* msg);
 int rdpup_set_clip(short x, short y, int cx, int cy);
 int rdpup_reset_clip(void);
 int rdpup_draw_line(RDS_MSG_LINE_TO* msg);
+int rdpup_glyph_index(RDS_MSG_GLYPH_INDEX* msg);
+void rdpup_draw_text(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count,
+		unsigned char* chars, FontEncoding encoding, int opaque, BoxPtr box, RegionPtr clip);
 void rdpup_send_area(int x, int y, int w, int h);
+int rdpup_check_os_surface(PixmapPtr pPixmap);
+void rdpup_paint_os_surface(PixmapPtr pPixmap, int x, int y, int cx, int cy, int srcx, int srcy);
+void rdpup_delete_os_surface(PixmapPtr pPixmap);
 int rdpup_set_pointer(RDS_MSG_SET_POINTER* msg);
 void rdpup_create_window(WindowPtr pWindow, rdpWindowRec* priv);
 void rdpup_delete_window(WindowPtr pWindow, rdpWindowRec* priv);
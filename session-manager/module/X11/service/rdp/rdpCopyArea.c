@@ -35,6 +35,7 @@ extern DevPrivateKeyRec g_rdpPixmapIndex;
 extern rdpPixmapRec g_screenPriv;
 
 extern GCOps g_rdpGCOps;
+extern int g_Bpp_mask;
 
 static RegionPtr rdpCopyAreaOrg(DrawablePtr pSrc, DrawablePtr pDst, GCPtr pGC,
 		int srcx, int srcy, int w, int h, int dstx, int dsty)
@@ -130,6 +131,7 @@ RegionPtr rdpCopyArea(DrawablePtr pSrc, DrawablePtr pDst, GCPtr pGC, int srcx, i
 	int num_clips;
 	int cd;
 	int j;
+	int os;
 	int can_do_screen_blt;
 	int post_process;
 	BoxRec box;
@@ -186,6 +188,7 @@ RegionPtr rdpCopyArea(DrawablePtr pSrc, DrawablePtr pDst, GCPtr pGC, int srcx, i
 	{
 		pDstPixmap = (PixmapPtr) pDst;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -206,10 +209,28 @@ RegionPtr rdpCopyArea(DrawablePtr pSrc, DrawablePtr pDst, GCPtr pGC, int srcx, i
 	RegionInit(&clip_reg, NullBox, 0);
 	cd = rdp_get_clip(&clip_reg, pDst, pGC);
 
+	os = 0;
+
+	if ((cd != 0) && (pSrc->type == DRAWABLE_PIXMAP) && (pGC->alu == GXcopy) &&
+			((pGC->planemask & g_Bpp_mask) == g_Bpp_mask))
+	{
+		os = rdpup_check_os_surface(pSrcPixmap);
+	}
+
 	if (cd == 1)
 	{
 		rdpup_begin_update();
-		rdpup_send_area(pDst->x + dstx, pDst->y + dsty, w, h);
+
+		if (os)
+		{
+			rdpup_paint_os_surface(pSrcPixmap, pDst->x + dstx, pDst->y + dsty, w, h,
+					pSrc->x + srcx, pSrc->y + srcy);
+		}
+		else
+		{
+			rdpup_send_area(pDst->x + dstx, pDst->y + dsty, w, h);
+		}
+
 		rdpup_end_update();
 	}
 	else if (cd == 2)
@@ -227,7 +248,17 @@ RegionPtr rdpCopyArea(DrawablePtr pSrc, DrawablePtr pDst, GCPtr pGC, int srcx, i
 			RegionIntersect(&clip_reg, &clip_reg, &box_reg);
 			num_clips = REGION_NUM_RECTS(&clip_reg);
 
-			if (num_clips < 10)
+			if (os)
+			{
+				for (j = num_clips - 1; j >= 0; j--)
+				{
+					box = REGION_RECTS(&clip_reg)[j];
+					rdpup_paint_os_surface(pSrcPixmap, box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1,
+							pSrc->x + srcx + (box.x1 - (pDst->x + dstx)),
+							pSrc->y + srcy + (box.y1 - (pDst->y + dsty)));
+				}
+			}
+			else if (num_clips < 10)
 			{
 				for (j = num_clips - 1; j >= 0; j--)
 				{
@@ -64,6 +64,7 @@ void rdpFillSpans(DrawablePtr pDrawable, GCPtr pGC, int nInit, DDXPointPtr pptIn
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -53,7 +53,6 @@ void rdpImageText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, u
 	RegionRec reg1;
 	int num_clips;
 	int cd;
-	int j;
 	int post_process;
 	BoxRec box;
 	WindowPtr pDstWnd;
@@ -76,6 +75,7 @@ void rdpImageText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, u
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -107,7 +107,8 @@ void rdpImageText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, u
 	if (cd == 1)
 	{
 		rdpup_begin_update();
-		rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+		rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+				(FONTLASTROW(pGC->font) == 0) ? Linear16Bit : TwoD16Bit, 1, &box, NULL);
 		rdpup_end_update();
 	}
 	else if (cd == 2)
@@ -119,14 +120,8 @@ void rdpImageText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, u
 		if (num_clips > 0)
 		{
 			rdpup_begin_update();
-
-			for (j = num_clips - 1; j >= 0; j--)
-			{
-				box = REGION_RECTS(&reg)[j];
-				rdpup_send_area(box.x1, box.y1, box.x2 - box.x1,
-						box.y2 - box.y1);
-			}
-
+			rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+					(FONTLASTROW(pGC->font) == 0) ? Linear16Bit : TwoD16Bit, 1, &box, &reg);
 			rdpup_end_update();
 		}
 
@@ -51,7 +51,6 @@ void rdpImageText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, ch
 	RegionRec reg1;
 	int num_clips;
 	int cd;
-	int j;
 	int post_process;
 	BoxRec box;
 	WindowPtr pDstWnd;
@@ -74,6 +73,7 @@ void rdpImageText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, ch
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -105,7 +105,8 @@ void rdpImageText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, ch
 	if (cd == 1)
 	{
 		rdpup_begin_update();
-		rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+		rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+				Linear8Bit, 1, &box, NULL);
 		rdpup_end_update();
 	}
 	else if (cd == 2)
@@ -117,14 +118,8 @@ void rdpImageText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, ch
 		if (num_clips > 0)
 		{
 			rdpup_begin_update();
-
-			for (j = num_clips - 1; j >= 0; j--)
-			{
-				box = REGION_RECTS(&reg)[j];
-				rdpup_send_area(box.x1, box.y1, box.x2 - box.x1,
-						box.y2 - box.y1);
-			}
-
+			rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+					Linear8Bit, 1, &box, &reg);
 			rdpup_end_update();
 		}
 
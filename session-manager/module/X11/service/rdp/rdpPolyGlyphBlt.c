@@ -76,6 +76,7 @@ void rdpPolyGlyphBlt(DrawablePtr pDrawable, GCPtr pGC,
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
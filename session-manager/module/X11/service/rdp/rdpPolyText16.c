@@ -54,7 +54,6 @@ int rdpPolyText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, uns
 	RegionRec reg1;
 	int num_clips;
 	int cd;
-	int j;
 	int rv;
 	int post_process;
 	BoxRec box;
@@ -78,6 +77,7 @@ int rdpPolyText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, uns
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -109,7 +109,8 @@ int rdpPolyText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, uns
 	if (cd == 1)
 	{
 		rdpup_begin_update();
-		rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+		rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+				(FONTLASTROW(pGC->font) == 0) ? Linear16Bit : TwoD16Bit, 0, &box, NULL);
 		rdpup_end_update();
 	}
 	else if (cd == 2)
@@ -121,13 +122,8 @@ int rdpPolyText16(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, uns
 		if (num_clips > 0)
 		{
 			rdpup_begin_update();
-
-			for (j = num_clips - 1; j >= 0; j--)
-			{
-				box = REGION_RECTS(&reg)[j];
-				rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
-			}
-
+			rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+					(FONTLASTROW(pGC->font) == 0) ? Linear16Bit : TwoD16Bit, 0, &box, &reg);
 			rdpup_end_update();
 		}
 
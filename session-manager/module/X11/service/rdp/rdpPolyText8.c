@@ -54,7 +54,6 @@ int rdpPolyText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, char
 	RegionRec reg1;
 	int num_clips;
 	int cd;
-	int j;
 	int rv;
 	int post_process;
 	BoxRec box;
@@ -78,6 +77,7 @@ int rdpPolyText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, char
 	{
 		pDstPixmap = (PixmapPtr) pDrawable;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -109,7 +109,8 @@ int rdpPolyText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, char
 	if (cd == 1)
 	{
 		rdpup_begin_update();
-		rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+		rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+				Linear8Bit, 0, &box, NULL);
 		rdpup_end_update();
 	}
 	else if (cd == 2)
@@ -121,13 +122,8 @@ int rdpPolyText8(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count, char
 		if (num_clips > 0)
 		{
 			rdpup_begin_update();
-
-			for (j = num_clips - 1; j >= 0; j--)
-			{
-				box = REGION_RECTS(&reg)[j];
-				rdpup_send_area(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
-			}
-
+			rdpup_draw_text(pDrawable, pGC, x, y, count, (unsigned char*) chars,
+					Linear8Bit, 0, &box, &reg);
 			rdpup_end_update();
 		}
 
@@ -416,6 +416,9 @@ PixmapPtr rdpCreatePixmap(ScreenPtr pScreen, int width, int height, int depth, u
 	priv = GETPIXPRIV(rv);
 	priv->con_number = g_con_number;
 	priv->kind_width = width;
+	priv->rdpindex = -1;
+	priv->use_count = 0;
+	priv->dirty = 1;
 	pScreen->ModifyPixmapHeader(rv, org_width, height, depth, 0, 0, 0);
 	pScreen->CreatePixmap = rdpCreatePixmap;
 
@@ -432,6 +435,9 @@ Bool rdpDestroyPixmap(PixmapPtr pPixmap)
 	priv = GETPIXPRIV(pPixmap);
 	LLOGLN(10, ("status %d refcnt %d", priv->status, pPixmap->refcnt));
 
+	if (pPixmap->refcnt == 1)
+		rdpup_delete_os_surface(pPixmap);
+
 	pScreen = pPixmap->drawable.pScreen;
 	pScreen->DestroyPixmap = g_rdpScreen.DestroyPixmap;
 	status = pScreen->DestroyPixmap(pPixmap);
@@ -861,6 +867,7 @@ void rdpComposite(CARD8 op, PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst,
 	{
 		pDstPixmap = (PixmapPtr) p;
 		pDstPriv = GETPIXPRIV(pDstPixmap);
+		pDstPriv->dirty = 1;
 	}
 	else
 	{
@@ -990,6 +997,18 @@ void GlyphExtents(int nlist, GlyphListPtr list, GlyphPtr* glyphs, BoxPtr extents
 	}
 }
 
+/* flag render writes to pixmaps so their offscreen surfaces are dropped */
+static void rdpPictureDirty(PicturePtr pPicture)
+{
+	rdpPixmapRec* priv;
+
+	if (!pPicture->pDrawable || (pPicture->pDrawable->type != DRAWABLE_PIXMAP))
+		return;
+
+	priv = GETPIXPRIV((PixmapPtr) pPicture->pDrawable);
+	priv->dirty = 1;
+}
+
 void rdpGlyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst, PictFormatPtr maskFormat,
 		INT16 xSrc, INT16 ySrc, int nlists, GlyphListPtr lists, GlyphPtr *glyphs)
 {
@@ -1016,6 +1035,8 @@ void rdpGlyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst, PictFormatPtr maskFor
 
 	g_doing_font = 0;
 
+	rdpPictureDirty(pDst);
+
 	GlyphExtents(nlists, lists, glyphs, &box);
 
 	rdpup_begin_update();
@@ -1024,3 +1045,48 @@ void rdpGlyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst, PictFormatPtr maskFor
 
 	LLOGLN(10, ("rdpGlyphs: out"));
 }
+
+/* pixman rasterizes these straight into the destination, bypassing Composite */
+void rdpTrapezoids(CARD8 op, PicturePtr pSrc, PicturePtr pDst, PictFormatPtr maskFormat,
+		INT16 xSrc, INT16 ySrc, int ntrap, xTrapezoid* traps)
+{
+	PictureScreenPtr ps;
+
+	LLOGLN(10, ("rdpTrapezoids:"));
+
+	ps = GetPictureScreen(g_pScreen);
+	ps->Trapezoids = g_rdpScreen.Trapezoids;
+	ps->Trapezoids(op, pSrc, pDst, maskFormat, xSrc, ySrc, ntrap, traps);
+	ps->Trapezoids = rdpTrapezoids;
+
+	rdpPictureDirty(pDst);
+}
+
+void rdpTriangles(CARD8 op, PicturePtr pSrc, PicturePtr pDst, PictFormatPtr maskFormat,
+		INT16 xSrc, INT16 ySrc, int ntri, xTriangle* tris)
+{
+	PictureScreenPtr ps;
+
+	LLOGLN(10, ("rdpTriangles:"));
+
+	ps = GetPictureScreen(g_pScreen);
+	ps->Triangles = g_rdpScreen.Triangles;
+	ps->Triangles(op, pSrc, pDst, maskFormat, xSrc, ySrc, ntri, tris);
+	ps->Triangles = rdpTriangles;
+
+	rdpPictureDirty(pDst);
+}
+
+void rdpAddTraps(PicturePtr pPicture, INT16 xOff, INT16 yOff, int ntrap, xTrap* traps)
+{
+	PictureScreenPtr ps;
+
+	LLOGLN(10, ("rdpAddTraps:"));
+
+	ps = GetPictureScreen(g_pScreen);
+	ps->AddTraps = g_rdpScreen.AddTraps;
+	ps->AddTraps(pPicture, xOff, yOff, ntrap, traps);
+	ps->AddTraps = rdpAddTraps;
+
+	rdpPictureDirty(pPicture);
+}
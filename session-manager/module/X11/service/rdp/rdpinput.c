@@ -55,6 +55,7 @@ keyboard and mouse stuff
 extern DeviceIntPtr g_pointer;
 extern DeviceIntPtr g_keyboard;
 extern rdpScreenInfoRec g_rdpScreen;
+extern int g_con_number;
 
 static int g_old_button_mask = 0;
 static int g_pause_spe = 0;
@@ -66,6 +67,11 @@ static int g_tab_down = 0;
    above *_down vars */
 static int g_scroll_lock_down = 0;
 
+static int g_cursor_con_number = -1;
+static int g_cursor_xhot = 0;
+static int g_cursor_yhot = 0;
+static char g_cursor_data[32 * (32 * 4)];
+
 #define MIN_KEY_CODE 8
 #define MAX_KEY_CODE 255
 #define NO_OF_KEYS ((MAX_KEY_CODE - MIN_KEY_CODE) + 1)
@@ -595,14 +601,15 @@ void rdpSpriteSetCursor(DeviceIntPtr pDev, ScreenPtr pScr, CursorPtr pCurs, int
 {
 	char cur_data[32 * (32 * 4)];
 	char cur_mask[32 * (32 / 8)];
-	char* data;
+	CARD32* src;
 	int i;
 	int j;
 	int w;
 	int h;
 	int p;
-	int paddedRowBytes;
-	int bpp;
+	int fg;
+	int bg;
+	int stride;
 	RDS_MSG_SET_POINTER msg;
 
 	if (!pCurs)
@@ -614,29 +621,65 @@ void rdpSpriteSetCursor(DeviceIntPtr pDev, ScreenPtr pScr, CursorPtr pCurs, int
 	w = pCurs->bits->width;
 	h = pCurs->bits->height;
 
+	if (w > 32)
+		w = 32;
+
+	if (h > 32)
+		h = 32;
+
+	ZeroMemory(cur_data, sizeof(cur_data));
+	ZeroMemory(cur_mask, sizeof(cur_mask));
+
+	/* the pointer is sent bottom-up */
+
 	if (pCurs->bits->argb)
 	{
-		bpp = 32;
-		paddedRowBytes = PixmapBytePad(w, 32);
-		msg.xPos = pCurs->bits->xhot;
-		msg.yPos = pCurs->bits->yhot;
-		data = (char*)(pCurs->bits->argb);
-		ZeroMemory(cur_data, sizeof(cur_data));
-		ZeroMemory(cur_mask, sizeof(cur_mask));
-
-		for (j = 0; j < 32; j++)
+		stride = PixmapBytePad(pCurs->bits->width, 32) / 4;
+
+		for (j = 0; j < h; j++)
+		{
+			src = pCurs->bits->argb + (j * stride);
+			CopyMemory(&cur_data[(31 - j) * (32 * 4)], src, w * 4);
+		}
+	}
+	else
+	{
+		/* core cursors are converted to ARGB: source over mask, in the cursor colors */
+
+		fg = 0xFF000000 | ((pCurs->foreRed >> 8) << 16) | ((pCurs->foreGreen >> 8) << 8) | (pCurs->foreBlue >> 8);
+		bg = 0xFF000000 | ((pCurs->backRed >> 8) << 16) | ((pCurs->backGreen >> 8) << 8) | (pCurs->backBlue >> 8);
+		stride = PixmapBytePad(pCurs->bits->width, 1) * 8;
+
+		for (j = 0; j < h; j++)
 		{
-			for (i = 0; i < 32; i++)
+			for (i = 0; i < w; i++)
 			{
-				p = get_pixel_safe(data, i, j, paddedRowBytes / 4, h, 32);
+				if (!get_pixel_safe((char*) pCurs->bits->mask, i, j, stride, h, 1))
+					continue;
+
+				p = get_pixel_safe((char*) pCurs->bits->source, i, j, stride, h, 1) ? fg : bg;
 				set_pixel_safe(cur_data, i, 31 - j, 32, 32, 32, p);
 			}
 		}
 	}
 
+	/* the server caches pointer shapes, only skip resending the current one */
+
+	if ((g_cursor_con_number == g_con_number) &&
+			(g_cursor_xhot == pCurs->bits->xhot) && (g_cursor_yhot == pCurs->bits->yhot) &&
+			(memcmp(g_cursor_data, cur_data, sizeof(cur_data)) == 0))
+		return;
+
+	g_cursor_con_number = g_con_number;
+	g_cursor_xhot = pCurs->bits->xhot;
+	g_cursor_yhot = pCurs->bits->yhot;
+	CopyMemory(g_cursor_data, cur_data, sizeof(cur_data));
+
 	rdpup_begin_update();
 
-	msg.xorBpp = bpp;
+	msg.xPos = pCurs->bits->xhot;
+	msg.yPos = pCurs->bits->yhot;
+	msg.xorBpp = 32;
 	msg.xorMaskData = (BYTE*) cur_data;
 	msg.lengthXorMask = 0;
 	msg.andMaskData = (BYTE*) cur_mask;
@@ -177,6 +177,10 @@ static void rdpWakeupHandler(ScreenPtr pScreen, unsigned long result, pointer pR
 
 static void rdpBlockHandler1(pointer blockData, OSTimePtr pTimeout, pointer pReadmask)
 {
+	/* the pipe does not wake us up once writable, retry shortly */
+
+	if (rdpup_flush() > 0)
+		AdjustWaitForDelay(pTimeout, 10);
 }
 
 static void rdpWakeupHandler1(pointer blockData, int result, pointer pReadmask)
@@ -413,6 +417,9 @@ static Bool rdpScreenInit(ScreenPtr pScreen, int argc, char** argv)
 	{
 		g_rdpScreen.Composite = ps->Composite;
 		g_rdpScreen.Glyphs = ps->Glyphs;
+		g_rdpScreen.Trapezoids = ps->Trapezoids;
+		g_rdpScreen.Triangles = ps->Triangles;
+		g_rdpScreen.AddTraps = ps->AddTraps;
 	}
 
 	pScreen->blackPixel = g_rdpScreen.blackPixel;
@@ -426,6 +433,9 @@ static Bool rdpScreenInit(ScreenPtr pScreen, int argc, char** argv)
 	{
 		ps->Composite = rdpComposite;
 		ps->Glyphs = rdpGlyphs;
+		ps->Trapezoids = rdpTrapezoids;
+		ps->Triangles = rdpTriangles;
+		ps->AddTraps = rdpAddTraps;
 	}
 
 	pScreen->SaveScreen = rdpSaveScreen;
@@ -222,6 +222,112 @@ UINT32 rdp_dstblt_rop(int opcode)
 	return rop;
 }
 
+/**
+ * Messages are batched on the outbound stream and written to the pipe
+ * in one go at the end of each update, once enough are pending, or
+ * from the block handler before the X server goes idle.
+ *
+ * Writes never block: what the pipe does not accept stays queued. Once
+ * more than RDP_OUTBOUND_QUEUE_SIZE bytes are queued, paints of the shared
+ * framebuffer are no longer queued but collapsed into a damage region,
+ * which is painted again from the framebuffer once the queue has drained.
+ * Other messages keep being queued, up to RDP_OUTBOUND_QUEUE_MAX_SIZE
+ * bytes past which the queue is drained with blocking writes.
+ */
+
+#define RDP_OUTBOUND_QUEUE_SIZE		(1024 * 1024)
+#define RDP_OUTBOUND_QUEUE_MAX_SIZE	(8 * 1024 * 1024)
+
+static BOOL g_damage_pending = FALSE;
+static RegionRec g_damage_reg;
+
+static void rdpup_damage_add(int x, int y, int cx, int cy)
+{
+	BoxRec box;
+	RegionRec reg;
+
+	if ((cx < 1) || (cy < 1))
+		return;
+
+	if (!g_damage_pending)
+	{
+		RegionInit(&g_damage_reg, NullBox, 0);
+		g_damage_pending = TRUE;
+	}
+
+	box.x1 = x;
+	box.y1 = y;
+	box.x2 = x + cx;
+	box.y2 = y + cy;
+
+	RegionInit(&reg, &box, 0);
+	RegionUnion(&g_damage_reg, &g_damage_reg, &reg);
+	RegionUninit(&reg);
+}
+
+static void rdpup_damage_send(void)
+{
+	int index;
+	int count;
+	BoxRec* boxes;
+	RegionRec reg;
+
+	if (!g_damage_pending)
+		return;
+
+	/* repainting queues messages again, which must not collapse */
+
+	reg = g_damage_reg;
+	g_damage_pending = FALSE;
+
+	count = REGION_NUM_RECTS(&reg);
+	boxes = REGION_RECTS(&reg);
+
+	for (index = 0; index < count; index++)
+	{
+		rdpup_send_area(boxes[index].x1, boxes[index].y1,
+				boxes[index].x2 - boxes[index].x1, boxes[index].y2 - boxes[index].y1);
+	}
+
+	RegionUninit(&reg);
+}
+
+static BOOL rdpup_damage_collapse(RDS_MSG_COMMON* msg)
+{
+	BoxRec box;
+	RDS_MSG_PAINT_RECT* paint;
+	RDS_MSG_SCREEN_BLT* blt;
+
+	if (msg->type == RDS_SERVER_PAINT_RECT)
+	{
+		paint = (RDS_MSG_PAINT_RECT*) msg;
+
+		if (!paint->fbSegmentId || paint->bitmapData)
+			return FALSE;
+
+		rdpup_damage_add(paint->nLeftRect, paint->nTopRect, paint->nWidth, paint->nHeight);
+
+		return TRUE;
+	}
+
+	if ((msg->type == RDS_SERVER_SCREEN_BLT) && g_damage_pending)
+	{
+		/* a copy from damaged content copies stale pixels on the client */
+
+		blt = (RDS_MSG_SCREEN_BLT*) msg;
+
+		box.x1 = blt->nXSrc;
+		box.y1 = blt->nYSrc;
+		box.x2 = blt->nXSrc + blt->nWidth;
+		box.y2 = blt->nYSrc + blt->nHeight;
+
+		if (RegionContainsRect(&g_damage_reg, &box) != rgnOUT)
+			rdpup_damage_add(blt->nLeftRect, blt->nTopRect, blt->nWidth, blt->nHeight);
+	}
+
+	return FALSE;
+}
+
 int rdpup_begin_update(void)
 {
 	return 0;
@@ -229,12 +335,45 @@ int rdpup_begin_update(void)
 
 int rdpup_end_update(void)
 {
+	rdpup_flush();
 	return 0;
 }
 
+/**
+ * Returns the number of bytes still queued, or -1 on error.
+ */
+
+int rdpup_flush(void)
+{
+	wStream* s;
+	rdsModuleConnector* connector = (rdsModuleConnector*) g_Service;
+
+	if (!g_connected)
+		return 0;
+
+	s = connector->OutboundStream;
+
+	if (freerds_server_outbound_flush(connector) < 0)
+		return -1;
+
+	if ((Stream_GetPosition(s) == 0) && g_damage_pending)
+	{
+		rdpup_damage_send();
+
+		if (freerds_server_outbound_flush(connector) < 0)
+			return -1;
+	}
+
+	if (g_damage_pending)
+		return Stream_GetPosition(s) + 1;
+
+	return Stream_GetPosition(s);
+}
+
 int rdpup_update(RDS_MSG_COMMON* msg)
 {
 	int status;
+	int pending;
 	rdsModuleConnector* connector = (rdsModuleConnector*) g_Service;
 
 	if (g_connected)
@@ -245,6 +384,24 @@ int rdpup_update(RDS_MSG_COMMON* msg)
 			return 0;
 		}
 
+		pending = Stream_GetPosition(connector->OutboundStream);
+
+		if (g_damage_pending || (pending >= RDP_OUTBOUND_QUEUE_SIZE))
+		{
+			if (rdpup_damage_collapse(msg))
+			{
+				LLOGLN(0, ("rdpup_update: collapsing %s message (%d)", freerds_server_message_name(msg->type), msg->type));
+				return 0;
+			}
+		}
+
+		if (pending >= RDP_OUTBOUND_QUEUE_MAX_SIZE)
+		{
+			connector->OutboundNonBlocking = FALSE;
+			freerds_server_outbound_flush(connector);
+			connector->OutboundNonBlocking = TRUE;
+		}
+
 		status = freerds_server_outbound_write_message(connector, (RDS_MSG_COMMON*) msg);
 
 		LLOGLN(0, ("rdpup_update: adding %s message (%d)", freerds_server_message_name(msg->type), msg->type));
@@ -302,6 +459,7 @@ int rdpup_screen_blt(short x, short y, int cx, int cy, short srcx, short srcy)
 	msg.nHeight = cy;
 	msg.nXSrc = srcx;
 	msg.nYSrc = srcy;
+	msg.bRop = 0xCC;
 
 	msg.type = RDS_SERVER_SCREEN_BLT;
 	rdpup_update((RDS_MSG_COMMON*) &msg);
@@ -375,6 +533,256 @@ int rdpup_draw_line(RDS_MSG_LINE_TO* msg)
 	return 0;
 }
 
+int rdpup_glyph_index(RDS_MSG_GLYPH_INDEX* msg)
+{
+	rdpup_check_attach_framebuffer();
+
+	msg->type = RDS_SERVER_GLYPH_INDEX;
+	rdpup_update((RDS_MSG_COMMON*) msg);
+
+	return 0;
+}
+
+/**
+ * Core font text is sent as GlyphIndex messages carrying the glyph bitmaps,
+ * which FreeRDS maps to the client glyph cache. A message holds at most
+ * RDPUP_TEXT_MAX_GLYPHS distinct glyphs and a 255 byte glyph fragment.
+ */
+
+#define RDPUP_TEXT_MAX_GLYPHS	63
+
+static wStream* g_TextStream = NULL;
+
+static BYTE rdpup_reverse_bits(BYTE b)
+{
+	b = ((b & 0xF0) >> 4) | ((b & 0x0F) << 4);
+	b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+	b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+	return b;
+}
+
+static void rdpup_write_glyph(wStream* s, CharInfoPtr pci)
+{
+	int row;
+	int col;
+	int width;
+	int height;
+	int srcStride;
+	int dstStride;
+	BYTE* src;
+
+	width = GLYPHWIDTHPIXELS(pci);
+	height = GLYPHHEIGHTPIXELS(pci);
+	srcStride = GLYPHWIDTHBYTESPADDED(pci);
+	dstStride = (width + 7) / 8;
+
+	Stream_EnsureRemainingCapacity(s, 8 + (dstStride * height));
+
+	Stream_Write_UINT16(s, (UINT16) pci->metrics.leftSideBearing);
+	Stream_Write_UINT16(s, (UINT16) -pci->metrics.ascent);
+	Stream_Write_UINT16(s, width);
+	Stream_Write_UINT16(s, height);
+
+	src = (BYTE*) FONTGLYPHBITS(0, pci);
+
+	for (row = 0; row < height; row++)
+	{
+		for (col = 0; col < dstStride; col++)
+		{
+#if (BITMAP_BIT_ORDER == LSBFirst)
+			Stream_Write_UINT8(s, rdpup_reverse_bits(src[col]));
+#else
+			Stream_Write_UINT8(s, src[col]);
+#endif
+		}
+
+		src += srcStride;
+	}
+}
+
+static void rdpup_send_text(DrawablePtr pDrawable, GCPtr pGC, int x, int y,
+		int count, CharInfoPtr* charinfo, int opaque)
+{
+	int index;
+	int glyph;
+	int delta;
+	int penX;
+	int lastX;
+	int originX;
+	int originY;
+	int numGlyphs;
+	BoxRec ink;
+	BYTE fragment[256];
+	CharInfoPtr pci;
+	CharInfoPtr glyphs[RDPUP_TEXT_MAX_GLYPHS];
+	RDS_MSG_GLYPH_INDEX msg;
+
+	originX = pDrawable->x + x;
+	originY = pDrawable->y + y;
+
+	penX = originX;
+	index = 0;
+
+	while (index < count)
+	{
+		ZeroMemory(&msg, sizeof(RDS_MSG_GLYPH_INDEX));
+
+		Stream_SetPosition(g_TextStream, 0);
+
+		numGlyphs = 0;
+		msg.x = lastX = penX;
+		msg.y = originY;
+
+		ink.x1 = ink.y1 = 0x7FFF;
+		ink.x2 = ink.y2 = -0x7FFF;
+
+		for (; index < count; index++)
+		{
+			pci = charinfo[index];
+
+			/* glyphs without pixels only advance the pen */
+
+			if (!GLYPHWIDTHPIXELS(pci) || !GLYPHHEIGHTPIXELS(pci))
+			{
+				penX += pci->metrics.characterWidth;
+				continue;
+			}
+
+			for (glyph = 0; glyph < numGlyphs; glyph++)
+			{
+				if (glyphs[glyph] == pci)
+					break;
+			}
+
+			if (((glyph == numGlyphs) && (numGlyphs == RDPUP_TEXT_MAX_GLYPHS)) || (msg.cbData + 4 > 255))
+				break;
+
+			if (glyph == numGlyphs)
+			{
+				glyphs[numGlyphs++] = pci;
+				rdpup_write_glyph(g_TextStream, pci);
+			}
+
+			delta = penX - lastX;
+			lastX = penX;
+
+			fragment[msg.cbData++] = glyph;
+
+			if ((delta >= 0) && (delta < 0x80))
+			{
+				fragment[msg.cbData++] = delta;
+			}
+			else
+			{
+				fragment[msg.cbData++] = 0x80;
+				fragment[msg.cbData++] = delta & 0xFF;
+				fragment[msg.cbData++] = (delta >> 8) & 0xFF;
+			}
+
+			ink.x1 = min(ink.x1, penX + pci->metrics.leftSideBearing);
+			ink.y1 = min(ink.y1, originY - pci->metrics.ascent);
+			ink.x2 = max(ink.x2, penX + pci->metrics.rightSideBearing);
+			ink.y2 = max(ink.y2, originY + pci->metrics.descent);
+
+			penX += pci->metrics.characterWidth;
+		}
+
+		if (opaque)
+		{
+			msg.opLeft = msg.x;
+			msg.opTop = originY - FONTASCENT(pGC->font);
+			msg.opRight = penX;
+			msg.opBottom = originY + FONTDESCENT(pGC->font);
+
+			ink.x1 = min(ink.x1, msg.opLeft);
+			ink.y1 = min(ink.y1, msg.opTop);
+			ink.x2 = max(ink.x2, msg.opRight);
+			ink.y2 = max(ink.y2, msg.opBottom);
+		}
+
+		if ((ink.x2 <= ink.x1) || (ink.y2 <= ink.y1))
+			continue;
+
+		msg.cacheId = 0;
+		msg.flAccel = SO_FLAG_DEFAULT_PLACEMENT | SO_HORIZONTAL;
+		msg.ulCharInc = 0;
+		msg.fOpRedundant = 0;
+		msg.backColor = rdpup_convert_color(pGC->fgPixel);
+		msg.foreColor = rdpup_convert_color(pGC->bgPixel);
+		msg.bkLeft = ink.x1;
+		msg.bkTop = ink.y1;
+		msg.bkRight = ink.x2;
+		msg.bkBottom = ink.y2;
+		msg.brush.data = msg.brush.p8x8;
+		msg.data = fragment;
+
+		msg.cGlyphs = numGlyphs;
+		msg.cbGlyphs = Stream_GetPosition(g_TextStream);
+		msg.glyphs = Stream_Buffer(g_TextStream);
+
+		rdpup_glyph_index(&msg);
+	}
+}
+
+/**
+ * Sends text drawn by a core text request, as glyphs when the GC
+ * allows it and as the text bounding box otherwise.
+ */
+
+void rdpup_draw_text(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int count,
+		unsigned char* chars, FontEncoding encoding, int opaque, BoxPtr box, RegionPtr clip)
+{
+	int j;
+	int num_clips;
+	BoxRec clip_box;
+	unsigned long n;
+	CharInfoPtr* charinfo;
+
+	num_clips = clip ? REGION_NUM_RECTS(clip) : 1;
+
+	charinfo = NULL;
+
+	if (!g_TextStream)
+		g_TextStream = Stream_New(NULL, 4096);
+
+	if (g_TextStream && ((pGC->planemask & g_Bpp_mask) == g_Bpp_mask) &&
+			(opaque || ((pGC->fillStyle == FillSolid) && (pGC->alu == GXcopy))))
+	{
+		charinfo = (CharInfoPtr*) malloc(count * sizeof(CharInfoPtr));
+	}
+
+	if (!charinfo)
+	{
+		for (j = num_clips - 1; j >= 0; j--)
+		{
+			clip_box = clip ? REGION_RECTS(clip)[j] : *box;
+			rdpup_send_area(clip_box.x1, clip_box.y1, clip_box.x2 - clip_box.x1, clip_box.y2 - clip_box.y1);
+		}
+
+		return;
+	}
+
+	GetGlyphs(pGC->font, count, chars, encoding, &n, charinfo);
+
+	if (!clip)
+	{
+		rdpup_send_text(pDrawable, pGC, x, y, n, charinfo, opaque);
+	}
+	else
+	{
+		for (j = num_clips - 1; j >= 0; j--)
+		{
+			clip_box = REGION_RECTS(clip)[j];
+			rdpup_set_clip(clip_box.x1, clip_box.y1, clip_box.x2 - clip_box.x1, clip_box.y2 - clip_box.y1);
+			rdpup_send_text(pDrawable, pGC, x, y, n, charinfo, opaque);
+		}
+
+		rdpup_reset_clip();
+	}
+
+	free(charinfo);
+}
+
 int rdpup_set_pointer(RDS_MSG_SET_POINTER* msg)
 {
 	msg->type = RDS_SERVER_SET_POINTER;
@@ -457,6 +865,234 @@ void rdpup_send_area(int x, int y, int w, int h)
 	rdpup_update((RDS_MSG_COMMON*) &msg);
 }
 
+/**
+ * Offscreen surfaces
+ *
+ * Pixmaps copied to the screen again with unchanged content are mirrored
+ * as client offscreen bitmaps, so later copies become a MemBlt from the
+ * surface instead of re-encoding the pixels. A pixmap whose content has
+ * changed since the last copy is dropped and goes back to send_area.
+ *
+ * Changes are tracked by the dirty flag that the GC and render hooks set on
+ * pixmap destinations. Pixmaps without storage of their own (MIT-SHM) can be
+ * written behind the server's back and are never mirrored.
+ */
+
+#define RDPUP_OS_MAX_SURFACES	100
+#define RDPUP_OS_MIN_PIXELS	(32 * 32)
+#define RDPUP_OS_MAX_PIXELS	(1024 * 1024)
+#define RDPUP_OS_MAX_SIZE	2048
+#define RDPUP_OS_PRIMARY	0xFFFF
+
+static PixmapPtr g_os_pixmaps[RDPUP_OS_MAX_SURFACES];
+static int g_os_stamps[RDPUP_OS_MAX_SURFACES];
+static int g_os_stamp = 0;
+static int g_os_con_number = -1;
+
+static void rdpup_switch_os_surface(int index)
+{
+	RDS_MSG_SWITCH_OFFSCREEN_SURFACE msg;
+
+	msg.cacheIndex = index;
+
+	msg.type = RDS_SERVER_SWITCH_OFFSCREEN_SURFACE;
+	rdpup_update((RDS_MSG_COMMON*) &msg);
+}
+
+static void rdpup_upload_os_surface(PixmapPtr pPixmap, int index)
+{
+	int y;
+	int width;
+	int height;
+	int scanline;
+	BYTE* data;
+	BYTE* pixels;
+	RDS_MSG_PAINT_RECT msg;
+
+	width = pPixmap->drawable.width;
+	height = pPixmap->drawable.height;
+	scanline = width * 4;
+
+	pixels = (BYTE*) pPixmap->devPrivate.ptr;
+	data = pixels;
+
+	if (pPixmap->devKind != scanline)
+	{
+		data = (BYTE*) malloc(scanline * height);
+
+		if (!data)
+			return;
+
+		for (y = 0; y < height; y++)
+			memcpy(&data[y * scanline], &pixels[y * pPixmap->devKind], scanline);
+	}
+
+	msg.nLeftRect = 0;
+	msg.nTopRect = 0;
+	msg.nWidth = width;
+	msg.nHeight = height;
+	msg.nXSrc = 0;
+	msg.nYSrc = 0;
+
+	msg.fbSegmentId = 0;
+	msg.bitmapData = data;
+	msg.bitmapDataLength = scanline * height;
+
+	rdpup_switch_os_surface(index);
+
+	msg.type = RDS_SERVER_PAINT_RECT;
+	rdpup_update((RDS_MSG_COMMON*) &msg);
+
+	rdpup_switch_os_surface(RDPUP_OS_PRIMARY);
+
+	if (data != pixels)
+		free(data);
+}
+
+void rdpup_delete_os_surface(PixmapPtr pPixmap)
+{
+	rdpPixmapRec* priv;
+	RDS_MSG_DELETE_OFFSCREEN_SURFACE msg;
+
+	priv = GETPIXPRIV(pPixmap);
+
+	if (priv->rdpindex < 0)
+		return;
+
+	if (g_os_pixmaps[priv->rdpindex] == pPixmap)
+		g_os_pixmaps[priv->rdpindex] = NULL;
+
+	if (priv->con_number == g_con_number)
+	{
+		msg.cacheIndex = priv->rdpindex;
+
+		msg.type = RDS_SERVER_DELETE_OFFSCREEN_SURFACE;
+		rdpup_update((RDS_MSG_COMMON*) &msg);
+	}
+
+	priv->rdpindex = -1;
+}
+
+/**
+ * Returns 1 when copies from the pixmap can be sent with rdpup_paint_os_surface,
+ * creating and uploading its surface first if needed.
+ */
+
+int rdpup_check_os_surface(PixmapPtr pPixmap)
+{
+	int index;
+	int victim;
+	int width;
+	int height;
+	int changed;
+	rdpPixmapRec* priv;
+	RDS_MSG_CREATE_OFFSCREEN_SURFACE msg;
+
+	if (!g_connected || !g_rdpScreen.fbAttached || (g_Bpp != 4))
+		return 0;
+
+	width = pPixmap->drawable.width;
+	height = pPixmap->drawable.height;
+
+	if ((pPixmap->drawable.bitsPerPixel != 32) || !pPixmap->devPrivate.ptr)
+		return 0;
+
+	if ((width * height < RDPUP_OS_MIN_PIXELS) || (width * height > RDPUP_OS_MAX_PIXELS) ||
+			(width > RDPUP_OS_MAX_SIZE) || (height > RDPUP_OS_MAX_SIZE))
+		return 0;
+
+	if (g_os_con_number != g_con_number)
+	{
+		memset(g_os_pixmaps, 0, sizeof(g_os_pixmaps));
+		memset(g_os_stamps, 0, sizeof(g_os_stamps));
+		g_os_con_number = g_con_number;
+	}
+
+	priv = GETPIXPRIV(pPixmap);
+
+	/* MIT-SHM pixmaps are created empty and get their storage from the client */
+	if (priv->kind_width < width)
+		return 0;
+
+	if (priv->con_number != g_con_number)
+	{
+		priv->con_number = g_con_number;
+		priv->rdpindex = -1;
+		priv->use_count = 0;
+	}
+
+	changed = priv->dirty;
+	priv->dirty = 0;
+	priv->use_count++;
+
+	if (priv->rdpindex >= 0)
+	{
+		if (!changed)
+		{
+			g_os_stamps[priv->rdpindex] = ++g_os_stamp;
+			return 1;
+		}
+
+		rdpup_delete_os_surface(pPixmap);
+		return 0;
+	}
+
+	if ((priv->use_count < 2) || changed)
+		return 0;
+
+	victim = -1;
+
+	for (index = 0; index < RDPUP_OS_MAX_SURFACES; index++)
+	{
+		if (!g_os_pixmaps[index])
+		{
+			victim = index;
+			break;
+		}
+
+		if ((victim < 0) || (g_os_stamps[index] < g_os_stamps[victim]))
+			victim = index;
+	}
+
+	if (g_os_pixmaps[victim])
+		rdpup_delete_os_surface(g_os_pixmaps[victim]);
+
+	msg.cacheIndex = victim;
+	msg.nWidth = width;
+	msg.nHeight = height;
+
+	msg.type = RDS_SERVER_CREATE_OFFSCREEN_SURFACE;
+	rdpup_update((RDS_MSG_COMMON*) &msg);
+
+	g_os_pixmaps[victim] = pPixmap;
+	g_os_stamps[victim] = ++g_os_stamp;
+	priv->rdpindex = victim;
+
+	rdpup_upload_os_surface(pPixmap, victim);
+
+	return 1;
+}
+
+void rdpup_paint_os_surface(PixmapPtr pPixmap, int x, int y, int cx, int cy, int srcx, int srcy)
+{
+	rdpPixmapRec* priv;
+	RDS_MSG_PAINT_OFFSCREEN_SURFACE msg;
+
+	priv = GETPIXPRIV(pPixmap);
+
+	msg.cacheIndex = priv->rdpindex;
+	msg.nLeftRect = x;
+	msg.nTopRect = y;
+	msg.nWidth = cx;
+	msg.nHeight = cy;
+	msg.nXSrc = srcx;
+	msg.nYSrc = srcy;
+	msg.bRop = 0xCC;
+
+	msg.type = RDS_SERVER_PAINT_OFFSCREEN_SURFACE;
+	rdpup_update((RDS_MSG_COMMON*) &msg);
+}
+
 void rdpup_shared_framebuffer(RDS_MSG_SHARED_FRAMEBUFFER* msg)
 {
 	msg->type = RDS_SERVER_SHARED_FRAMEBUFFER;
@@ -690,6 +1326,20 @@ int rds_service_accept(rdsService* service)
 	g_con_number++;
 	g_connected = 1;
 	g_rdpScreen.fbAttached = 0;
+
+	/* nothing queued for a previous connection goes to this one */
+	Stream_SetPosition(connector->OutboundStream, 0);
+	freerds_server_outbound_batch(connector, TRUE);
+	connector->OutboundNonBlocking = TRUE;
+
+	if (freerds_transport_shm_offer(connector) < 0)
+		fprintf(stderr, "RdsServiceAccept: using the pipe transport\n");
+
+	if (g_damage_pending)
+	{
+		RegionUninit(&g_damage_reg);
+		g_damage_pending = FALSE;
+	}
 	AddEnabledDevice(g_clientfd);
 
 	fprintf(stderr, "RdsServiceAccept\n");